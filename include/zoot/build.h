@@ -0,0 +1,123 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_BUILD_H
+#define SUIT_BUILD_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+#include <zoot/template.h>
+
+/** 
+ * @brief SUIT manifest builder API
+ * @{
+ */
+
+/*
+ * A manifest is described by its components and encoded in one pass
+ * into the caller's buffer. The lengths of the byte-string wrapped 
+ * sections (common, components, common sequence, install and run) are
+ * measured from the description first, so nothing is encoded twice 
+ * or copied between buffers.
+ *
+ * The sequence number and image sizes are always encoded as 32-bit
+ * integers. Together with digests, device identifiers and URIs they 
+ * are recorded as template fields (see zoot/template.h), so that one
+ * encoded manifest can be patched for each device, or used as a 
+ * template by the parser.
+ */
+
+typedef struct {
+
+    const uint8_t * id; size_t len_id;  /* component identifier */
+
+    /* set with override-parameters in the common sequence, if not 0 */
+    const uint8_t * vendor_id; size_t len_vendor_id;
+    const uint8_t * class_id; size_t len_class_id;
+    suit_digest_alg_t digest_alg;
+    const uint8_t * digest; size_t len_digest;
+    uint32_t size;
+    const uint8_t * device_id; size_t len_device_id;
+
+    /* installed by fetching the URI, or else by copying a component */
+    const char * uri;
+    bool copy; 
+    size_t source;
+
+    bool run;
+
+} suit_build_comp_t;
+
+typedef struct {
+
+    uint32_t sequence_number;
+    size_t component_count;
+    const suit_build_comp_t * components;
+
+} suit_build_t;
+
+/**
+ * @brief Encode a manifest
+ *
+ * @param       b           Pointer to manifest description
+ * @param[out]  man         Pointer to manifest buffer
+ * @param[in,out] len_man   Size of buffer in, length of manifest out
+ * @param[out]  fields      Variable fields, in order, or NULL
+ * @param[in,out] field_count Size of fields in, fields recorded out
+ *
+ * @retval      0       pass
+ * @retval      1       fail (invalid description or no room)
+ */
+int suit_build_manifest(const suit_build_t * b, 
+        uint8_t * man, size_t * len_man,
+        suit_template_field_t * fields, size_t * field_count);
+
+/**
+ * @brief Patch a sequence number or image size in place
+ *
+ * @param       man         Pointer to encoded manifest
+ * @param       len_man     Length of manifest
+ * @param       field       Field recorded by suit_build_manifest()
+ * @param       val         New value
+ *
+ * @retval      0       pass
+ * @retval      1       fail (not a 32-bit integer field)
+ */
+int suit_patch_uint(uint8_t * man, size_t len_man, 
+        const suit_template_field_t * field, uint32_t val);
+
+/**
+ * @brief Patch a digest, identifier or URI of the same length in place
+ *
+ * @param       man         Pointer to encoded manifest
+ * @param       len_man     Length of manifest
+ * @param       field       Field recorded by suit_build_manifest()
+ * @param       val         New contents
+ * @param       len         Length of contents, that of the field
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_patch_bytes(uint8_t * man, size_t len_man, 
+        const suit_template_field_t * field, 
+        const uint8_t * val, size_t len);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_BUILD_H */
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_BUNDLE_H
+#define SUIT_BUNDLE_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+
+/** 
+ * @brief SUIT envelope bundle API
+ * @{
+ */
+
+/*
+ * A bundle holds many envelopes behind an index, for distribution in
+ * bulk. It is used where it lies, such as in memory-mapped flash or a
+ * file mapped by the host: the header and index are read in place and
+ * an envelope is found in O(1) from its position in the index, without
+ * copying it. All integers are little-endian and the bundle must be 
+ * 4-byte aligned.
+ *
+ *      header | entry 0 ... entry count - 1 | envelopes
+ *
+ * The index is not authenticated. suit_bundle_verify() checks every
+ * envelope against its digest, its key and its sequence number.
+ */
+#define SUIT_BUNDLE_MAGIC 0x4c444253 /* "SBDL" */
+#define SUIT_BUNDLE_VERSION 1
+#define SUIT_BUNDLE_DIGEST_SIZE 32 /* SHA-256 */
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_size;    /* sizeof(suit_bundle_entry_t) */
+    uint32_t count;         /* entries */
+    uint32_t len;           /* of the whole bundle */
+} suit_bundle_header_t;
+
+typedef struct {
+    uint8_t digest[SUIT_BUNDLE_DIGEST_SIZE]; /* of the envelope */
+    uint8_t vendor_id[16];
+    uint8_t class_id[16];
+    uint32_t key_id;            /* index of the key it is verified with */
+    uint32_t sequence_number;
+    uint32_t offset;            /* of the envelope in the bundle */
+    uint32_t len;               /* of the envelope */
+} suit_bundle_entry_t;
+
+typedef struct {
+    const uint8_t * data; size_t len;
+    size_t count;
+    const suit_bundle_entry_t * entries;
+} suit_bundle_t;
+
+/**
+ * @brief Write a bundle
+ *
+ * The envelopes are written after the index in the order given. Their
+ * digests, offsets and lengths are filled in; the other fields of each
+ * entry are taken from meta.
+ *
+ * @param[out]  buf         Pointer to 4-byte aligned bundle buffer
+ * @param[in,out] len       Size of buffer in, length of bundle out
+ * @param       meta        Vendor, class, key and sequence number of 
+ *                          each envelope
+ * @param       envs        Pointers to envelopes
+ * @param       len_envs    Lengths of envelopes
+ * @param       count       Number of envelopes
+ *
+ * @retval      0       pass
+ * @retval      1       fail (no room)
+ */
+int suit_bundle_write(uint8_t * buf, size_t * len, 
+        const suit_bundle_entry_t * meta, const uint8_t * const * envs, 
+        const size_t * len_envs, size_t count);
+
+/**
+ * @brief Open a bundle in place
+ *
+ * Only the header is checked; entries are checked as they are used.
+ *
+ * @param[out]  b           Pointer to bundle
+ * @param       data        Pointer to bundle contents
+ * @param       len         Length of contents
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_bundle_open(suit_bundle_t * b, const uint8_t * data, size_t len);
+
+/**
+ * @brief Get an envelope and its index entry
+ *
+ * @param       b           Pointer to bundle
+ * @param       idx         Position in the index
+ * @param[out]  entry       Pointer to index entry, or NULL
+ * @param[out]  env         Pointer to envelope within the bundle
+ * @param[out]  len_env     Length of envelope
+ *
+ * @retval      0       pass
+ * @retval      1       fail (no such entry, or out of bounds)
+ */
+int suit_bundle_get(const suit_bundle_t * b, size_t idx,
+        const suit_bundle_entry_t ** entry, 
+        const uint8_t ** env, size_t * len_env);
+
+/**
+ * @brief Verify every envelope of a bundle
+ *
+ * Each envelope must match the digest in its entry, authenticate 
+ * with keys[key_id] and hold a manifest of the sequence number in its
+ * entry. Vendor and class IDs serve to select envelopes and are 
+ * checked by the device that installs them.
+ *
+ * Envelopes are checked on the calling thread and on up to threads - 1
+ * of the CONFIG_ZOOT_WORKER_THREADS workers (all of them if threads is
+ * 0). Those that fail are marked in bad, a bitmap of at least count 
+ * bits (see ATOMIC_DEFINE()) that is cleared first.
+ *
+ * @param       b           Pointer to bundle
+ * @param       keys        Pointer to keys, by key ID
+ * @param       key_count   Number of keys
+ * @param       threads     Maximum threads
+ * @param[out]  bad         Bitmap of envelopes that fail
+ *
+ * @return      Number of envelopes that fail
+ */
+size_t suit_bundle_verify(const suit_bundle_t * b, 
+        suit_key_t * keys, size_t key_count, 
+        size_t threads, atomic_t * bad);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_BUNDLE_H */
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_DEPS_H
+#define SUIT_DEPS_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+
+#define SUIT_DEP_DIGEST_SIZE 32 /* SHA-256 */
+
+/** 
+ * @brief SUIT dependency resolution API
+ * @{
+ */
+
+/**
+ * @brief Callback that supplies the envelope of a dependency manifest
+ *
+ * Called on the resolving thread. The envelope must stay in memory 
+ * until the dependency graph is no longer used.
+ *
+ * @param       arg         Argument given in the resolver
+ * @param       digest      SHA-256 digest of the wanted manifest
+ * @param       len_digest  Size of digest
+ * @param[out]  env         Pointer to encoded SUIT envelope
+ * @param[out]  len_env     Size of envelope
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+typedef int (*suit_fetch_manifest_t)(void * arg,
+        const uint8_t * digest, size_t len_digest,
+        const uint8_t ** env, size_t * len_env);
+
+/*
+ * A manifest whose signatures were verified, and the key policy they
+ * were verified against.
+ */
+typedef struct {
+    uint8_t digest[SUIT_DEP_DIGEST_SIZE];
+    const suit_key_t * keys; size_t key_count; size_t threshold;
+} suit_cached_manifest_t;
+
+/*
+ * Manifests whose signatures were already verified. Share one cache 
+ * across all resolutions of an update, so that a manifest several 
+ * others depend on is authenticated only once. An entry only counts
+ * for a resolver with the same keys array, key count and threshold, so
+ * resolvers with different key policies may share a cache. When full, 
+ * the oldest entry is replaced.
+ */
+typedef struct {
+    struct k_spinlock lock;
+    size_t count, next;
+    suit_cached_manifest_t entries[CONFIG_ZOOT_MANIFEST_CACHE_SIZE];
+} suit_manifest_cache_t;
+
+typedef struct {
+
+    /* keys and policy for suit_manifest_unwrap_multi() */
+    suit_key_t * keys; size_t key_count; size_t threshold;
+
+    suit_fetch_manifest_t fetch; void * arg;
+    suit_manifest_cache_t * cache;  /* may be NULL */
+
+} suit_resolver_t;
+
+/*
+ * A manifest in the dependency graph. deps[i] is the node index of 
+ * the manifest named by dependency i of ctx.
+ */
+typedef struct {
+
+    uint8_t digest[SUIT_DEP_DIGEST_SIZE];
+    const uint8_t * env; size_t len_env;
+    suit_context_t ctx;
+    size_t deps[SUIT_MAX_DEPENDENCIES];
+
+} suit_dep_node_t;
+
+/*
+ * Node 0 is the root manifest. The others follow in breadth-first
+ * order, so every manifest appears before its dependencies; walk the
+ * nodes backwards to process dependencies first.
+ */
+typedef struct {
+    size_t count;
+    suit_dep_node_t nodes[CONFIG_ZOOT_MAX_DEP_MANIFESTS];
+} suit_dep_graph_t;
+
+/**
+ * @brief Empty a manifest cache
+ *
+ * @param       cache   Pointer to manifest cache
+ */
+void suit_manifest_cache_init(suit_manifest_cache_t * cache);
+
+/**
+ * @brief Resolve all dependencies of a parsed manifest
+ *
+ * Fetches every manifest the root depends on, directly or indirectly, 
+ * and checks that it matches the digest it is referenced by, that it 
+ * is signed according to the resolver's key policy and that it
+ * parses. A manifest referenced more than once is fetched once. The
+ * manifests of each level of the graph are verified in parallel on 
+ * the worker pool (see CONFIG_ZOOT_WORKER_THREADS); signatures of 
+ * manifests found in the cache are not checked again.
+ *
+ * @param       res     Pointer to resolver
+ * @param       root    Pointer to parsed root manifest
+ * @param[out]  graph   Pointer to dependency graph
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_resolve_dependencies(const suit_resolver_t * res, 
+        const suit_context_t * root, suit_dep_graph_t * graph);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_DEPS_H */
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_FETCH_H
+#define SUIT_FETCH_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+#include <zoot/merkle.h>
+
+/**
+ * @brief SUIT multi-source fetch API
+ * @{
+ */
+
+#define SUIT_FETCH_MAX_SOURCES CONFIG_ZOOT_FETCH_MAX_SOURCES
+
+/* a source that failed this many ranges of an image is skipped */
+#define SUIT_FETCH_MAX_FAILURES 3
+
+/*
+ * Zoot has no transport of its own. The application reads len bytes
+ * at offset from the image at uri into buf, over HTTP range requests,
+ * CoAP block transfers or anything else, and returns 0 on success.
+ * The callback is called from several threads at once when the
+ * fetcher uses more than one.
+ */
+typedef int (*suit_fetch_range_t)(void * arg,
+        const uint8_t * uri, size_t len_uri,
+        size_t offset, uint8_t * buf, size_t len);
+
+/*
+ * A source of images and what has been measured of it. Throughput is
+ * kept across images, so later fetches start with the fastest source;
+ * failures are counted per image and cleared when the next one starts.
+ */
+typedef struct {
+    const uint8_t * uri; size_t len_uri;
+    size_t bytes;       /* bytes received */
+    uint64_t cycles;    /* cycles spent receiving them */
+    size_t failures;    /* ranges of the last image that failed */
+    size_t inflight;    /* ranges being received */
+} suit_source_t;
+
+typedef struct {
+
+    suit_fetch_range_t get;
+    void * arg;
+    size_t range_size;  /* bytes per request */
+    size_t threads;     /* concurrent requests, see suit_fetcher_init() */
+
+    /* 
+     * If set, every range is a block checked against its digest as
+     * it arrives; a bad block counts as a failure of its source and
+     * is requested from another one. range_size must be the block 
+     * size.
+     */
+    const suit_merkle_t * merkle;
+
+    struct k_spinlock lock;
+    size_t source_count;
+    suit_source_t sources[SUIT_FETCH_MAX_SOURCES];
+
+} suit_fetcher_t;
+
+/**
+ * @brief Initialize a fetcher without sources
+ *
+ * Requests run on the calling thread and on up to threads - 1 of the
+ * CONFIG_ZOOT_WORKER_THREADS workers (all of them if threads is 0).
+ *
+ * @param[out]  f           Pointer to fetcher
+ * @param       get         Range callback
+ * @param       arg         Argument passed to the callback
+ * @param       range_size  Bytes per request, not 0
+ * @param       threads     Maximum concurrent requests
+ */
+void suit_fetcher_init(suit_fetcher_t * f, suit_fetch_range_t get,
+        void * arg, size_t range_size, size_t threads);
+
+/**
+ * @brief Add a source, such as a mirror or a peer cache
+ *
+ * The URI is referenced, not copied. Known URIs are not added again.
+ *
+ * @param       f           Pointer to fetcher
+ * @param       uri         Pointer to URI
+ * @param       len_uri     Length of URI
+ *
+ * @retval      0       pass
+ * @retval      1       fail (no room)
+ */
+int suit_fetcher_add_source(suit_fetcher_t * f,
+        const uint8_t * uri, size_t len_uri);
+
+/**
+ * @brief Add the URI and the alternative URIs of a component
+ *
+ * Alternative URIs are those of try-each alternatives not taken (see
+ * suit_get_uri_alt()).
+ *
+ * @param       f           Pointer to fetcher
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       idx         Component index
+ *
+ * @retval      0       pass
+ * @retval      1       fail (no URI or no room)
+ */
+int suit_fetcher_add_component(suit_fetcher_t * f,
+        suit_context_t * ctx, size_t idx);
+
+/**
+ * @brief Fetch the image of a component from all sources
+ *
+ * The image is split into ranges that are requested concurrently,
+ * each from the source expected to deliver it first. A range that
+ * fails is requested from another source. The reassembled image is
+ * checked against the digest of the component, if it has one.
+ *
+ * @param       f           Pointer to fetcher
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       idx         Component index
+ * @param[out]  buf         Pointer to image buffer
+ * @param       size        Size of buffer
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_fetch_image(suit_fetcher_t * f, suit_context_t * ctx, size_t idx,
+        uint8_t * buf, size_t size);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_FETCH_H */
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_INDEX_H
+#define SUIT_INDEX_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+
+/** 
+ * @brief SUIT manifest index API
+ * @{
+ */
+
+/*
+ * An index finds the latest manifest for a vendor and class, as a 
+ * gateway serving a mixed fleet does for every device that checks in.
+ * Each verified manifest is added once. A lookup then costs one hash
+ * probe sequence instead of parsing and matching every manifest.
+ *
+ * Manifests are kept as records in a table supplied by the caller. A 
+ * hash table of slots, also supplied by the caller, maps each (vendor
+ * ID, class ID) to the record of its latest manifest. Older manifests
+ * for the same IDs follow as a list, by falling sequence number.
+ *
+ * Lookups take no lock and may run on any number of threads while a 
+ * manifest is added. Records are written in full before they are 
+ * linked, links are published atomically and records are never 
+ * removed. A reader thus sees every manifest either completely or
+ * not at all. Adding manifests is serialized by a spinlock.
+ */
+
+typedef struct {
+
+    uint8_t vendor_id[SUIT_UUID_LEN];
+    uint8_t class_id[SUIT_UUID_LEN];
+    size_t sequence_number;
+    const void * manifest;  /* caller's handle, such as the envelope */
+    atomic_t older;         /* next record + 1, or 0 */
+
+} suit_index_record_t;
+
+typedef struct {
+
+    atomic_t * slots;       /* latest record + 1 per key, or 0 */
+    size_t slot_count;      /* a power of two */
+    suit_index_record_t * records;
+    size_t record_count;
+
+    size_t key_count;       /* slots in use */
+    atomic_t used;          /* records in use */
+    struct k_spinlock lock;
+
+} suit_index_t;
+
+/**
+ * @brief Initialize an empty index
+ *
+ * At most three quarters of the slots are used, so that probe 
+ * sequences stay short: slot_count should be at least 4 / 3 of the 
+ * number of (vendor ID, class ID) pairs in the fleet.
+ *
+ * @param[out]  ix          Pointer to index
+ * @param       slots       Pointer to slots
+ * @param       slot_count  Number of slots, a power of two
+ * @param       records     Pointer to records
+ * @param       record_count Number of records
+ *
+ * @retval      0       pass
+ * @retval      1       fail (slot count not a power of two)
+ */
+int suit_index_init(suit_index_t * ix, atomic_t * slots, size_t slot_count,
+        suit_index_record_t * records, size_t record_count);
+
+/**
+ * @brief Add a verified manifest
+ *
+ * The manifest is indexed under the vendor and class ID that all of 
+ * its components carry. The context is not referenced after the call.
+ *
+ * @param       ix          Pointer to index
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       manifest    Handle returned by lookups
+ *
+ * @retval      0       pass
+ * @retval      1       fail (no room, components without the same
+ *                      16-byte vendor and class IDs, or a sequence 
+ *                      number already indexed for them)
+ */
+int suit_index_add(suit_index_t * ix, suit_context_t * ctx, 
+        const void * manifest);
+
+/**
+ * @brief Find the latest manifest for a vendor and class
+ *
+ * @param       ix          Pointer to index
+ * @param       vendor_id   Pointer to 16-byte vendor ID
+ * @param       class_id    Pointer to 16-byte class ID
+ *
+ * @return      Record of the manifest with the highest sequence 
+ *              number, or NULL if there is none
+ */
+const suit_index_record_t * suit_index_latest(const suit_index_t * ix,
+        const uint8_t * vendor_id, const uint8_t * class_id);
+
+/**
+ * @brief Find the next older manifest for the same vendor and class
+ *
+ * @param       ix          Pointer to index
+ * @param       rec         Pointer to record
+ *
+ * @return      Record of the manifest with the next lower sequence 
+ *              number, or NULL if there is none
+ */
+const suit_index_record_t * suit_index_older(const suit_index_t * ix,
+        const suit_index_record_t * rec);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_INDEX_H */
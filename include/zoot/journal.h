@@ -0,0 +1,152 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_JOURNAL_H
+#define SUIT_JOURNAL_H
+
+#include <zoot/suit.h>
+#include <storage/flash_map.h>
+#include <mbedtls/sha256.h>
+
+/** 
+ * @brief SUIT install journal API
+ * @{
+ */
+
+/*
+ * The journal records how far the install of a manifest has come, so
+ * that an install interrupted by a reset or a power loss continues 
+ * where it stopped instead of fetching and hashing the image again.
+ *
+ * Records are appended to a flash area split into two halves, each a
+ * whole number of erase sectors. When one half is full, the other is
+ * erased and used; the newest valid record is found by its sequence
+ * number, so a record torn by a power loss, or an interrupted erase, 
+ * leaves the previous record in place. A 96-byte record holds the 
+ * manifest digest, the component index, the number of bytes committed
+ * and the SHA-256 state after hashing them, all little-endian and 
+ * covered by a CRC-32.
+ */
+#define SUIT_JOURNAL_MAGIC 0x4c4e4a53 /* "SJNL" */
+#define SUIT_JOURNAL_RECORD_SIZE 96
+#define SUIT_JOURNAL_DIGEST_SIZE 32 /* SHA-256 */
+
+/* checkpoint intervals are a multiple of the SHA-256 block size */
+#define SUIT_JOURNAL_ALIGN 64
+
+/* progress of the install of one component */
+typedef struct {
+    uint8_t manifest[SUIT_JOURNAL_DIGEST_SIZE]; /* manifest digest */
+    size_t idx;                                 /* component index */
+    size_t offset;                  /* bytes committed to storage */
+    mbedtls_sha256_context sha;     /* digest of the committed bytes */
+} suit_progress_t;
+
+typedef struct {
+    const struct flash_area * fa;
+    size_t interval;    /* bytes between checkpoints */
+    uint32_t seq;       /* sequence number of the newest record */
+    size_t half;        /* half the next record goes to */
+    size_t slot;        /* record slot in that half */
+    bool valid;         /* a valid record was found or written */
+    uint8_t last[SUIT_JOURNAL_RECORD_SIZE]; /* newest record */
+} suit_journal_t;
+
+/**
+ * @brief Open the journal in a flash area
+ *
+ * Finds the newest valid record. A blank area is a valid, empty 
+ * journal.
+ *
+ * @param[out]  j           Pointer to journal
+ * @param       fa          Flash area, two halves of whole sectors
+ * @param       interval    Bytes between checkpoints, a nonzero 
+ *                          multiple of SUIT_JOURNAL_ALIGN
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_journal_init(suit_journal_t * j, const struct flash_area * fa,
+        size_t interval);
+
+/**
+ * @brief Start or resume the install of a component
+ *
+ * If the journal holds progress for the same manifest and component,
+ * it is restored: the install continues at progress->offset with the
+ * digest state of the bytes before it. Otherwise progress starts at 0.
+ *
+ * @param       j           Pointer to journal
+ * @param       manifest    SHA-256 digest of the manifest
+ * @param       idx         Component index
+ * @param[out]  progress    Pointer to progress
+ *
+ * @retval      true    the component was installed before
+ * @retval      false   the install continues at progress->offset
+ */
+bool suit_journal_begin(suit_journal_t * j, 
+        const uint8_t manifest[SUIT_JOURNAL_DIGEST_SIZE], size_t idx,
+        suit_progress_t * progress);
+
+/**
+ * @brief Account for bytes committed to storage
+ *
+ * Call once the bytes at progress->offset have been written. A record
+ * is appended at every checkpoint they cross.
+ *
+ * @param       j           Pointer to journal
+ * @param       progress    Pointer to progress
+ * @param       data        Pointer to the bytes committed
+ * @param       len         Number of bytes
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_journal_update(suit_journal_t * j, suit_progress_t * progress,
+        const uint8_t * data, size_t len);
+
+/**
+ * @brief Complete the install of a component
+ *
+ * Checks the committed bytes against the size and digest of the 
+ * component and records it as installed.
+ *
+ * @param       j           Pointer to journal
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       progress    Pointer to progress
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_journal_finish(suit_journal_t * j, suit_context_t * ctx,
+        suit_progress_t * progress);
+
+/**
+ * @brief Forget all progress
+ *
+ * @param       j           Pointer to journal
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_journal_reset(suit_journal_t * j);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_JOURNAL_H */
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_MERKLE_H
+#define SUIT_MERKLE_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+
+/** 
+ * @brief SUIT block digest API
+ * @{
+ */
+
+/*
+ * A component with block digests (suit_param_block_digest) names the
+ * root of a SHA-256 Merkle tree over its image, cut into blocks of a 
+ * fixed size; the last block may be shorter. The tree has the shape
+ * of RFC 6962: a leaf is H(0x00 || block) and a node H(0x01 || left ||
+ * right), where the left subtree holds the largest power of two of 
+ * leaves smaller than the whole.
+ *
+ * The leaf hashes travel next to the image, for example as an 
+ * integrated payload. Once checked against the root in the manifest 
+ * they are as trusted as the manifest, and every block can be checked
+ * on its own: as it arrives, in any order and on any core. A block 
+ * that fails its check is the only one that needs to be fetched again.
+ */
+#define SUIT_MERKLE_HASH_SIZE 32
+
+/* trees are at most this deep, i.e. hold fewer than 2^20 blocks */
+#define SUIT_MERKLE_MAX_DEPTH 20
+
+typedef struct {
+    size_t size;            /* image size */
+    size_t block_size;
+    size_t block_count;
+    const uint8_t * leaves; /* block_count leaf hashes */
+} suit_merkle_t;
+
+/**
+ * @brief Hash one block into its leaf
+ *
+ * @param       block       Pointer to block
+ * @param       len         Size of block
+ * @param[out]  leaf        Leaf hash
+ */
+void suit_merkle_leaf(const uint8_t * block, size_t len,
+        uint8_t leaf[SUIT_MERKLE_HASH_SIZE]);
+
+/**
+ * @brief Compute the root of a tree from its leaves
+ *
+ * @param       leaves      Pointer to leaf hashes
+ * @param       count       Number of leaves
+ * @param[out]  root        Root hash
+ *
+ * @retval      0       pass
+ * @retval      1       fail (no leaves, or too many)
+ */
+int suit_merkle_root(const uint8_t * leaves, size_t count,
+        uint8_t root[SUIT_MERKLE_HASH_SIZE]);
+
+/**
+ * @brief Check the leaves of a component against its manifest
+ *
+ * The leaves are referenced, not copied.
+ *
+ * @param[out]  m           Pointer to block digests
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       idx         Component index
+ * @param       leaves      Pointer to leaf hashes
+ * @param       len_leaves  Size of leaf hashes
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_merkle_init(suit_merkle_t * m, suit_context_t * ctx, size_t idx,
+        const uint8_t * leaves, size_t len_leaves);
+
+/**
+ * @brief Check one block
+ *
+ * @param       m           Pointer to block digests
+ * @param       block       Block index
+ * @param       data        Pointer to block
+ * @param       len         Size of block
+ *
+ * @retval      true    block matches
+ * @retval      false   block does not match
+ */
+bool suit_merkle_block_is_match(const suit_merkle_t * m, size_t block,
+        const uint8_t * data, size_t len);
+
+/**
+ * @brief Check all blocks of an image
+ *
+ * Blocks are checked on the calling thread and on up to threads - 1 
+ * of the CONFIG_ZOOT_WORKER_THREADS workers (all of them if threads 
+ * is 0). Blocks that do not match are marked in bad, a bitmap of at 
+ * least block_count bits (see ATOMIC_DEFINE()) that is cleared first.
+ *
+ * @param       m           Pointer to block digests
+ * @param       image       Pointer to image of m->size bytes
+ * @param       threads     Maximum threads
+ * @param[out]  bad         Bitmap of blocks that do not match
+ *
+ * @return      Number of blocks that do not match
+ */
+size_t suit_merkle_check_image(const suit_merkle_t * m, 
+        const uint8_t * image, size_t threads, atomic_t * bad);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_MERKLE_H */
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_PLAN_H
+#define SUIT_PLAN_H
+
+#include <zoot/suit.h>
+
+/** 
+ * @brief SUIT install plan API
+ * @{
+ */
+
+/*
+ * An install plan is a manifest reduced to the steps an update handler
+ * takes, with every parameter resolved. It holds no CBOR and no 
+ * pointers: a 16-byte header, 12-byte steps and a pool of the strings
+ * the steps refer to by offset, all little-endian, followed by an 
+ * HMAC-SHA256 tag over all of these. A plan can be stored or sent and
+ * replayed anywhere, as often as needed. 
+ *
+ * The plan no longer carries the manifest's signatures; the tag stands
+ * in for them. It is made with a secret shared by the party that
+ * authenticated and compiled the manifest and the devices that replay
+ * the plan, and a plan is only replayed if its tag verifies.
+ */
+#define SUIT_PLAN_MAGIC 0x4e4c5053 /* "SPLN" */
+#define SUIT_PLAN_HDR_SIZE 16
+#define SUIT_PLAN_STEP_SIZE 12
+#define SUIT_PLAN_TAG_SIZE 32
+
+/* 
+ * Steps are ordered by phase, then by component: the identity of every
+ * component is checked, then images are fetched, then copied or 
+ * swapped, then checked against their digests and finally run. No
+ * image is touched unless every identity check passes.
+ */
+typedef enum {
+    suit_step_check_vendor_id = 1,
+    suit_step_check_class_id = 2,
+    suit_step_check_device_id = 3,
+    suit_step_fetch = 4,
+    suit_step_copy = 5,
+    suit_step_check_digest = 6,
+    suit_step_run = 7,
+    suit_step_swap = 8,
+} suit_step_t;
+
+/*
+ * Performs the steps of a plan. Each callback returns 0 on success;
+ * any other value stops the plan. A plan containing a step whose 
+ * callback is NULL fails when that step is reached. Identity checks
+ * are made against id (see suit_identity_match()).
+ */
+typedef struct {
+
+    void * arg;
+    const suit_identity_t * id;
+
+    int (*fetch)(void * arg, size_t idx,
+            const uint8_t * uri, size_t len_uri, 
+            size_t size, suit_archive_alg_t archive_alg);
+    int (*copy)(void * arg, size_t idx, size_t source, size_t size);
+    int (*swap)(void * arg, size_t idx, size_t source, size_t size);
+    int (*check_digest)(void * arg, size_t idx, 
+            suit_digest_alg_t digest_alg, 
+            const uint8_t * digest, size_t len_digest, size_t size);
+    int (*run)(void * arg, size_t idx);
+
+} suit_plan_handler_t;
+
+/**
+ * @brief Compile a parsed manifest into an install plan
+ *
+ * The manifest must have been authenticated by the caller; the plan 
+ * copies what it needs, no longer refers to the manifest and is 
+ * tagged with key.
+ *
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       key         Pointer to plan secret
+ * @param       len_key     Size of plan secret
+ * @param[out]  plan        Pointer to plan buffer
+ * @param[in,out] len_plan  Size of buffer in, size of plan out
+ *
+ * @retval      0       pass
+ * @retval      1       fail 
+ */
+int suit_plan_compile(suit_context_t * ctx,
+        const uint8_t * key, size_t len_key,
+        uint8_t * plan, size_t * len_plan);
+
+/**
+ * @brief Replay an install plan
+ *
+ * The plan's tag and structure are checked before the first step 
+ * runs, so a plan that was altered, truncated or tagged with another
+ * key performs no steps.
+ *
+ * @param       plan        Pointer to plan
+ * @param       len_plan    Size of plan
+ * @param       key         Pointer to plan secret
+ * @param       len_key     Size of plan secret
+ * @param       handler     Pointer to step callbacks
+ *
+ * @retval      0       pass
+ * @retval      1       fail 
+ */
+int suit_plan_execute(const uint8_t * plan, size_t len_plan,
+        const uint8_t * key, size_t len_key,
+        const suit_plan_handler_t * handler);
+
+/**
+ * @brief Sequence number of the manifest a plan was compiled from
+ *
+ * @param       plan        Pointer to plan
+ * @param       len_plan    Size of plan
+ * @param       key         Pointer to plan secret
+ * @param       len_key     Size of plan secret
+ * @param[out]  seq_num     Sequence number
+ *
+ * @retval      0       pass
+ * @retval      1       fail 
+ */
+int suit_plan_sequence_number(const uint8_t * plan, size_t len_plan,
+        const uint8_t * key, size_t len_key, size_t * seq_num);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_PLAN_H */
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_SCHEDULE_H
+#define SUIT_SCHEDULE_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+
+/** 
+ * @brief SUIT update scheduler API
+ * @{
+ */
+
+#define SUIT_SCHED_MAX_PENDING CONFIG_ZOOT_SCHED_MAX_PENDING
+
+#define SUIT_SCHED_DAY 86400 /* seconds */
+
+/*
+ * What the device knows of its surroundings, asked whenever a wait 
+ * condition is evaluated. Callbacks may be NULL if the device has no
+ * way to know; manifests waiting on such an event are not accepted.
+ * A simulated clock and power source make the scheduler testable.
+ */
+typedef struct {
+
+    void * arg;
+
+    /* seconds since 1970-01-01 00:00 UTC */
+    uint32_t (*now)(void * arg);
+
+    /* 
+     * Current level of authorization, power or network, on a scale 
+     * of the application's choosing. A wait event is met once the 
+     * level reaches its argument.
+     */
+    int32_t (*level)(void * arg, suit_wait_t event);
+
+    /* battery level, in the unit of suit_param_min_battery */
+    uint32_t (*battery)(void * arg);
+
+    /* 
+     * Returns true if the other device runs a matching version. The 
+     * versions are the encoded array of version matches of the wait 
+     * event.
+     */
+    bool (*other_device)(void * arg, 
+            const uint8_t * device, size_t len_device,
+            const uint8_t * versions, size_t len_versions);
+
+    /* returns true if the device has little else to do; NULL if always */
+    bool (*idle)(void * arg);
+
+    /* 
+     * Seconds a time-of-day window stays open, or 0 to keep it open 
+     * until midnight.
+     */
+    uint32_t window;
+
+} suit_sched_env_t;
+
+typedef struct {
+    suit_context_t * ctx;
+    void * arg;
+    int32_t priority;   /* lowest update priority of its components */
+} suit_sched_entry_t;
+
+/*
+ * Pending manifests, ordered by priority. Lower values are more 
+ * urgent; negative values are system-critical updates.
+ */
+typedef struct {
+    const suit_sched_env_t * env;
+    size_t count;
+    suit_sched_entry_t entries[SUIT_SCHED_MAX_PENDING];
+} suit_scheduler_t;
+
+/**
+ * @brief Initialize an empty scheduler
+ *
+ * @param[out]  s           Pointer to scheduler
+ * @param       env         Pointer to environment callbacks
+ */
+void suit_sched_init(suit_scheduler_t * s, const suit_sched_env_t * env);
+
+/**
+ * @brief Queue a parsed manifest
+ *
+ * The context is referenced, not copied, and must stay valid until 
+ * the manifest is returned by suit_sched_next(). Manifests of equal
+ * priority are returned in the order they were queued.
+ *
+ * @param       s           Pointer to scheduler
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       arg         Returned with the manifest
+ *
+ * @retval      0       pass
+ * @retval      1       fail (no room, malformed wait events, or an
+ *                      event the environment cannot evaluate)
+ */
+int suit_sched_add(suit_scheduler_t * s, suit_context_t * ctx, void * arg);
+
+/**
+ * @brief Check whether a manifest may be installed now
+ *
+ * Every component referenced by a wait directive must have its wait 
+ * events met and every component must have its minimum battery 
+ * level. Unless the update is system-critical, the device must also
+ * be idle. The check can be repeated before each I/O-heavy step, such
+ * as fetching and installing, to pause when the window closes.
+ *
+ * @param       s           Pointer to scheduler
+ * @param       ctx         Pointer to SUIT parser context struct
+ *
+ * @retval      true    the manifest may be installed
+ * @retval      false   the manifest must wait
+ */
+bool suit_sched_is_ready(const suit_scheduler_t * s, suit_context_t * ctx);
+
+/**
+ * @brief Take the most urgent manifest that may be installed now
+ *
+ * A manifest that must wait does not hold back less urgent ones.
+ *
+ * @param       s           Pointer to scheduler
+ * @param[out]  ctx         Pointer to SUIT parser context struct
+ * @param[out]  arg         Argument it was queued with
+ *
+ * @retval      0       pass
+ * @retval      1       fail (nothing may be installed now)
+ */
+int suit_sched_next(suit_scheduler_t * s, 
+        suit_context_t ** ctx, void ** arg);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_SCHEDULE_H */
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_STORAGE_H
+#define SUIT_STORAGE_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+
+/** 
+ * @brief SUIT component storage API
+ * @{
+ */
+
+#define SUIT_COPY_DIGEST_SIZE 32 /* SHA-256 */
+
+/* component index of the spare sector in storage callbacks */
+#define SUIT_STORAGE_SPARE SIZE_MAX
+
+typedef struct {
+    uint16_t a, b;      /* components swapped */
+    uint32_t sectors;   /* sectors swapped */
+    uint32_t step;      /* steps done, out of 3 * sectors */
+} suit_swap_status_t;
+
+/*
+ * Storage of the components, accessed by component index and offset.
+ * Each callback returns 0 on success. erase() erases the sector at 
+ * offset. save() keeps the status of a swap across resets, or forgets
+ * it if status is NULL; load() returns the status saved, or 1 if there
+ * is none.
+ *
+ * The remaining callbacks are optional and speed up suit_copy(). 
+ * remap() makes component dst refer to the image of src without 
+ * copying it, for example by pointing a slot at the source region; it
+ * returns 1 if it cannot. transfer() starts copying len bytes, as by 
+ * DMA, and returns without waiting; wait() waits for that transfer to
+ * end and returns 0 if it succeeded. Only one transfer is started at 
+ * a time.
+ */
+typedef struct {
+
+    void * arg;
+    size_t sector_size;
+    size_t chunk_size;  /* bytes per transfer, a multiple of sectors */
+
+    int (*read)(void * arg, size_t idx, size_t offset,
+            uint8_t * buf, size_t len);
+    int (*write)(void * arg, size_t idx, size_t offset,
+            const uint8_t * buf, size_t len);
+    int (*erase)(void * arg, size_t idx, size_t offset);
+    int (*save)(void * arg, const suit_swap_status_t * status);
+    int (*load)(void * arg, suit_swap_status_t * status);
+
+    int (*remap)(void * arg, size_t dst, size_t src, size_t size);
+    int (*transfer)(void * arg, size_t dst, size_t dst_off,
+            size_t src, size_t src_off, size_t len);
+    int (*wait)(void * arg);
+
+} suit_storage_t;
+
+/**
+ * @brief Copy the image of one component to another
+ *
+ * The image is remapped if storage can, and otherwise copied in chunks
+ * of chunk_size (one sector if 0), each destination sector being 
+ * erased first. With transfer() and wait(), each chunk is hashed while
+ * the next one is being transferred; without, it goes through a 
+ * buffer and is hashed once written.
+ *
+ * The image is hashed into hash, if not NULL, as read back from dst
+ * after it was written, so hash can be checked against the digest of
+ * dst in place of reading dst again.
+ *
+ * @param       st          Pointer to storage
+ * @param       dst         Component copied to
+ * @param       src         Component copied from
+ * @param       size        Bytes to copy
+ * @param[out]  hash        SHA-256 of the image, or NULL
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_copy(const suit_storage_t * st, size_t dst, size_t src,
+        size_t size, uint8_t hash[SUIT_COPY_DIGEST_SIZE]);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_STORAGE_H */
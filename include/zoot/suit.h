@@ -19,8 +19,24 @@
 #define SUIT_H
 
 #include <cozy/cose.h>
+#include <mbedtls/pk.h>
 
-#define SUIT_MAX_COMPONENTS 2
+#define SUIT_MAX_COMPONENTS CONFIG_ZOOT_MAX_COMPONENTS
+/* 
+ * One parameter block per component, and one for a merge in progress, 
+ * so that every valid manifest fits however many blocks it shares.
+ */
+#define SUIT_MAX_PARAM_BLOCKS (CONFIG_ZOOT_MAX_COMPONENTS + 1)
+#define SUIT_MAX_URI_ALTS CONFIG_ZOOT_MAX_URI_ALTS
+#ifdef CONFIG_ZOOT_TRY_EACH
+#define SUIT_MAX_NESTING CONFIG_ZOOT_MAX_NESTING
+#else
+#define SUIT_MAX_NESTING 0
+#endif
+#define SUIT_MAX_DEPENDENCIES 4
+#define SUIT_MAX_KEYS 32
+#define SUIT_UUID_LEN 16
+#define SUIT_MATCH_WORDS ((SUIT_MAX_COMPONENTS + 31) / 32)
 
 /** 
  * @brief SUIT API
@@ -171,6 +187,9 @@ typedef enum {
     suit_param_update_priority = 27,
     suit_param_version = 28,
     suit_param_wait_info = 29,
+
+    /* Zoot extension: [block size, digest algorithm, Merkle root] */
+    suit_param_block_digest = 64,
 } suit_param_t;
 
 typedef enum {
@@ -187,10 +206,16 @@ typedef enum {
 } suit_text_t;
 
 typedef struct suit_component_s suit_component_t;
-struct suit_component_s {
-    
-    bool run;    /* component is referenced by a run directive */
+
+/*
+ * The parameters of one or more components. Components that were 
+ * given identical parameters share a block; a component only gets a
+ * block of its own once a later command sets it apart (copy-on-write).
+ */
+typedef struct {
+
     size_t size; /* image size (bytes) */
+    const uint8_t * size_at; /* where size was read, for templates */
 
     /*
      * These values are initialized to 0. If not 0, they should be
@@ -208,21 +233,101 @@ struct suit_component_s {
     uint8_t * digest; size_t len_digest;
     uint8_t * class_id; size_t len_class_id;
     uint8_t * vendor_id; size_t len_vendor_id;
+    uint8_t * device_id; size_t len_device_id;
     suit_component_t * source;
 
+    /* Merkle tree over fixed-size blocks, see zoot/merkle.h */
+    size_t block_size;
+    suit_digest_alg_t block_digest_alg;
+    uint8_t * block_root; size_t len_block_root;
+
+    /* URIs of try-each alternatives not taken that are mirrors */
+    uint8_t * uri_alts[SUIT_MAX_URI_ALTS];
+    size_t len_uri_alts[SUIT_MAX_URI_ALTS];
+    uint8_t uri_alt_count;
+
+    /* integrated payload in the envelope, see suit_resolve_payloads() */
+    const uint8_t * payload; size_t len_payload;
+
+    /* when to install, see zoot/schedule.h */
+    int32_t priority;       /* update priority, 0 if normal */
+    uint32_t min_battery;   /* battery level required, 0 if none */
+    uint8_t * wait_info; size_t len_wait_info; /* encoded wait events */
+
+    uint16_t refs; /* components referencing this block, 0 if free */
+
+} suit_params_t;
+
+struct suit_component_s {
+    
+    bool run;        /* component is referenced by a run directive */
+    bool swap;       /* swap with the source component, not copy */
+    bool wait;       /* referenced by a wait directive */
+    uint16_t params; /* index of the parameter block in the context */
+
 };
 
+typedef struct {
+
+    bool process; /* referenced by a process-dependency directive */
+
+    /* digest of the dependency manifest, referenced in the manifest */
+    suit_digest_alg_t digest_alg;
+    uint8_t * digest; size_t len_digest;
+
+} suit_dependency_t;
+
+/* COSE algorithm identifiers accepted in authentication wrappers */
+typedef enum {
+    suit_auth_alg_es256 = -7,
+    suit_auth_alg_eddsa = -8,
+    suit_auth_alg_hmac_256 = 5,
+} suit_auth_alg_t;
+
+/*
+ * A key that is parsed once and kept for the lifetime of the device.
+ * Pinning an ECDSA key also precomputes the fixed-base comb table for
+ * the curve generator, which mbedTLS keeps in RAM inside the key's 
+ * group structure (see README). HMAC secrets and Ed25519 keys are 
+ * referenced, not copied.
+ */
+typedef struct {
+
+    suit_auth_alg_t alg;
+
+    mbedtls_pk_context pk;                  /* ES256 */
+    const uint8_t * raw; size_t len_raw;    /* HMAC, EdDSA */
+
+} suit_key_t;
+
+/*
+ * The identities of a device: concatenated 16-byte UUIDs of every 
+ * vendor, class and device it answers to.
+ */
+typedef struct {
+
+    const uint8_t * vendor_ids; size_t vendor_id_count;
+    const uint8_t * class_ids; size_t class_id_count;
+    const uint8_t * device_ids; size_t device_id_count;
+
+} suit_identity_t;
+
 typedef struct {
 
     size_t version;         /* always 1 */
     size_t sequence_number; /* rollback protection */
     size_t component_count; /* may be less than maximum allowed */
+    const uint8_t * sequence_number_at; /* where it was read */
 
     /* 
      * Recipients should specify a limit to the number of manifest
      * components (see I-D Section 5.4).
      */
     suit_component_t components[SUIT_MAX_COMPONENTS];
+    suit_params_t params[SUIT_MAX_PARAM_BLOCKS];
+
+    size_t dependency_count;
+    suit_dependency_t dependencies[SUIT_MAX_DEPENDENCIES];
 
 } suit_context_t;
 
@@ -242,6 +347,8 @@ int suit_parse_init(suit_context_t * ctx,
 /**
  * @brief Authenticate a signed SUIT envelope and return the manifest
  * 
+ * Requires CONFIG_ZOOT_ES256.
+ *
  * @param       pem     Pointer to PEM-formatted public key string
  * @param       env     Pointer to encoded SUIT envelope
  * @param       len_env Size of envelope
@@ -255,9 +362,108 @@ int suit_manifest_unwrap(const uint8_t * pem,
         const uint8_t * env, const size_t len_env,
         const uint8_t ** man, size_t * len_man);
 
+/**
+ * @brief Parse and pin a public key for repeated envelope verification
+ *
+ * Requires CONFIG_ZOOT_ES256.
+ *
+ * @param       key     Pointer to key struct
+ * @param       pem     Pointer to PEM-formatted public key string
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_key_init(suit_key_t * key, const uint8_t * pem);
+
+/**
+ * @brief Use a shared secret for COSE_Mac0 (HMAC 256/256) wrappers
+ *
+ * Requires CONFIG_ZOOT_HMAC.
+ *
+ * @param       key         Pointer to key struct
+ * @param       secret      Pointer to secret (referenced, not copied)
+ * @param       len_secret  Size of secret
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_key_init_hmac(suit_key_t * key,
+        const uint8_t * secret, size_t len_secret);
+
+/**
+ * @brief Use an Ed25519 key for COSE Sign1 (EdDSA) wrappers
+ *
+ * Requires CONFIG_ZOOT_EDDSA. A 32-byte key can only verify; a 64-byte
+ * key (seed followed by public key) can also sign.
+ *
+ * @param       key     Pointer to key struct
+ * @param       raw     Pointer to key bytes (referenced, not copied)
+ * @param       len_raw Size of key
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_key_init_ed25519(suit_key_t * key,
+        const uint8_t * raw, size_t len_raw);
+
+/**
+ * @brief Release the resources held by a pinned key
+ *
+ * @param       key     Pointer to key struct
+ */
+void suit_key_free(suit_key_t * key);
+
+/**
+ * @brief Authenticate a signed SUIT envelope against a pinned key
+ *
+ * Equivalent to suit_manifest_unwrap(), but skips PEM parsing and
+ * reuses the precomputed tables held by the key. The wrapper may be a
+ * COSE Sign1 (ES256, EdDSA) or COSE_Mac0 (HMAC 256/256) object; the 
+ * algorithm in its protected header must match the key.
+ *
+ * @param       key     Pointer to pinned key
+ * @param       env     Pointer to encoded SUIT envelope
+ * @param       len_env Size of envelope
+ * @param[out]  man     Pointer to manifest within envelope
+ * @param[out]  len_man Size of manifest
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_manifest_unwrap_key(suit_key_t * key,
+        const uint8_t * env, const size_t len_env,
+        const uint8_t ** man, size_t * len_man);
+
+/**
+ * @brief Authenticate a SUIT envelope against an m-of-n key policy
+ *
+ * Every entry of the authentication wrapper is considered; entries may
+ * be COSE Sign1, COSE_Mac0 or COSE_Sign (ES256, EdDSA) objects, and 
+ * each must carry the digest of the manifest in the envelope. The
+ * envelope passes once threshold distinct keys have verified a 
+ * signature. With CONFIG_ZOOT_WORKER_THREADS, signatures are checked
+ * in parallel and checking stops as soon as the outcome is known.
+ *
+ * @param       keys        Array of pinned keys
+ * @param       key_count   Number of keys (at most SUIT_MAX_KEYS)
+ * @param       threshold   Number of keys that must sign (1..key_count)
+ * @param       env         Pointer to encoded SUIT envelope
+ * @param       len_env     Size of envelope
+ * @param[out]  man         Pointer to manifest within envelope
+ * @param[out]  len_man     Size of manifest
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_manifest_unwrap_multi(suit_key_t * keys, size_t key_count,
+        size_t threshold, const uint8_t * env, const size_t len_env,
+        const uint8_t ** man, size_t * len_man);
+
 /**
  * @brief Generate a manifest envelope with authenticated wrapper
  *
+ * Requires CONFIG_ZOOT_ES256.
+ *
  * @param       pem     Pointer to PEM-formatted private key string
  * @param       man     Pointer to serialized SUIT manifest
  * @param       len_man Size of manifest
@@ -271,6 +477,112 @@ int suit_manifest_wrap(const uint8_t * pem,
         const uint8_t * man, const size_t len_man,
         uint8_t * env, size_t * len_env);
 
+/**
+ * @brief Generate a manifest envelope authenticated with an HMAC or
+ * Ed25519 key
+ *
+ * @param       key     Pointer to HMAC or signing Ed25519 key
+ * @param       man     Pointer to serialized SUIT manifest
+ * @param       len_man Size of manifest
+ * @param[out]  env     Pointer to SUIT envelope (allocated by CALLER)
+ * @param[out]  len_env Size of envelope
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_manifest_wrap_key(suit_key_t * key,
+        const uint8_t * man, const size_t len_man,
+        uint8_t * env, size_t * len_env);
+
+/**
+ * @brief Add a COSE Sign1 (ES256) signature to an existing envelope
+ *
+ * The envelope is updated in place; the new entry is appended to the
+ * authentication wrapper and vouches for the same manifest digest.
+ * Requires CONFIG_ZOOT_ES256.
+ *
+ * @param       pem         Pointer to PEM-formatted private key string
+ * @param       env         Pointer to SUIT envelope
+ * @param[out]  len_env     Size of envelope, updated on success
+ * @param       size_env    Size of the buffer holding the envelope
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_manifest_countersign(const uint8_t * pem,
+        uint8_t * env, size_t * len_env, const size_t size_env);
+
+/**
+ * @brief Add an HMAC or Ed25519 wrapper entry to an existing envelope
+ *
+ * @param       key         Pointer to HMAC or signing Ed25519 key
+ * @param       env         Pointer to SUIT envelope
+ * @param[out]  len_env     Size of envelope, updated on success
+ * @param       size_env    Size of the buffer holding the envelope
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_manifest_countersign_key(suit_key_t * key,
+        uint8_t * env, size_t * len_env, const size_t size_env);
+
+/**
+ * @brief Peak arena use since the last reset
+ *
+ * Requires CONFIG_ZOOT_ARENA. While Zoot wraps or unwraps an envelope,
+ * every mbedTLS allocation is served from a static arena of
+ * CONFIG_ZOOT_ARENA_SIZE bytes, which is reset afterwards. The peak
+ * includes block headers and alignment, so it is the arena size 
+ * needed for the operations since the last reset.
+ *
+ * @retval      Peak arena use (bytes)
+ */
+size_t suit_arena_high_water(void);
+
+/**
+ * @brief Restart high-water tracking from the current arena use
+ */
+void suit_arena_reset_high_water(void);
+
+/**
+ * @brief Resolve the integrated payloads of a parsed manifest
+ *
+ * A component whose URI starts with '#' names a payload carried in 
+ * the envelope under that text key. Each such payload is found in the
+ * envelope, checked against the component's SHA-256 digest and size,
+ * and made available through suit_get_payload() as a view into the 
+ * envelope; nothing is copied. The envelope must be the one the 
+ * manifest was unwrapped from and must stay in memory while the 
+ * payloads are used.
+ *
+ * @param       ctx     Pointer to SUIT parser context struct
+ * @param       env     Pointer to encoded SUIT envelope
+ * @param       len_env Size of envelope
+ *
+ * @retval      0       pass
+ * @retval      1       fail: a payload is missing or does not match
+ */
+int suit_resolve_payloads(suit_context_t * ctx,
+        const uint8_t * env, size_t len_env);
+
+/**
+ * @brief Match every component against the identities of a device
+ *
+ * A component matches if each of its vendor, class and device IDs 
+ * that is present equals one of the device's IDs of that kind. IDs 
+ * are compared as 16-byte UUIDs in 32-bit words, and every ID of the
+ * device is compared with every component ID, so the time taken does
+ * not depend on the ID values.
+ *
+ * @param       ctx     Pointer to SUIT parser context struct
+ * @param       id      Pointer to device identity table
+ * @param[out]  match   Bitmap with bit idx set if component idx matches
+ *
+ * @retval      true    all components match
+ * @retval      false   at least one component does not match
+ */
+bool suit_identity_match(suit_context_t * ctx, const suit_identity_t * id,
+        uint32_t match[SUIT_MATCH_WORDS]);
 
 /* API for global SUIT manifest parameters */
 
@@ -281,6 +593,15 @@ size_t suit_get_component_count(suit_context_t * ctx);
 /* API for components within a SUIT manifest */
 
 bool suit_must_run(suit_context_t * ctx, size_t idx);
+bool suit_must_swap(suit_context_t * ctx, size_t idx);
+bool suit_must_wait(suit_context_t * ctx, size_t idx);
+
+int32_t suit_get_priority(suit_context_t * ctx, size_t idx);
+uint32_t suit_get_min_battery(suit_context_t * ctx, size_t idx);
+
+bool suit_has_wait_info(suit_context_t * ctx, size_t idx);
+void suit_get_wait_info(suit_context_t * ctx, size_t idx,
+        const uint8_t ** wait_info, size_t * len_wait_info);
 
 size_t suit_get_size(suit_context_t * ctx, size_t idx);
 bool suit_has_size(suit_context_t * ctx, size_t idx);
@@ -295,6 +616,18 @@ bool suit_digest_is_match(suit_context_t * ctx, size_t idx,
 bool suit_has_uri(suit_context_t * ctx, size_t idx);
 void suit_get_uri(suit_context_t * ctx, size_t idx,
         const uint8_t ** uri, size_t * len_uri);
+size_t suit_get_uri_alt_count(suit_context_t * ctx, size_t idx);
+void suit_get_uri_alt(suit_context_t * ctx, size_t idx, size_t alt,
+        const uint8_t ** uri, size_t * len_uri);
+
+bool suit_has_block_digest(suit_context_t * ctx, size_t idx);
+void suit_get_block_digest(suit_context_t * ctx, size_t idx,
+        size_t * block_size, suit_digest_alg_t * alg,
+        const uint8_t ** root, size_t * len_root);
+
+bool suit_has_payload(suit_context_t * ctx, size_t idx);
+void suit_get_payload(suit_context_t * ctx, size_t idx,
+        const uint8_t ** payload, size_t * len_payload);
 
 bool suit_has_class_id(suit_context_t * ctx, size_t idx);
 bool suit_class_id_is_match(suit_context_t * ctx, size_t idx,
@@ -304,9 +637,20 @@ bool suit_has_vendor_id(suit_context_t * ctx, size_t idx);
 bool suit_vendor_id_is_match(suit_context_t * ctx, size_t idx,
         const uint8_t * vendor_id, size_t len_vendor_id);
 
+bool suit_has_device_id(suit_context_t * ctx, size_t idx);
+bool suit_device_id_is_match(suit_context_t * ctx, size_t idx,
+        const uint8_t * device_id, size_t len_device_id);
+
 bool suit_has_source_component(suit_context_t * ctx, size_t idx);
 suit_component_t * suit_get_source_component(suit_context_t * ctx, size_t idx);
 
+/* API for dependencies of a SUIT manifest (see zoot/deps.h) */
+
+size_t suit_get_dependency_count(suit_context_t * ctx);
+bool suit_must_process_dependency(suit_context_t * ctx, size_t idx);
+bool suit_dependency_digest_is_match(suit_context_t * ctx, size_t idx,
+        const uint8_t * digest, size_t len_digest);
+
 /**
  * @}
  */
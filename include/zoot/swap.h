@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_SWAP_H
+#define SUIT_SWAP_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+#include <zoot/storage.h>
+
+/** 
+ * @brief SUIT slot swap API
+ * @{
+ */
+
+/*
+ * A swap exchanges the images of two components, such as the A and B
+ * slots of a device, using one spare sector. First every sector of 
+ * slot A moves up by one, the last one into the spare sector. Then, 
+ * for each sector i, sector i of B goes into the now free sector i of
+ * A, and the old sector i of A, one sector up, goes into sector i of 
+ * B. No sector is erased more than twice and the spare only once, 
+ * where a swap through a scratch sector erases that sector once per 
+ * sector swapped.
+ *
+ * Every step copies one sector to a sector whose contents are no 
+ * longer needed, leaving its source as it was. The status is saved
+ * before the first step and after each one, so a swap interrupted by
+ * a power loss can be resumed by repeating the step it was in.
+ */
+
+/**
+ * @brief Swap the images of two components
+ *
+ * If a swap of the same components was interrupted, it is resumed.
+ *
+ * @param       st          Pointer to storage
+ * @param       a           Component whose sectors move through the spare
+ * @param       b           Other component
+ * @param       size        Bytes to swap
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_swap(const suit_storage_t * st, size_t a, size_t b, size_t size);
+
+/**
+ * @brief Complete an interrupted swap, if any
+ *
+ * Call at boot, before the images of either component are used.
+ *
+ * @param       st          Pointer to storage
+ *
+ * @retval      0       pass (no swap was interrupted, or it completed)
+ * @retval      1       fail
+ */
+int suit_swap_resume(const suit_storage_t * st);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_SWAP_H */
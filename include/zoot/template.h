@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_TEMPLATE_H
+#define SUIT_TEMPLATE_H
+
+#include <zephyr.h>
+#include <zoot/suit.h>
+
+/** 
+ * @brief SUIT manifest template API
+ * @{
+ */
+
+/*
+ * Manifests made by one generator share a byte layout and differ only
+ * in a few fields, such as the sequence number, image digests, sizes 
+ * and URIs. A template is one such manifest, parsed once, with the 
+ * positions of its variable fields. A manifest of the same length that
+ * matches the template everywhere else is not parsed again: its 
+ * context is the template's, with its own fields read from their 
+ * offsets.
+ *
+ * Integers keep their position only if the generator encodes them 
+ * with a fixed width, and strings if they keep their length. Any 
+ * manifest that does not match, such as one with a longer URI, goes
+ * through the generic parser.
+ */
+#define SUIT_TEMPLATE_MAX_FIELDS CONFIG_ZOOT_TEMPLATE_MAX_FIELDS
+
+typedef enum {
+    suit_field_bytes = 0,   /* contents of a byte or text string */
+    suit_field_seq_num = 1, /* sequence number, a CBOR uint */
+    suit_field_size = 2,    /* image size of a component, a CBOR uint */
+} suit_field_t;
+
+typedef struct {
+    suit_field_t field;
+    size_t idx;     /* component index, for suit_field_size */
+    size_t offset;  /* in the manifest */
+    size_t len;     /* whole uint, or string contents without header */
+} suit_template_field_t;
+
+typedef struct {
+
+    const uint8_t * man; size_t len_man;
+    size_t field_count;
+    suit_template_field_t fields[SUIT_TEMPLATE_MAX_FIELDS];
+    suit_context_t ctx;
+
+} suit_template_t;
+
+/**
+ * @brief Make a template of a manifest
+ *
+ * The manifest is referenced, not copied. Fields must be given in 
+ * order of offset and must not overlap. A bytes field must be exactly
+ * a string the parser keeps, such as a digest, URI or identifier, and
+ * an integer field exactly the uint the parser took the sequence 
+ * number or the component's image size from; other bytes must match.
+ * Templates where components share parameters are refused, as a 
+ * different field could set them apart.
+ *
+ * @param[out]  t           Pointer to template
+ * @param       man         Pointer to encoded SUIT manifest
+ * @param       len_man     Size of manifest
+ * @param       fields      Variable fields of the manifest
+ * @param       field_count Number of fields
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_template_init(suit_template_t * t, 
+        const uint8_t * man, size_t len_man,
+        const suit_template_field_t * fields, size_t field_count);
+
+/**
+ * @brief Parse a manifest, through a template if one matches
+ *
+ * The result is that of suit_parse_init().
+ *
+ * @param       ctx         Pointer to SUIT parser context struct
+ * @param       templates   Templates to try, in order
+ * @param       count       Number of templates
+ * @param       man         Pointer to encoded SUIT manifest
+ * @param       len_man     Size of manifest
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_parse_template(suit_context_t * ctx, 
+        const suit_template_t * templates, size_t count,
+        const uint8_t * man, size_t len_man);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_TEMPLATE_H */
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_WRITER_H
+#define SUIT_WRITER_H
+
+#include <zephyr.h>
+#include <storage/flash_map.h>
+
+/** 
+ * @brief SUIT flash writer API
+ * @{
+ */
+
+/*
+ * The writer sits between a transport, which delivers an image in 
+ * chunks of any size, and the flash area the image is installed to.
+ * Chunks are gathered into a buffer of one erase page and each page
+ * is committed in one aligned write. A page whose contents would not
+ * change is neither erased nor written, and a blank page is written 
+ * without an erase, so an update that changes a few pages of an 
+ * image costs a few erases.
+ */
+
+typedef struct {
+    size_t bytes;           /* bytes given to the writer */
+    size_t bytes_written;   /* bytes programmed */
+    size_t writes;          /* program operations */
+    size_t pages;           /* pages committed */
+    size_t pages_erased;    /* pages erased before programming */
+    size_t pages_skipped;   /* pages left as they were */
+    uint64_t cycles;        /* cycles spent in flash operations */
+} suit_writer_stats_t;
+
+typedef struct {
+    const struct flash_area * fa;
+    uint8_t * page;         /* buffer of one erase page */
+    size_t page_size;
+    size_t offset;          /* area offset of the buffered page */
+    size_t fill;            /* bytes buffered */
+    suit_writer_stats_t stats;
+} suit_writer_t;
+
+/**
+ * @brief Initialize a writer
+ *
+ * Writing continues at offset, which need not be page aligned: the
+ * start of its page is read back from flash. This allows an install
+ * resumed from the journal (see zoot/journal.h) to carry on.
+ *
+ * @param[out]  w           Pointer to writer
+ * @param       fa          Flash area to write to
+ * @param       offset      Offset of the first byte to write
+ * @param       page        Buffer of one erase page
+ * @param       page_size   Erase page size of the area
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_writer_init(suit_writer_t * w, const struct flash_area * fa,
+        size_t offset, uint8_t * page, size_t page_size);
+
+/**
+ * @brief Write the next bytes of an image
+ *
+ * Bytes are committed to flash once their page is complete.
+ *
+ * @param       w           Pointer to writer
+ * @param       data        Pointer to bytes
+ * @param       len         Number of bytes
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_writer_write(suit_writer_t * w, const uint8_t * data, size_t len);
+
+/**
+ * @brief Commit the bytes of an incomplete page
+ *
+ * Call at the end of the image, and before recording progress in the
+ * journal. The rest of the page is left as it was if the page needs no
+ * erase, and erased otherwise.
+ *
+ * @param       w           Pointer to writer
+ *
+ * @retval      0       pass
+ * @retval      1       fail
+ */
+int suit_writer_flush(suit_writer_t * w);
+
+/**
+ * @}
+ */
+
+#endif /* SUIT_WRITER_H */
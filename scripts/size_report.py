@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+#
+# Copyright 2020 RISE Research Institutes of Sweden
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+Size and cycle report for Zoot configurations.
+
+Build the same application once per configuration, for instance the
+tests with and without the testing.ztest.minimal options, and run:
+
+    scripts/size_report.py <build_dir>[:<console_log>] ...
+
+For every build, the report lists the Zoot options that are disabled
+and the bytes of text, rodata, data and bss that the Zoot library
+contributes to zephyr.elf after linking, so that functions the linker
+dropped do not count. If the console output of test_suit_budget is
+given, the median cycles of each operation it measured are listed too.
+The first build is the reference for the differences shown.
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+# features that can be compiled out (see zephyr/Kconfig)
+FEATURES = ['ES256', 'HMAC', 'EDDSA', 'TRY_EACH', 'DEPENDENCIES', 'COPY',
+        'SWAP', 'BLOCK_DIGEST', 'SCHEDULING']
+
+SECTIONS = [('text', 'tTwW'), ('rodata', 'rR'), ('data', 'dDgG'),
+        ('bss', 'bBsS')]
+
+# either line printed by test_suit_budget
+ENTRY = re.compile(r'\{ "[^"]*", "([^"]+)", (\d+), \d+ \}')
+CHECK = re.compile(r'budget (.+?)\s+(\d+) / +\d+ cycles')
+
+
+def nm_tool(build_dir):
+    try:
+        with open(os.path.join(build_dir, 'CMakeCache.txt')) as f:
+            for line in f:
+                if line.startswith('CMAKE_NM:'):
+                    return line.split('=', 1)[1].strip()
+    except OSError:
+        pass
+    return 'nm'
+
+
+def nm(tool, path, *args):
+    out = subprocess.run([tool, '--defined-only'] + list(args) + [path],
+            stdout=subprocess.PIPE, universal_newlines=True, check=True)
+    return out.stdout.splitlines()
+
+
+def zoot_archive(build_dir):
+    for root, _, files in os.walk(build_dir):
+        for name in files:
+            if name.endswith('.a') and 'zoot' in root.split(os.sep)[-1]:
+                return os.path.join(root, name)
+    return None
+
+
+def sizes(build_dir):
+    tool = nm_tool(build_dir)
+    lib = zoot_archive(build_dir)
+    elf = os.path.join(build_dir, 'zephyr', 'zephyr.elf')
+    if lib is None or not os.path.exists(elf):
+        return None
+    names = set(line.split()[-1] for line in nm(tool, lib)
+            if len(line.split()) == 3)
+    total = dict((sec, 0) for sec, _ in SECTIONS)
+    for line in nm(tool, elf, '-S'):
+        fields = line.split()
+        if len(fields) != 4 or fields[3] not in names:
+            continue
+        for sec, kinds in SECTIONS:
+            if fields[2] in kinds:
+                total[sec] += int(fields[1], 16)
+    return total
+
+
+def disabled(build_dir):
+    off = []
+    try:
+        with open(os.path.join(build_dir, 'zephyr', '.config')) as f:
+            config = f.read()
+    except OSError:
+        return ['?']
+    for feature in FEATURES:
+        if 'CONFIG_ZOOT_%s=y' % feature not in config:
+            off.append(feature)
+    return off
+
+
+def cycles(log):
+    found = {}
+    with open(log, errors='replace') as f:
+        for line in f:
+            m = ENTRY.search(line) or CHECK.search(line)
+            if m:
+                found[m.group(1)] = int(m.group(2))
+    return found
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__.strip())
+        return 1
+
+    builds = []
+    for arg in argv[1:]:
+        build_dir, _, log = arg.partition(':')
+        total = sizes(build_dir)
+        if total is None:
+            print('no zephyr.elf or Zoot library in %s' % build_dir)
+            return 1
+        builds.append((build_dir, disabled(build_dir), total,
+                cycles(log) if log else {}))
+
+    ref = builds[0]
+    for build_dir, off, total, ops in builds:
+        print('%s: %s' % (build_dir,
+                'without ' + ', '.join(off) if off else 'all features'))
+        for sec, _ in SECTIONS:
+            print('    %-8s %8d bytes %+8d' % (sec, total[sec],
+                    total[sec] - ref[2][sec]))
+        for op in sorted(ops):
+            delta = ('%+10d' % (ops[op] - ref[3][op])) \
+                    if op in ref[3] else ''
+            print('    %-14s %10d cycles %s' % (op, ops[op], delta))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
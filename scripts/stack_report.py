@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+#
+# Copyright 2020 RISE Research Institutes of Sweden
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+# 
+#   http://www.apache.org/licenses/LICENSE-2.0
+# 
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+Static worst-case stack report for the Zoot entry points.
+
+Build with CONFIG_ZOOT_STACK_REPORT=y, which makes GCC (10 or later)
+write a call graph with per-function frame sizes (.ci) next to every
+object file, then run:
+
+    scripts/stack_report.py <build_dir> [function ...]
+
+The default functions are suit_parse_init and suit_manifest_unwrap.
+The worst case is the deepest path through the call graph. Functions
+without frame information (assembly, libraries built without the 
+option) count as zero and are listed, as are indirect calls, dynamic 
+frames and recursion, each of which makes the result a lower bound.
+"""
+
+import os
+import re
+import sys
+
+NODE = re.compile(r'node: \{ title: "([^"]+)" label: "([^"]*)"')
+EDGE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+SIZE = re.compile(r'\\n(\d+) bytes \(([a-z,]+)\)')
+
+ROOTS = ['suit_parse_init', 'suit_manifest_unwrap']
+
+
+def load(build_dir):
+    frames, kinds, calls = {}, {}, {}
+    for root, _, files in os.walk(build_dir):
+        for name in files:
+            if not name.endswith('.ci'):
+                continue
+            with open(os.path.join(root, name)) as f:
+                for line in f:
+                    m = NODE.match(line)
+                    if m:
+                        size = SIZE.search(m.group(2))
+                        if size:
+                            frames[m.group(1)] = int(size.group(1))
+                            kinds[m.group(1)] = size.group(2)
+                        continue
+                    m = EDGE.match(line)
+                    if m:
+                        calls.setdefault(m.group(1), set()).add(m.group(2))
+    return frames, kinds, calls
+
+
+def worst(fn, frames, calls, path, memo, notes):
+    if fn in path:
+        notes.add('recursion: ' + ' -> '.join(path[path.index(fn):] + [fn]))
+        return 0, []
+    if fn in memo:
+        return memo[fn]
+    if fn not in frames:
+        notes.add(('indirect call in ' + path[-1]) if fn == '__indirect_call'
+                else ('no frame information: ' + fn))
+    best, chain = 0, []
+    for callee in sorted(calls.get(fn, ())):
+        depth, sub = worst(callee, frames, calls, path + [fn], memo, notes)
+        if depth > best:
+            best, chain = depth, sub
+    memo[fn] = (frames.get(fn, 0) + best, [fn] + chain)
+    return memo[fn]
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__.strip())
+        return 1
+    frames, kinds, calls = load(argv[1])
+    if not frames:
+        print('no .ci files in %s; build with CONFIG_ZOOT_STACK_REPORT=y'
+                % argv[1])
+        return 1
+
+    for root in argv[2:] or ROOTS:
+        notes = set()
+        total, chain = worst(root, frames, calls, [], {}, notes)
+        print('%s: %d bytes' % (root, total))
+        for fn in chain:
+            kind = kinds.get(fn, 'unknown')
+            print('    %6d  %s%s' % (frames.get(fn, 0), fn,
+                    '' if kind == 'static' else ' (%s)' % kind))
+        for note in sorted(notes):
+            print('    note: ' + note)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
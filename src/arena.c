@@ -0,0 +1,187 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/suit.h>
+#include <mbedtls/platform.h>
+#include <stdlib.h>
+#include "arena.h"
+#include "pool.h"
+
+/*
+ * The arena is a stack. Every block is preceded by a header linking 
+ * it to the block below, so blocks freed in reverse order of 
+ * allocation are reclaimed at once. Other blocks are only marked as
+ * free and reclaimed together with the block above them, or when the
+ * scope exits. Nothing is ever split or searched.
+ *
+ * Zoot installs itself as the mbedTLS allocator at boot. A scope 
+ * belongs to the thread that opened it and to the pool workers running
+ * jobs for that thread. Allocations by any other thread, and all 
+ * allocations outside of a scope, are passed on to the C library: 
+ * mbedTLS cannot return the allocator it had before, so its own heap
+ * is not used once the arena is installed.
+ */
+#if defined(CONFIG_MINIMAL_LIBC) && CONFIG_MINIMAL_LIBC_MALLOC_ARENA_SIZE == 0
+#error "CONFIG_ZOOT_ARENA requires a C library heap for other allocations"
+#endif
+
+#define SUIT_ARENA_ALIGN 8
+
+typedef struct {
+    uint32_t below;     /* offset of the previous block header */
+    uint32_t freed;
+} _suit_arena_hdr_t;
+
+uint8_t __aligned(SUIT_ARENA_ALIGN) _suit_arena[CONFIG_ZOOT_ARENA_SIZE];
+
+struct {
+    struct k_spinlock lock;
+    k_tid_t owner;  /* thread that opened the scope */
+    size_t depth;   /* nested scopes of the owner */
+    size_t top;     /* first free byte */
+    size_t last;    /* header of the topmost block */
+    size_t high;    /* high-water mark */
+} _suit_arena_state = { .last = CONFIG_ZOOT_ARENA_SIZE };
+
+#define SUIT_ARENA_HDR_SIZE ROUND_UP(sizeof(_suit_arena_hdr_t), SUIT_ARENA_ALIGN)
+
+bool _suit_arena_owns(const void * ptr)
+{
+    return ((const uint8_t *) ptr >= _suit_arena && 
+            (const uint8_t *) ptr < _suit_arena + CONFIG_ZOOT_ARENA_SIZE);
+}
+
+/* true if the calling thread allocates from the arena; called locked */
+bool _suit_arena_is_member(void)
+{
+    return _suit_arena_state.depth > 0 && 
+        (k_current_get() == _suit_arena_state.owner ||
+         _suit_pool_is_worker_of(_suit_arena_state.owner));
+}
+
+/* 
+ * True if off is the header of a block allocated in the current scope;
+ * called locked. Blocks of a finished scope are not, even where the 
+ * current scope has reused their memory.
+ */
+bool _suit_arena_is_block(size_t off)
+{
+    size_t last = _suit_arena_state.last;
+    while (last != CONFIG_ZOOT_ARENA_SIZE && last > off)
+        last = ((_suit_arena_hdr_t *) &_suit_arena[last])->below;
+    return last == off;
+}
+
+void * _suit_arena_calloc(size_t n, size_t size)
+{
+    k_spinlock_key_t key = k_spin_lock(&_suit_arena_state.lock);
+    if (!_suit_arena_is_member()) {
+        k_spin_unlock(&_suit_arena_state.lock, key);
+        return calloc(n, size);
+    }
+
+    void * ptr = NULL;
+    size_t top = _suit_arena_state.top;
+    if (size == 0 || n <= (CONFIG_ZOOT_ARENA_SIZE / size)) {
+        size_t len = SUIT_ARENA_HDR_SIZE + ROUND_UP(n * size, SUIT_ARENA_ALIGN);
+        if (len <= CONFIG_ZOOT_ARENA_SIZE - top) {
+            _suit_arena_hdr_t * hdr = (_suit_arena_hdr_t *) &_suit_arena[top];
+            hdr->below = _suit_arena_state.last;
+            hdr->freed = 0;
+            _suit_arena_state.last = top;
+            _suit_arena_state.top = top + len;
+            _suit_arena_state.high = MAX(_suit_arena_state.high, 
+                    _suit_arena_state.top);
+            ptr = &_suit_arena[top + SUIT_ARENA_HDR_SIZE];
+        }
+    }
+    k_spin_unlock(&_suit_arena_state.lock, key);
+
+    if (ptr) memset(ptr, 0, n * size);
+    return ptr;
+}
+
+void _suit_arena_free(void * ptr)
+{
+    if (ptr == NULL) return;
+    if (!_suit_arena_owns(ptr)) {
+        free(ptr);
+        return;
+    }
+
+    /* blocks left over from a finished scope were already reclaimed */
+    k_spinlock_key_t key = k_spin_lock(&_suit_arena_state.lock);
+    size_t off = (uint8_t *) ptr - _suit_arena - SUIT_ARENA_HDR_SIZE;
+    if (_suit_arena_is_block(off)) {
+        _suit_arena_hdr_t * hdr = (_suit_arena_hdr_t *) &_suit_arena[off];
+        hdr->freed = 1;
+
+        /* pop every freed block off the top */
+        while (_suit_arena_state.last != CONFIG_ZOOT_ARENA_SIZE) {
+            hdr = (_suit_arena_hdr_t *) &_suit_arena[_suit_arena_state.last];
+            if (!hdr->freed) break;
+            _suit_arena_state.top = _suit_arena_state.last;
+            _suit_arena_state.last = hdr->below;
+        }
+    }
+    k_spin_unlock(&_suit_arena_state.lock, key);
+}
+
+/* a thread entering while another owns the scope uses the heap */
+void _suit_arena_enter(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&_suit_arena_state.lock);
+    if (_suit_arena_state.depth == 0)
+        _suit_arena_state.owner = k_current_get();
+    if (_suit_arena_state.owner == k_current_get())
+        _suit_arena_state.depth++;
+    k_spin_unlock(&_suit_arena_state.lock, key);
+}
+
+void _suit_arena_exit(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&_suit_arena_state.lock);
+    if (_suit_arena_state.depth > 0 && 
+            _suit_arena_state.owner == k_current_get() &&
+            --_suit_arena_state.depth == 0) {
+        _suit_arena_state.top = 0;
+        _suit_arena_state.last = CONFIG_ZOOT_ARENA_SIZE;
+    }
+    k_spin_unlock(&_suit_arena_state.lock, key);
+}
+
+size_t suit_arena_high_water(void)
+{
+    return _suit_arena_state.high;
+}
+
+void suit_arena_reset_high_water(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&_suit_arena_state.lock);
+    _suit_arena_state.high = _suit_arena_state.top;
+    k_spin_unlock(&_suit_arena_state.lock, key);
+}
+
+/* runs after the mbedTLS heap has been set up, replacing it */
+int _suit_arena_init(struct device * dev)
+{
+    ARG_UNUSED(dev);
+    return mbedtls_platform_set_calloc_free(
+            _suit_arena_calloc, _suit_arena_free);
+}
+
+SYS_INIT(_suit_arena_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
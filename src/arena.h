@@ -0,0 +1,40 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_ARENA_H
+#define SUIT_ARENA_H
+
+#include <zephyr.h>
+
+/*
+ * Marks a region in which mbedTLS (and so Cozy) allocates from the
+ * Zoot arena. Scopes nest; the arena is reset in O(1) when the
+ * outermost scope exits, so nothing allocated inside may outlive it.
+ * Only the thread that opened the scope and the pool workers running
+ * its jobs allocate from the arena; other threads use the heap, 
+ * inside a region of their own or not. Without CONFIG_ZOOT_ARENA both
+ * calls do nothing.
+ */
+#ifdef CONFIG_ZOOT_ARENA
+void _suit_arena_enter(void);
+void _suit_arena_exit(void);
+#else
+static inline void _suit_arena_enter(void) {}
+static inline void _suit_arena_exit(void) {}
+#endif
+
+#endif /* SUIT_ARENA_H */
@@ -16,72 +16,700 @@
  */
 
 #include <zoot/suit.h>
+#include <mbedtls/ecdsa.h>
+#include "pool.h"
+#include "arena.h"
 
-int suit_manifest_unwrap(const uint8_t * pem, 
-        const uint8_t * env, const size_t len_env,
-        const uint8_t ** man, size_t * len_man)
+#define COSE_TAG_MAC0   17
+#define COSE_TAG_SIGN1  18
+#define COSE_TAG_SIGN   98
+#define COSE_HDR_ALG    1
+
+/* largest Sig_structure that is materialized for EdDSA */
+#define SUIT_TBS_MAX    128
+
+/* largest COSE object written by suit_manifest_wrap_key */
+#define SUIT_COSE_MAX   160
+
+#ifdef CONFIG_ZOOT_EDDSA
+/*
+ * mbedTLS does not implement Ed25519. Applications enabling EdDSA 
+ * provide these two functions (e.g., from Monocypher or TweetNaCl).
+ */
+extern int suit_ed25519_verify(const uint8_t * pub,
+        const uint8_t * msg, size_t len_msg, const uint8_t * sig);
+extern int suit_ed25519_sign(const uint8_t * prv,
+        const uint8_t * msg, size_t len_msg, uint8_t * sig);
+#endif
+
+/*
+ * Pinned keys are parsed once and kept for the lifetime of the 
+ * device. When an ECDSA key is pinned, the generator is multiplied
+ * once so that mbedTLS builds its fixed-base comb table and caches it
+ * in the key's group. Every later verification reuses that table,
+ * which also leaves the group read-only during verification. The 
+ * table for the public point itself is not cached by mbedTLS.
+ */
+int suit_key_init(suit_key_t * key, const uint8_t * pem)
 {
-    /* initialize COSE Sign1 context for authentication wrapper */
-    cose_sign_context_t ctx;
-    if (cose_sign_init(&ctx, cose_mode_r, pem)) return 1;
+#ifdef CONFIG_ZOOT_ES256
+    key->alg = suit_auth_alg_es256;
+    key->raw = NULL;
+    key->len_raw = 0;
+    mbedtls_pk_init(&key->pk);
+    if (mbedtls_pk_parse_public_key(&key->pk, pem, 
+                strlen((const char *) pem) + 1) ||
+            !mbedtls_pk_can_do(&key->pk, MBEDTLS_PK_ECDSA)) {
+        mbedtls_pk_free(&key->pk);
+        return 1;
+    }
 
-    /* seek to beginning of authentication wrapper */
-    uint8_t * auth;
-    size_t len_auth;
-    nanocbor_value_t nc, map, arr;
+    /* precompute the comb table for the generator */
+    mbedtls_ecp_keypair * ec = mbedtls_pk_ec(key->pk);
+    mbedtls_ecp_point R;
+    mbedtls_mpi one;
+    mbedtls_ecp_point_init(&R);
+    mbedtls_mpi_init(&one);
+    int err = mbedtls_mpi_lset(&one, 1) ||
+        mbedtls_ecp_mul(&ec->grp, &R, &one, &ec->grp.G, NULL, NULL);
+    mbedtls_ecp_point_free(&R);
+    mbedtls_mpi_free(&one);
+
+    if (err) mbedtls_pk_free(&key->pk);
+    return err;
+#else
+    return 1;
+#endif
+}
+
+/*
+ * Symmetric and Ed25519 keys are copied by reference. The caller must
+ * keep the key material in place for as long as the key is in use.
+ */
+int suit_key_init_hmac(suit_key_t * key,
+        const uint8_t * secret, size_t len_secret)
+{
+#ifdef CONFIG_ZOOT_HMAC
+    if (len_secret == 0) return 1;
+    key->alg = suit_auth_alg_hmac_256;
+    key->raw = secret;
+    key->len_raw = len_secret;
+    mbedtls_pk_init(&key->pk);
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+int suit_key_init_ed25519(suit_key_t * key,
+        const uint8_t * raw, size_t len_raw)
+{
+#ifdef CONFIG_ZOOT_EDDSA
+    if (len_raw != 32 && len_raw != 64) return 1;
+    key->alg = suit_auth_alg_eddsa;
+    key->raw = raw;
+    key->len_raw = len_raw;
+    mbedtls_pk_init(&key->pk);
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+void suit_key_free(suit_key_t * key)
+{
+    mbedtls_pk_free(&key->pk);
+}
+
+/* 
+ * Consumes an optional CBOR tag in front of a COSE object. Only the
+ * head is consumed; the tagged item still counts as one element of
+ * the enclosing container.
+ */
+int _suit_get_tag(nanocbor_value_t * nc, uint32_t * tag)
+{
+    if (nanocbor_get_type(nc) != NANOCBOR_TYPE_TAG) return 1;
+    uint8_t info = *nc->cur & 0x1f;
+    size_t len = (info < 24) ? 0 : (info == 24) ? 1 : (info == 25) ? 2 : 4;
+    if (info > 26 || nc->cur + 1 + len >= nc->end) return 1;
+    *tag = (len == 0) ? info : 0;
+    for (size_t i = 0; i < len; i++)
+        *tag = (*tag << 8) | nc->cur[1 + i];
+    nc->cur += 1 + len;
+    return 0;
+}
+
+/* compares two buffers without exiting early on the first mismatch */
+bool _suit_equal_ct(const uint8_t * a, const uint8_t * b, size_t len)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++)
+        diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+/*
+ * The to-be-signed (or to-be-MACed) structure is streamed to one of
+ * these sinks, so that it never has to be materialized for the
+ * algorithms that hash it first.
+ */
+typedef void (*_suit_tbs_sink_t)(void * arg, const uint8_t * buf, size_t len);
+
+void _suit_tbs_sink_md(void * arg, const uint8_t * buf, size_t len)
+{
+    mbedtls_md_update((mbedtls_md_context_t *) arg, buf, len);
+}
+
+void _suit_tbs_sink_hmac(void * arg, const uint8_t * buf, size_t len)
+{
+    mbedtls_md_hmac_update((mbedtls_md_context_t *) arg, buf, len);
+}
+
+void _suit_tbs_sink_buf(void * arg, const uint8_t * buf, size_t len)
+{
+    nanocbor_encoder_t * nc = (nanocbor_encoder_t *) arg;
+    if (nc->cur + len > nc->end) { nc->cur = nc->end + 1; return; }
+    memcpy(nc->cur, buf, len);
+    nc->cur += len;
+}
+
+/*
+ * Emits the encoded COSE Sig_structure or MAC_structure (RFC 8152
+ * Sections 4.4 and 6.3). The signer's protected header is only part
+ * of the structure for COSE_Sign, and is NULL otherwise. The external
+ * AAD is always empty.
+ */
+void _suit_cose_tbs(_suit_tbs_sink_t sink, void * arg, const char * tag,
+        const uint8_t * prot, size_t len_prot,
+        const uint8_t * sign_prot, size_t len_sign_prot,
+        const uint8_t * pld, size_t len_pld)
+{
+    uint8_t hdr[32];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, hdr, sizeof(hdr));
+    nanocbor_fmt_array(&nc, sign_prot ? 5 : 4);
+    nanocbor_put_tstr(&nc, tag);
+    nanocbor_fmt_bstr(&nc, len_prot);
+    sink(arg, hdr, nanocbor_encoded_len(&nc));
+    sink(arg, prot, len_prot);
+
+    if (sign_prot) {
+        nanocbor_encoder_init(&nc, hdr, sizeof(hdr));
+        nanocbor_fmt_bstr(&nc, len_sign_prot);
+        sink(arg, hdr, nanocbor_encoded_len(&nc));
+        sink(arg, sign_prot, len_sign_prot);
+    }
+
+    nanocbor_encoder_init(&nc, hdr, sizeof(hdr));
+    nanocbor_fmt_bstr(&nc, 0);
+    nanocbor_fmt_bstr(&nc, len_pld);
+    sink(arg, hdr, nanocbor_encoded_len(&nc));
+    sink(arg, pld, len_pld);
+}
+
+#ifdef CONFIG_ZOOT_ES256
+/*
+ * Verifies an ES256 signature given either as the raw r|s pair used
+ * by COSE or as an ASN.1 sequence.
+ */
+int _suit_ecdsa_verify(suit_key_t * key, const uint8_t * hash,
+        size_t len_hash, const uint8_t * sig, size_t len_sig)
+{
+    mbedtls_ecp_keypair * ec = mbedtls_pk_ec(key->pk);
+    if (len_sig != 64)
+        return mbedtls_ecdsa_read_signature(ec, hash, len_hash, 
+                sig, len_sig) != 0;
+
+    mbedtls_mpi r, s;
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    int err = mbedtls_mpi_read_binary(&r, sig, 32) ||
+        mbedtls_mpi_read_binary(&s, sig + 32, 32) ||
+        mbedtls_ecdsa_verify(&ec->grp, hash, len_hash, &ec->Q, &r, &s);
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&s);
+    return err;
+}
+#endif
+
+/*
+ * One signature or MAC found in an authentication wrapper, together
+ * with the parts of the COSE message it was computed over. The tag is
+ * the context string of the to-be-signed structure.
+ */
+typedef struct {
+    const char * tag;
+    int32_t alg;
+    const uint8_t * prot; size_t len_prot;
+    const uint8_t * sign_prot; size_t len_sign_prot;
+    const uint8_t * pld; size_t len_pld;
+    const uint8_t * sig; size_t len_sig;
+} _suit_sig_t;
+
+/* checks a signature or MAC against one key */
+int _suit_cose_check(suit_key_t * key, const _suit_sig_t * sig)
+{
+#if defined(CONFIG_ZOOT_ES256) || defined(CONFIG_ZOOT_HMAC)
+    const mbedtls_md_info_t * md_info =
+        mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    size_t md_size = mbedtls_md_get_size(md_info);
+    uint8_t hash[MBEDTLS_MD_MAX_SIZE];
+    mbedtls_md_context_t md;
+#endif
+    int err = 1;
+
+    switch (key->alg) {
+
+#ifdef CONFIG_ZOOT_ES256
+        /* ES256 signs the SHA-256 digest of the Sig_structure */
+        case suit_auth_alg_es256:
+            mbedtls_md_init(&md);
+            if (mbedtls_md_setup(&md, md_info, 0)) break;
+            mbedtls_md_starts(&md);
+            _suit_cose_tbs(_suit_tbs_sink_md, &md, sig->tag,
+                    sig->prot, sig->len_prot, 
+                    sig->sign_prot, sig->len_sign_prot,
+                    sig->pld, sig->len_pld);
+            mbedtls_md_finish(&md, hash);
+            mbedtls_md_free(&md);
+            err = _suit_ecdsa_verify(key, hash, md_size, 
+                    sig->sig, sig->len_sig);
+            break;
+#endif
+
+#ifdef CONFIG_ZOOT_HMAC
+        /* HMAC 256/256 tags are compared in constant time */
+        case suit_auth_alg_hmac_256:
+            if (sig->len_sig != md_size) break;
+            mbedtls_md_init(&md);
+            if (mbedtls_md_setup(&md, md_info, 1)) break;
+            mbedtls_md_hmac_starts(&md, key->raw, key->len_raw);
+            _suit_cose_tbs(_suit_tbs_sink_hmac, &md, sig->tag,
+                    sig->prot, sig->len_prot, NULL, 0,
+                    sig->pld, sig->len_pld);
+            mbedtls_md_hmac_finish(&md, hash);
+            mbedtls_md_free(&md);
+            err = !_suit_equal_ct(hash, sig->sig, md_size);
+            break;
+#endif
+
+#ifdef CONFIG_ZOOT_EDDSA
+        /* PureEdDSA signs the Sig_structure itself */
+        case suit_auth_alg_eddsa: {
+            uint8_t tbs[SUIT_TBS_MAX];
+            nanocbor_encoder_t nc;
+            nanocbor_encoder_init(&nc, tbs, sizeof(tbs));
+            _suit_cose_tbs(_suit_tbs_sink_buf, &nc, sig->tag,
+                    sig->prot, sig->len_prot, 
+                    sig->sign_prot, sig->len_sign_prot,
+                    sig->pld, sig->len_pld);
+            if (nc.cur > nc.end || sig->len_sig != 64) break;
+            err = suit_ed25519_verify(key->raw + key->len_raw - 32,
+                    tbs, nc.cur - tbs, sig->sig) != 0;
+            break;
+        }
+#endif
+
+        default: break;
+    }
+    return err;
+}
+
+/*
+ * Returns the algorithm named in an encoded protected header, or 0
+ * if there is none.
+ */
+int32_t _suit_cose_alg(const uint8_t * prot, size_t len_prot)
+{
+    nanocbor_value_t nc, map;
+    int32_t map_key, alg = 0;
+    nanocbor_decoder_init(&nc, prot, len_prot);
+    if (nanocbor_enter_map(&nc, &map) < 0) return 0;
+    while (!nanocbor_at_end(&map)) {
+        if (nanocbor_get_int32(&map, &map_key) < 0) return 0;
+        if (map_key == COSE_HDR_ALG) {
+            if (nanocbor_get_int32(&map, &alg) < 0) return 0;
+        } else if (nanocbor_skip(&map) < 0) return 0;
+    }
+    return alg;
+}
+
+/*
+ * Signatures are checked against an m-of-n policy: the envelope is
+ * accepted once threshold distinct keys have each verified at least 
+ * one signature. Every (signature, key) pair with matching algorithms
+ * is a job for the worker pool. The decision is taken as soon as it 
+ * is settled, either way, and the remaining jobs are dropped.
+ */
+typedef struct {
+    _suit_sig_t sigs[CONFIG_ZOOT_MAX_SIGNATURES];
+    size_t sig_count;
+
+    suit_key_t * keys;
+    size_t key_count;
+    size_t threshold;
+
+    struct k_spinlock lock;
+    uint32_t verified;              /* keys with a valid signature */
+    uint8_t pending[SUIT_MAX_KEYS]; /* unchecked jobs per key */
+    int decision;                   /* -1 open, 0 pass, 1 fail */
+} _suit_policy_t;
+
+int _suit_policy_add(_suit_policy_t * pol, const _suit_sig_t * sig)
+{
+    if (pol->sig_count == CONFIG_ZOOT_MAX_SIGNATURES) return 1;
+    pol->sigs[pol->sig_count++] = *sig;
+    for (size_t k = 0; k < pol->key_count; k++)
+        if (pol->keys[k].alg == sig->alg) pol->pending[k]++;
+    return 0;
+}
+
+/* must be called with the policy lock held */
+void _suit_policy_decide(_suit_policy_t * pol)
+{
+    size_t verified = 0, possible = 0;
+    for (size_t k = 0; k < pol->key_count; k++) {
+        if (pol->verified & BIT(k)) verified++;
+        else if (pol->pending[k]) possible++;
+    }
+    if (verified >= pol->threshold) pol->decision = 0;
+    else if (verified + possible < pol->threshold) pol->decision = 1;
+}
+
+int _suit_policy_job(void * arg, size_t idx)
+{
+    _suit_policy_t * pol = arg;
+    _suit_sig_t * sig = &pol->sigs[idx / pol->key_count];
+    size_t k = idx % pol->key_count;
+    if (pol->keys[k].alg != sig->alg) return 0;
+
+    /* skip checks that can no longer change the outcome */
+    k_spinlock_key_t lock = k_spin_lock(&pol->lock);
+    bool skip = (pol->decision >= 0) || (pol->verified & BIT(k));
+    k_spin_unlock(&pol->lock, lock);
+    int err = skip ? 1 : _suit_cose_check(&pol->keys[k], sig);
+
+    lock = k_spin_lock(&pol->lock);
+    pol->pending[k]--;
+    if (!err) pol->verified |= BIT(k);
+    if (pol->decision < 0) _suit_policy_decide(pol);
+    int done = (pol->decision >= 0);
+    k_spin_unlock(&pol->lock, lock);
+    return done;
+}
+
+/* checks that a wrapper payload [alg, digest] names the manifest */
+bool _suit_payload_is_match(const uint8_t * pld, size_t len_pld,
+        const uint8_t * hash, size_t len_hash)
+{
+    nanocbor_value_t nc, arr;
+    uint32_t alg;
+    const uint8_t * digest;
+    size_t len_digest;
+    nanocbor_decoder_init(&nc, pld, len_pld);
+    if (nanocbor_enter_array(&nc, &arr) < 0) return false;
+    if (nanocbor_get_uint32(&arr, &alg) < 0) return false;
+    if (nanocbor_get_bstr(&arr, &digest, &len_digest) < 0) return false;
+    return (alg == suit_digest_alg_sha256 && len_digest == len_hash &&
+            !memcmp(digest, hash, len_hash));
+}
+
+/*
+ * Collects the signatures of one authentication wrapper entry. COSE
+ * Sign1 and COSE_Mac0 share the layout [protected, unprotected, 
+ * payload, signature/tag]; COSE_Sign replaces the last element by an
+ * array of [protected, unprotected, signature], one per signer. 
+ * Entries that do not vouch for this manifest are ignored.
+ */
+int _suit_cose_collect(_suit_policy_t * pol,
+        const uint8_t * obj, size_t len_obj,
+        const uint8_t * hash, size_t len_hash)
+{
+    nanocbor_value_t nc, arr, sigs, elem;
+    nanocbor_decoder_init(&nc, obj, len_obj);
+    uint32_t tag = 0;
+    _suit_get_tag(&nc, &tag);
+
+    _suit_sig_t sig = { .sign_prot = NULL, .len_sign_prot = 0 };
+    if (nanocbor_enter_array(&nc, &arr) < 0) return 1;
+    if (nanocbor_get_bstr(&arr, &sig.prot, &sig.len_prot) < 0) return 1;
+    if (nanocbor_skip(&arr) < 0) return 1;
+    if (nanocbor_get_bstr(&arr, &sig.pld, &sig.len_pld) < 0) return 1;
+    if (!_suit_payload_is_match(sig.pld, sig.len_pld, hash, len_hash)) 
+        return 0;
+
+    /* COSE_Sign */
+    if (tag == COSE_TAG_SIGN) {
+        sig.tag = "Signature";
+        if (nanocbor_enter_array(&arr, &sigs) < 0) return 1;
+        while (!nanocbor_at_end(&sigs)) {
+            if (nanocbor_enter_array(&sigs, &elem) < 0) return 1;
+            if (nanocbor_get_bstr(&elem, 
+                        &sig.sign_prot, &sig.len_sign_prot) < 0) 
+                return 1;
+            if (nanocbor_skip(&elem) < 0) return 1;
+            if (nanocbor_get_bstr(&elem, &sig.sig, &sig.len_sig) < 0) 
+                return 1;
+            sig.alg = _suit_cose_alg(sig.sign_prot, sig.len_sign_prot);
+            if (sig.alg == suit_auth_alg_hmac_256) return 1;
+            if (_suit_policy_add(pol, &sig)) return 1;
+            nanocbor_skip(&sigs);
+        }
+        return 0;
+    }
+
+    /* COSE Sign1 or COSE_Mac0, told apart by the algorithm */
+    if (nanocbor_get_bstr(&arr, &sig.sig, &sig.len_sig) < 0) return 1;
+    sig.alg = _suit_cose_alg(sig.prot, sig.len_prot);
+    bool mac = (sig.alg == suit_auth_alg_hmac_256);
+    if (tag && tag != (mac ? COSE_TAG_MAC0 : COSE_TAG_SIGN1)) return 1;
+    sig.tag = mac ? "MAC0" : "Signature1";
+    return _suit_policy_add(pol, &sig);
+}
+
+/*
+ * Writes a COSE_Mac0 or COSE_Sign1 object for HMAC and EdDSA keys.
+ * ES256 signing needs a random source and is left to Cozy.
+ */
+int _suit_cose_write(suit_key_t * key,
+        const uint8_t * pld, size_t len_pld,
+        uint8_t * obj, size_t * len_obj)
+{
+    /* protected header = {alg} */
+    uint8_t prot[8];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, prot, sizeof(prot));
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_int(&nc, COSE_HDR_ALG);
+    nanocbor_fmt_int(&nc, key->alg);
+    size_t len_prot = nanocbor_encoded_len(&nc);
+
+    uint8_t sig[64];
+    size_t len_sig = 0;
+    bool mac = (key->alg == suit_auth_alg_hmac_256);
+#ifdef CONFIG_ZOOT_HMAC
+    if (mac) {
+        const mbedtls_md_info_t * md_info =
+            mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+        mbedtls_md_context_t md;
+        mbedtls_md_init(&md);
+        if (mbedtls_md_setup(&md, md_info, 1)) return 1;
+        mbedtls_md_hmac_starts(&md, key->raw, key->len_raw);
+        _suit_cose_tbs(_suit_tbs_sink_hmac, &md, "MAC0", 
+                prot, len_prot, NULL, 0, pld, len_pld);
+        mbedtls_md_hmac_finish(&md, sig);
+        mbedtls_md_free(&md);
+        len_sig = mbedtls_md_get_size(md_info);
+    }
+#endif
+#ifdef CONFIG_ZOOT_EDDSA
+    if (key->alg == suit_auth_alg_eddsa && key->len_raw == 64) {
+        uint8_t tbs[SUIT_TBS_MAX];
+        nanocbor_encoder_init(&nc, tbs, sizeof(tbs));
+        _suit_cose_tbs(_suit_tbs_sink_buf, &nc, "Signature1", 
+                prot, len_prot, NULL, 0, pld, len_pld);
+        if (nc.cur > nc.end) return 1;
+        if (suit_ed25519_sign(key->raw, tbs, nc.cur - tbs, sig)) return 1;
+        len_sig = 64;
+    }
+#endif
+    if (len_sig == 0) return 1;
+
+    /* COSE_Mac0/COSE_Sign1 = [protected, {}, payload, tag/signature] */
+    nanocbor_encoder_init(&nc, obj, *len_obj);
+    nanocbor_fmt_tag(&nc, mac ? COSE_TAG_MAC0 : COSE_TAG_SIGN1);
+    nanocbor_fmt_array(&nc, 4);
+    nanocbor_put_bstr(&nc, prot, len_prot);
+    nanocbor_fmt_map(&nc, 0);
+    nanocbor_put_bstr(&nc, pld, len_pld);
+    nanocbor_put_bstr(&nc, sig, len_sig);
+    if (nanocbor_encoded_len(&nc) > *len_obj) return 1;
+    *len_obj = nanocbor_encoded_len(&nc);
+    return 0;
+}
+
+/*
+ * Locates the authentication wrapper and the manifest in a SUIT
+ * envelope. The manifest is returned together with its CBOR byte 
+ * string header, since that is what the wrapper digest covers.
+ */
+int _suit_envelope_parse(const uint8_t * env, size_t len_env,
+        const uint8_t ** auth, size_t * len_auth,
+        const uint8_t ** wrp, size_t * len_wrp)
+{
+    nanocbor_value_t nc, map;
     nanocbor_decoder_init(&nc, env, len_env);
     if (nanocbor_enter_map(&nc, &map) < 0) return 1;
-    int32_t map_key;
+
+    *auth = NULL; *wrp = NULL;
+    uint32_t map_key;
     while (!nanocbor_at_end(&map)) {
+
+        /* integrated payloads have text keys (see payload.c) */
+        if (nanocbor_get_type(&map) == NANOCBOR_TYPE_TSTR) {
+            if (nanocbor_skip(&map) < 0) return 1;
+            if (nanocbor_skip(&map) < 0) return 1;
+            continue;
+        }
         if (nanocbor_get_uint32(&map, &map_key) < 0) return 1;
         if (map_key == suit_envelope_authentication_wrapper) {
-            if (nanocbor_get_bstr(&map, (const uint8_t **) &auth, &len_auth) < 0) 
-                return 1;
-            break;
-        }
-        nanocbor_skip(&map);
+            if (nanocbor_get_bstr(&map, auth, len_auth) < 0) return 1;
+        } else if (map_key == suit_envelope_manifest) {
+            *wrp = map.cur;
+            if (nanocbor_skip(&map) < 0) return 1;
+            *len_wrp = map.cur - *wrp;
+        } else nanocbor_skip(&map);
     }
-    nanocbor_decoder_init(&nc, auth, len_auth);
-    if (nanocbor_enter_array(&nc, &arr) < 0) return 1;
-
-    /* verify signature on authentication wrapper and get payload */ 
-    uint8_t * pld;
-    size_t len_pld;
-    if (cose_sign1_read(&ctx, arr.cur, arr.end - arr.cur, 
-                (const uint8_t **) &pld, &len_pld)) return 1;
+    return (*auth == NULL || *wrp == NULL);
+}
 
+/*
+ * Checks the manifest digest carried in an authenticated wrapper 
+ * payload and returns the manifest without its byte string header.
+ */
+int _suit_envelope_check_digest(const uint8_t * pld, size_t len_pld,
+        const uint8_t * wrp, size_t len_wrp,
+        const uint8_t ** man, size_t * len_man)
+{
     /* extract the manifest hash */
-    uint8_t * hash;
+    const uint8_t * hash;
     size_t len_hash;
+    nanocbor_value_t nc, arr;
     nanocbor_decoder_init(&nc, pld, len_pld);
     if (nanocbor_enter_array(&nc, &arr) < 0) return 1;
     nanocbor_skip(&arr);
-    if (nanocbor_get_bstr(&arr, (const uint8_t **) &hash, &len_hash) < 0) return 1;
+    if (nanocbor_get_bstr(&arr, &hash, &len_hash) < 0) return 1;
 
-    /* extract manifest with CBOR byte string header */
-    while (!nanocbor_at_end(&map)) {
-        if (nanocbor_get_uint32(&map, &map_key) < 0) return 1;
-        if (map_key == suit_envelope_manifest) break;
-        nanocbor_skip(&map);
-    }
-
-    /* compute hash and write it to the end of the output buffer */
+    /* compute hash over the manifest with CBOR byte string header */
     const mbedtls_md_info_t * md_info =
         mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
     size_t md_size = mbedtls_md_get_size(md_info);
-    uint8_t hash_out[md_size];
-    mbedtls_md(md_info, map.cur, (map.end - map.cur), hash_out);
+    uint8_t hash_out[MBEDTLS_MD_MAX_SIZE];
+    if (len_hash != md_size) return 1;
+    mbedtls_md(md_info, wrp, len_wrp, hash_out);
     if (memcmp(hash, hash_out, md_size)) return 1;
 
     /* return the manifest contents without the byte string header */
-    if (nanocbor_get_bstr(&map, man, len_man) < 0) return 1;
+    nanocbor_decoder_init(&nc, wrp, len_wrp);
+    if (nanocbor_get_bstr(&nc, man, len_man) < 0) return 1;
+    return 0;
+}
+
+int _suit_manifest_unwrap(cose_sign_context_t * ctx,
+        const uint8_t * env, const size_t len_env,
+        const uint8_t ** man, size_t * len_man)
+{
+    /* seek to beginning of authentication wrapper */
+    const uint8_t * auth, * wrp;
+    size_t len_auth, len_wrp;
+    if (_suit_envelope_parse(env, len_env, &auth, &len_auth, &wrp, &len_wrp))
+        return 1;
+    nanocbor_value_t nc, arr;
+    nanocbor_decoder_init(&nc, auth, len_auth);
+    if (nanocbor_enter_array(&nc, &arr) < 0) return 1;
+
+    /* verify signature on authentication wrapper and get payload */ 
+    const uint8_t * pld;
+    size_t len_pld;
+    if (cose_sign1_read(ctx, arr.cur, arr.end - arr.cur, &pld, &len_pld)) 
+        return 1;
+
+    return _suit_envelope_check_digest(pld, len_pld, wrp, len_wrp, 
+            man, len_man);
+}
+
+int suit_manifest_unwrap(const uint8_t * pem, 
+        const uint8_t * env, const size_t len_env,
+        const uint8_t ** man, size_t * len_man)
+{
+#ifdef CONFIG_ZOOT_ES256
+    /* initialize COSE Sign1 context for authentication wrapper */
+    _suit_arena_enter();
+    cose_sign_context_t ctx;
+    int err = cose_sign_init(&ctx, cose_mode_r, pem);
+    if (!err) {
+        err = _suit_manifest_unwrap(&ctx, env, len_env, man, len_man);
+        cose_sign_free(&ctx);
+    }
 
     /* clean up */
-    cose_sign_free(&ctx);
+    _suit_arena_exit();
+    return err;
+#else
+    return 1;
+#endif
+}
+
+int suit_manifest_unwrap_key(suit_key_t * key,
+        const uint8_t * env, const size_t len_env,
+        const uint8_t ** man, size_t * len_man)
+{
+    return suit_manifest_unwrap_multi(key, 1, 1, env, len_env, 
+            man, len_man);
+}
+
+int _suit_manifest_unwrap_multi(suit_key_t * keys, size_t key_count,
+        size_t threshold, const uint8_t * env, const size_t len_env,
+        const uint8_t ** man, size_t * len_man)
+{
+    if (key_count == 0 || key_count > SUIT_MAX_KEYS ||
+            threshold == 0 || threshold > key_count)
+        return 1;
+
+    const uint8_t * auth, * wrp;
+    size_t len_auth, len_wrp;
+    if (_suit_envelope_parse(env, len_env, &auth, &len_auth, &wrp, &len_wrp))
+        return 1;
+
+    /* every wrapper entry must commit to this digest */
+    const mbedtls_md_info_t * md_info =
+        mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    size_t md_size = mbedtls_md_get_size(md_info);
+    uint8_t hash[MBEDTLS_MD_MAX_SIZE];
+    mbedtls_md(md_info, wrp, len_wrp, hash);
+
+    /* gather the signatures from all wrapper entries */
+    _suit_policy_t pol = {
+        .sig_count = 0,
+        .keys = keys, .key_count = key_count, .threshold = threshold,
+        .verified = 0, .decision = -1,
+    };
+    memset(pol.pending, 0, sizeof(pol.pending));
+    nanocbor_value_t nc, arr;
+    nanocbor_decoder_init(&nc, auth, len_auth);
+    if (nanocbor_enter_array(&nc, &arr) < 0) return 1;
+    while (!nanocbor_at_end(&arr)) {
+        const uint8_t * obj = arr.cur;
+        if (nanocbor_skip(&arr) < 0) return 1;
+        if (_suit_cose_collect(&pol, obj, arr.cur - obj, hash, md_size))
+            return 1;
+    }
+
+    /* check signatures until the policy is decided */
+    _suit_policy_decide(&pol);
+    if (pol.decision < 0)
+        _suit_parallel_for(pol.sig_count * key_count, 0, 
+                _suit_policy_job, &pol);
+    if (pol.decision != 0) return 1;
+
+    /* return the manifest contents without the byte string header */
+    nanocbor_decoder_init(&nc, wrp, len_wrp);
+    if (nanocbor_get_bstr(&nc, man, len_man) < 0) return 1;
     return 0;
 }
 
-int suit_manifest_wrap(const uint8_t * pem,
+int suit_manifest_unwrap_multi(suit_key_t * keys, size_t key_count,
+        size_t threshold, const uint8_t * env, const size_t len_env,
+        const uint8_t ** man, size_t * len_man)
+{
+    _suit_arena_enter();
+    int err = _suit_manifest_unwrap_multi(keys, key_count, threshold,
+            env, len_env, man, len_man);
+    _suit_arena_exit();
+    return err;
+}
+
+int _suit_manifest_wrap(const uint8_t * pem,
         const uint8_t * man, const size_t len_man,
         uint8_t * env, size_t * len_env)
 {
@@ -136,3 +764,224 @@ int suit_manifest_wrap(const uint8_t * pem,
     cose_sign_free(&ctx);
     return 0;
 }
+
+int suit_manifest_wrap(const uint8_t * pem,
+        const uint8_t * man, const size_t len_man,
+        uint8_t * env, size_t * len_env)
+{
+#ifdef CONFIG_ZOOT_ES256
+    _suit_arena_enter();
+    int err = _suit_manifest_wrap(pem, man, len_man, env, len_env);
+    _suit_arena_exit();
+    return err;
+#else
+    return 1;
+#endif
+}
+
+int _suit_manifest_wrap_key(suit_key_t * key,
+        const uint8_t * man, const size_t len_man,
+        uint8_t * env, size_t * len_env)
+{
+    /* hash the manifest together with its byte string header */
+    const mbedtls_md_info_t * md_info =
+        mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    size_t md_size = mbedtls_md_get_size(md_info);
+    uint8_t hdr[9], hash[MBEDTLS_MD_MAX_SIZE];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, hdr, sizeof(hdr));
+    nanocbor_fmt_bstr(&nc, len_man);
+    mbedtls_md_context_t md;
+    mbedtls_md_init(&md);
+    if (mbedtls_md_setup(&md, md_info, 0)) return 1;
+    mbedtls_md_starts(&md);
+    mbedtls_md_update(&md, hdr, nanocbor_encoded_len(&nc));
+    mbedtls_md_update(&md, man, len_man);
+    mbedtls_md_finish(&md, hash);
+    mbedtls_md_free(&md);
+
+    /* serialize the authentication wrapper payload */
+    uint8_t pld[MBEDTLS_MD_MAX_SIZE + 4];
+    nanocbor_encoder_init(&nc, pld, sizeof(pld));
+    nanocbor_fmt_array(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+    nanocbor_put_bstr(&nc, hash, md_size);
+
+    /* authenticate the payload */
+    uint8_t obj[SUIT_COSE_MAX];
+    size_t len_obj = sizeof(obj);
+    if (_suit_cose_write(key, pld, nanocbor_encoded_len(&nc), 
+                obj, &len_obj)) 
+        return 1;
+
+    /* encode the envelope header and the authentication wrapper */
+    nanocbor_encoder_init(&nc, env, *len_env);
+    nanocbor_fmt_map(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_envelope_authentication_wrapper);
+    nanocbor_fmt_bstr(&nc, len_obj + 1);
+    nanocbor_fmt_array(&nc, 1);
+    size_t len = nanocbor_encoded_len(&nc);
+    if (len + len_obj > *len_env) return 1;
+    memcpy(env + len, obj, len_obj);
+    len += len_obj;
+
+    /* encode the manifest */
+    nanocbor_encoder_init(&nc, env + len, *len_env - len);
+    nanocbor_fmt_uint(&nc, suit_envelope_manifest);
+    nanocbor_fmt_bstr(&nc, len_man);
+    len += nanocbor_encoded_len(&nc);
+    if (len + len_man > *len_env) return 1;
+    memcpy(env + len, man, len_man);
+    *len_env = len + len_man;
+    return 0;
+}
+
+int suit_manifest_wrap_key(suit_key_t * key,
+        const uint8_t * man, const size_t len_man,
+        uint8_t * env, size_t * len_env)
+{
+    _suit_arena_enter();
+    int err = _suit_manifest_wrap_key(key, man, len_man, env, len_env);
+    _suit_arena_exit();
+    return err;
+}
+
+/*
+ * Computes the authentication wrapper payload [alg, digest] for the
+ * manifest of an existing envelope.
+ */
+int _suit_envelope_payload(const uint8_t * env, size_t len_env,
+        uint8_t * pld, size_t * len_pld)
+{
+    const uint8_t * auth, * wrp;
+    size_t len_auth, len_wrp;
+    if (_suit_envelope_parse(env, len_env, &auth, &len_auth, &wrp, &len_wrp))
+        return 1;
+
+    const mbedtls_md_info_t * md_info =
+        mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    size_t md_size = mbedtls_md_get_size(md_info);
+    uint8_t hash[MBEDTLS_MD_MAX_SIZE];
+    mbedtls_md(md_info, wrp, len_wrp, hash);
+
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, pld, *len_pld);
+    nanocbor_fmt_array(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+    nanocbor_put_bstr(&nc, hash, md_size);
+    if (nanocbor_encoded_len(&nc) > *len_pld) return 1;
+    *len_pld = nanocbor_encoded_len(&nc);
+    return 0;
+}
+
+/*
+ * Appends a COSE object to the authentication wrapper of an envelope
+ * in place. Everything after the wrapper is moved up to make room, 
+ * then the entries are moved behind the (possibly longer) byte string
+ * and array headers.
+ */
+int _suit_envelope_add_wrapper(uint8_t * env, size_t * len_env, 
+        size_t size_env, const uint8_t * obj, size_t len_obj)
+{
+    const uint8_t * auth, * wrp;
+    size_t len_auth, len_wrp;
+    if (_suit_envelope_parse(env, *len_env, &auth, &len_auth, &wrp, &len_wrp))
+        return 1;
+
+    /* count the existing entries */
+    nanocbor_value_t nc, arr;
+    nanocbor_decoder_init(&nc, auth, len_auth);
+    if (nanocbor_enter_array(&nc, &arr) < 0) return 1;
+    const uint8_t * entries = arr.cur;
+    size_t len_entries = auth + len_auth - entries;
+    size_t count = 0;
+    while (!nanocbor_at_end(&arr)) {
+        if (nanocbor_skip(&arr) < 0) return 1;
+        count++;
+    }
+    if (count >= CONFIG_ZOOT_MAX_SIGNATURES) return 1;
+
+    /* encode the new headers */
+    uint8_t hdr_arr[9], hdr_bstr[9], hdr_old[9];
+    nanocbor_encoder_t enc;
+    nanocbor_encoder_init(&enc, hdr_arr, sizeof(hdr_arr));
+    nanocbor_fmt_array(&enc, count + 1);
+    size_t len_hdr_arr = nanocbor_encoded_len(&enc);
+    size_t len_new = len_hdr_arr + len_entries + len_obj;
+    nanocbor_encoder_init(&enc, hdr_bstr, sizeof(hdr_bstr));
+    nanocbor_fmt_bstr(&enc, len_new);
+    size_t len_hdr_bstr = nanocbor_encoded_len(&enc);
+    nanocbor_encoder_init(&enc, hdr_old, sizeof(hdr_old));
+    nanocbor_fmt_bstr(&enc, len_auth);
+
+    /* make room behind the wrapper */
+    size_t off = (auth - env) - nanocbor_encoded_len(&enc);
+    size_t end = auth + len_auth - env;
+    size_t grow = len_hdr_bstr + len_new - (end - off);
+    if (*len_env + grow > size_env) return 1;
+    memmove(env + end + grow, env + end, *len_env - end);
+
+    /* move the entries, then write the headers and the new entry */
+    uint8_t * dst = env + off + len_hdr_bstr + len_hdr_arr;
+    memmove(dst, entries, len_entries);
+    memcpy(env + off, hdr_bstr, len_hdr_bstr);
+    memcpy(env + off + len_hdr_bstr, hdr_arr, len_hdr_arr);
+    memcpy(dst + len_entries, obj, len_obj);
+    *len_env += grow;
+    return 0;
+}
+
+int _suit_manifest_countersign(const uint8_t * pem,
+        uint8_t * env, size_t * len_env, const size_t size_env)
+{
+    uint8_t pld[SUIT_TBS_MAX];
+    size_t len_pld = sizeof(pld);
+    if (_suit_envelope_payload(env, *len_env, pld, &len_pld)) return 1;
+
+    /* sign the payload with Cozy */
+    cose_sign_context_t ctx;
+    if (cose_sign_init(&ctx, cose_mode_w, pem)) return 1;
+    uint8_t obj[SUIT_COSE_MAX];
+    size_t len_obj = sizeof(obj);
+    int err = cose_sign1_write(&ctx, pld, len_pld, obj, &len_obj);
+    cose_sign_free(&ctx);
+    if (err) return 1;
+
+    return _suit_envelope_add_wrapper(env, len_env, size_env, obj, len_obj);
+}
+
+int suit_manifest_countersign(const uint8_t * pem,
+        uint8_t * env, size_t * len_env, const size_t size_env)
+{
+#ifdef CONFIG_ZOOT_ES256
+    _suit_arena_enter();
+    int err = _suit_manifest_countersign(pem, env, len_env, size_env);
+    _suit_arena_exit();
+    return err;
+#else
+    return 1;
+#endif
+}
+
+int _suit_manifest_countersign_key(suit_key_t * key,
+        uint8_t * env, size_t * len_env, const size_t size_env)
+{
+    uint8_t pld[SUIT_TBS_MAX];
+    size_t len_pld = sizeof(pld);
+    if (_suit_envelope_payload(env, *len_env, pld, &len_pld)) return 1;
+
+    uint8_t obj[SUIT_COSE_MAX];
+    size_t len_obj = sizeof(obj);
+    if (_suit_cose_write(key, pld, len_pld, obj, &len_obj)) return 1;
+
+    return _suit_envelope_add_wrapper(env, len_env, size_env, obj, len_obj);
+}
+
+int suit_manifest_countersign_key(suit_key_t * key,
+        uint8_t * env, size_t * len_env, const size_t size_env)
+{
+    _suit_arena_enter();
+    int err = _suit_manifest_countersign_key(key, env, len_env, size_env);
+    _suit_arena_exit();
+    return err;
+}
@@ -0,0 +1,318 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/build.h>
+
+#define SUIT_CBOR_UINT 0
+#define SUIT_CBOR_BSTR 2
+#define SUIT_CBOR_TSTR 3
+#define SUIT_CBOR_ARR 4
+#define SUIT_CBOR_MAP 5
+#define SUIT_CBOR_NULL 0xf6
+
+/* a 32-bit integer is a head byte and four bytes */
+#define SUIT_CBOR_UINT32 0x1a
+#define SUIT_CBOR_UINT32_LEN 5
+
+/* 
+ * Output of the encoder. Without a buffer, only the length is counted,
+ * which is how the sections are measured.
+ */
+typedef struct {
+    uint8_t * buf;
+    size_t len;
+    suit_template_field_t * fields;
+    size_t field_count, size_fields;
+    bool overflow;
+} _suit_build_out_t;
+
+void _suit_put_byte(_suit_build_out_t * o, uint8_t byte)
+{
+    if (o->buf) o->buf[o->len] = byte;
+    o->len++;
+}
+
+void _suit_put_head(_suit_build_out_t * o, uint8_t major, uint32_t val)
+{
+    major <<= 5;
+    if (val < 24) {
+        _suit_put_byte(o, major | val);
+    } else if (val <= UINT8_MAX) {
+        _suit_put_byte(o, major | 24);
+        _suit_put_byte(o, val);
+    } else if (val <= UINT16_MAX) {
+        _suit_put_byte(o, major | 25);
+        _suit_put_byte(o, val >> 8);
+        _suit_put_byte(o, val);
+    } else {
+        _suit_put_byte(o, major | 26);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            _suit_put_byte(o, val >> shift);
+    }
+}
+
+void _suit_put_field(_suit_build_out_t * o, suit_field_t field, 
+        size_t idx, size_t len)
+{
+    if (!o->buf || !o->fields) return;
+    if (o->field_count == o->size_fields) {
+        o->overflow = true;
+        return;
+    }
+    suit_template_field_t * f = &o->fields[o->field_count++];
+    f->field = field;
+    f->idx = idx;
+    f->offset = o->len;
+    f->len = len;
+}
+
+/* a 32-bit integer that can be patched later */
+void _suit_put_uint32(_suit_build_out_t * o, suit_field_t field,
+        size_t idx, uint32_t val)
+{
+    _suit_put_field(o, field, idx, SUIT_CBOR_UINT32_LEN);
+    _suit_put_byte(o, SUIT_CBOR_UINT32);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        _suit_put_byte(o, val >> shift);
+}
+
+void _suit_put_str(_suit_build_out_t * o, uint8_t major, 
+        const uint8_t * str, size_t len, bool field, size_t idx)
+{
+    _suit_put_head(o, major, len);
+    if (field) _suit_put_field(o, suit_field_bytes, idx, len);
+    if (o->buf) memcpy(o->buf + o->len, str, len);
+    o->len += len;
+}
+
+void _suit_build_comps(const suit_build_t * b, _suit_build_out_t * o)
+{
+    _suit_put_head(o, SUIT_CBOR_ARR, b->component_count);
+    for (size_t i = 0; i < b->component_count; i++) {
+        _suit_put_head(o, SUIT_CBOR_ARR, 1);
+        _suit_put_str(o, SUIT_CBOR_BSTR, b->components[i].id, 
+                b->components[i].len_id, false, i);
+    }
+}
+
+size_t _suit_build_param_count(const suit_build_comp_t * c)
+{
+    return (c->len_vendor_id != 0) + (c->len_class_id != 0) 
+        + (c->len_digest != 0) + (c->size != 0) 
+        + (c->len_device_id != 0);
+}
+
+/* identities, digests and sizes, set in the common sequence */
+void _suit_build_common_seq(const suit_build_t * b, _suit_build_out_t * o)
+{
+    size_t items = 0;
+    for (size_t i = 0; i < b->component_count; i++)
+        if (_suit_build_param_count(&b->components[i]))
+            items += 4;
+    _suit_put_head(o, SUIT_CBOR_ARR, items);
+
+    for (size_t i = 0; i < b->component_count; i++) {
+        const suit_build_comp_t * c = &b->components[i];
+        if (!_suit_build_param_count(c)) continue;
+        _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_set_comp_idx);
+        _suit_put_head(o, SUIT_CBOR_UINT, i);
+        _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_override_params);
+        _suit_put_head(o, SUIT_CBOR_MAP, _suit_build_param_count(c));
+        if (c->len_vendor_id) {
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_param_vendor_id);
+            _suit_put_str(o, SUIT_CBOR_BSTR, c->vendor_id, 
+                    c->len_vendor_id, false, i);
+        }
+        if (c->len_class_id) {
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_param_class_id);
+            _suit_put_str(o, SUIT_CBOR_BSTR, c->class_id, 
+                    c->len_class_id, false, i);
+        }
+        if (c->len_digest) {
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_param_image_digest);
+            _suit_put_head(o, SUIT_CBOR_ARR, 2);
+            _suit_put_head(o, SUIT_CBOR_UINT, c->digest_alg);
+            _suit_put_str(o, SUIT_CBOR_BSTR, c->digest, c->len_digest, 
+                    true, i);
+        }
+        if (c->size) {
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_param_image_size);
+            _suit_put_uint32(o, suit_field_size, i, c->size);
+        }
+        if (c->len_device_id) {
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_param_device_id);
+            _suit_put_str(o, SUIT_CBOR_BSTR, c->device_id, 
+                    c->len_device_id, true, i);
+        }
+    }
+}
+
+void _suit_build_install(const suit_build_t * b, _suit_build_out_t * o)
+{
+    size_t items = 0;
+    for (size_t i = 0; i < b->component_count; i++)
+        if (b->components[i].uri || b->components[i].copy)
+            items += 6;
+    _suit_put_head(o, SUIT_CBOR_ARR, items);
+
+    for (size_t i = 0; i < b->component_count; i++) {
+        const suit_build_comp_t * c = &b->components[i];
+        if (!c->uri && !c->copy) continue;
+        _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_set_comp_idx);
+        _suit_put_head(o, SUIT_CBOR_UINT, i);
+        _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_set_params);
+        _suit_put_head(o, SUIT_CBOR_MAP, 1);
+        if (c->uri) {
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_param_uri);
+            _suit_put_str(o, SUIT_CBOR_TSTR, (const uint8_t *) c->uri, 
+                    strlen(c->uri), true, i);
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_fetch);
+        } else {
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_param_source_comp);
+            _suit_put_head(o, SUIT_CBOR_UINT, c->source);
+            _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_copy);
+        }
+        _suit_put_byte(o, SUIT_CBOR_NULL);
+    }
+}
+
+void _suit_build_run(const suit_build_t * b, _suit_build_out_t * o)
+{
+    size_t items = 0;
+    for (size_t i = 0; i < b->component_count; i++)
+        if (b->components[i].run) items += 4;
+    _suit_put_head(o, SUIT_CBOR_ARR, items);
+
+    for (size_t i = 0; i < b->component_count; i++) {
+        if (!b->components[i].run) continue;
+        _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_set_comp_idx);
+        _suit_put_head(o, SUIT_CBOR_UINT, i);
+        _suit_put_head(o, SUIT_CBOR_UINT, suit_dir_run);
+        _suit_put_byte(o, SUIT_CBOR_NULL);
+    }
+}
+
+typedef void (*_suit_build_section_t)(const suit_build_t * b, 
+        _suit_build_out_t * o);
+
+/* length of a section, counted without writing it */
+size_t _suit_build_measure(const suit_build_t * b, 
+        _suit_build_section_t section)
+{
+    _suit_build_out_t o = { .buf = NULL, .len = 0 };
+    section(b, &o);
+    return o.len;
+}
+
+/* a section wrapped in a byte string of known length */
+void _suit_build_wrap(const suit_build_t * b, _suit_build_out_t * o,
+        _suit_build_section_t section, size_t len)
+{
+    _suit_put_head(o, SUIT_CBOR_BSTR, len);
+    section(b, o);
+}
+
+size_t _suit_build_head_len(uint32_t val)
+{
+    _suit_build_out_t o = { .buf = NULL, .len = 0 };
+    _suit_put_head(&o, SUIT_CBOR_UINT, val);
+    return o.len;
+}
+
+int suit_build_manifest(const suit_build_t * b, 
+        uint8_t * man, size_t * len_man,
+        suit_template_field_t * fields, size_t * field_count)
+{
+    if (b->component_count == 0 || b->component_count > SUIT_MAX_COMPONENTS)
+        return 1;
+    bool run = false;
+    for (size_t i = 0; i < b->component_count; i++) {
+        const suit_build_comp_t * c = &b->components[i];
+        if (c->copy && (c->uri || c->source >= b->component_count 
+                    || c->source == i))
+            return 1;
+        run |= c->run;
+    }
+
+    /* measure the wrapped sections, innermost first */
+    size_t len_comps = _suit_build_measure(b, _suit_build_comps);
+    size_t len_seq = _suit_build_measure(b, _suit_build_common_seq);
+    size_t len_install = _suit_build_measure(b, _suit_build_install);
+    size_t len_run = _suit_build_measure(b, _suit_build_run);
+    size_t len_common = 1 + 1 + _suit_build_head_len(len_comps) 
+        + len_comps + 1 + _suit_build_head_len(len_seq) + len_seq;
+    size_t len = 1 + 2 + 1 + SUIT_CBOR_UINT32_LEN
+        + 1 + _suit_build_head_len(len_common) + len_common
+        + 1 + _suit_build_head_len(len_install) + len_install
+        + (run ? 1 + _suit_build_head_len(len_run) + len_run : 0);
+    if (len > *len_man) return 1;
+
+    _suit_build_out_t o = { 
+        .buf = man, 
+        .fields = fields, 
+        .size_fields = field_count ? *field_count : 0,
+    };
+    _suit_put_head(&o, SUIT_CBOR_MAP, run ? 5 : 4);
+    _suit_put_head(&o, SUIT_CBOR_UINT, suit_header_manifest_version);
+    _suit_put_head(&o, SUIT_CBOR_UINT, 1);
+    _suit_put_head(&o, SUIT_CBOR_UINT, suit_header_manifest_seq_num);
+    _suit_put_uint32(&o, suit_field_seq_num, 0, b->sequence_number);
+
+    _suit_put_head(&o, SUIT_CBOR_UINT, suit_header_common);
+    _suit_put_head(&o, SUIT_CBOR_BSTR, len_common);
+    _suit_put_head(&o, SUIT_CBOR_MAP, 2);
+    _suit_put_head(&o, SUIT_CBOR_UINT, suit_common_comps);
+    _suit_build_wrap(b, &o, _suit_build_comps, len_comps);
+    _suit_put_head(&o, SUIT_CBOR_UINT, suit_common_seq);
+    _suit_build_wrap(b, &o, _suit_build_common_seq, len_seq);
+
+    _suit_put_head(&o, SUIT_CBOR_UINT, suit_header_install);
+    _suit_build_wrap(b, &o, _suit_build_install, len_install);
+    if (run) {
+        _suit_put_head(&o, SUIT_CBOR_UINT, suit_header_run);
+        _suit_build_wrap(b, &o, _suit_build_run, len_run);
+    }
+
+    if (o.overflow || o.len != len) return 1;
+    *len_man = o.len;
+    if (field_count) *field_count = o.field_count;
+    return 0;
+}
+
+int suit_patch_uint(uint8_t * man, size_t len_man, 
+        const suit_template_field_t * field, uint32_t val)
+{
+    if (field->field == suit_field_bytes 
+            || field->len != SUIT_CBOR_UINT32_LEN
+            || field->offset + field->len > len_man
+            || man[field->offset] != SUIT_CBOR_UINT32)
+        return 1;
+    for (size_t i = 1; i < SUIT_CBOR_UINT32_LEN; i++)
+        man[field->offset + i] = val >> (8 * (SUIT_CBOR_UINT32_LEN - 1 - i));
+    return 0;
+}
+
+int suit_patch_bytes(uint8_t * man, size_t len_man, 
+        const suit_template_field_t * field, 
+        const uint8_t * val, size_t len)
+{
+    if (field->field != suit_field_bytes || len != field->len
+            || field->offset + field->len > len_man)
+        return 1;
+    memcpy(man + field->offset, val, len);
+    return 0;
+}
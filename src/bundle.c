@@ -0,0 +1,163 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/bundle.h>
+#include <sys/byteorder.h>
+#include <mbedtls/sha256.h>
+#include "pool.h"
+
+typedef struct {
+    const suit_bundle_t * b;
+    suit_key_t * keys;
+    size_t key_count;
+    atomic_t * bad;
+    atomic_t count;
+} _suit_bundle_job_t;
+
+int suit_bundle_write(uint8_t * buf, size_t * len, 
+        const suit_bundle_entry_t * meta, const uint8_t * const * envs, 
+        const size_t * len_envs, size_t count)
+{
+    size_t off = sizeof(suit_bundle_header_t) 
+        + count * sizeof(suit_bundle_entry_t);
+    if ((uintptr_t) buf % sizeof(uint32_t) || off > *len) return 1;
+
+    suit_bundle_entry_t * entries = (suit_bundle_entry_t *) 
+        (buf + sizeof(suit_bundle_header_t));
+    for (size_t i = 0; i < count; i++) {
+        if (len_envs[i] > *len - off) return 1;
+        suit_bundle_entry_t * e = &entries[i];
+        *e = meta[i];
+        mbedtls_sha256_ret(envs[i], len_envs[i], e->digest, 0);
+        e->key_id = sys_cpu_to_le32(meta[i].key_id);
+        e->sequence_number = sys_cpu_to_le32(meta[i].sequence_number);
+        e->offset = sys_cpu_to_le32(off);
+        e->len = sys_cpu_to_le32(len_envs[i]);
+        memcpy(buf + off, envs[i], len_envs[i]);
+        off += len_envs[i];
+    }
+
+    suit_bundle_header_t * h = (suit_bundle_header_t *) buf;
+    h->magic = sys_cpu_to_le32(SUIT_BUNDLE_MAGIC);
+    h->version = sys_cpu_to_le16(SUIT_BUNDLE_VERSION);
+    h->entry_size = sys_cpu_to_le16(sizeof(suit_bundle_entry_t));
+    h->count = sys_cpu_to_le32(count);
+    h->len = sys_cpu_to_le32(off);
+    *len = off;
+    return 0;
+}
+
+int suit_bundle_open(suit_bundle_t * b, const uint8_t * data, size_t len)
+{
+    const suit_bundle_header_t * h = (const suit_bundle_header_t *) data;
+    if ((uintptr_t) data % sizeof(uint32_t) || len < sizeof(*h)) return 1;
+    if (sys_le32_to_cpu(h->magic) != SUIT_BUNDLE_MAGIC
+            || sys_le16_to_cpu(h->version) != SUIT_BUNDLE_VERSION
+            || sys_le16_to_cpu(h->entry_size) 
+                != sizeof(suit_bundle_entry_t)
+            || sys_le32_to_cpu(h->len) > len)
+        return 1;
+
+    /* the index must fit in the bundle the header claims */
+    size_t len_bundle = sys_le32_to_cpu(h->len);
+    size_t count = sys_le32_to_cpu(h->count);
+    if (len_bundle < sizeof(*h) || count > (len_bundle - sizeof(*h)) 
+            / sizeof(suit_bundle_entry_t))
+        return 1;
+
+    b->data = data;
+    b->len = len_bundle;
+    b->count = count;
+    b->entries = (const suit_bundle_entry_t *) (data + sizeof(*h));
+    return 0;
+}
+
+int suit_bundle_get(const suit_bundle_t * b, size_t idx,
+        const suit_bundle_entry_t ** entry, 
+        const uint8_t ** env, size_t * len_env)
+{
+    if (idx >= b->count) return 1;
+    const suit_bundle_entry_t * e = &b->entries[idx];
+    size_t off = sys_le32_to_cpu(e->offset), len = sys_le32_to_cpu(e->len);
+    if (off > b->len || len > b->len - off) return 1;
+    if (entry) *entry = e;
+    *env = b->data + off;
+    *len_env = len;
+    return 0;
+}
+
+/* reads the sequence number from the top-level map of a manifest */
+int _suit_bundle_get_seq_num(const uint8_t * man, size_t len_man,
+        uint32_t * seq_num)
+{
+    nanocbor_value_t top, map;
+    nanocbor_decoder_init(&top, man, len_man);
+    if (nanocbor_enter_map(&top, &map) < 0) return 1;
+    while (!nanocbor_at_end(&map)) {
+        uint32_t key;
+        if (nanocbor_get_uint32(&map, &key) < 0) return 1;
+        if (key == suit_header_manifest_seq_num)
+            return nanocbor_get_uint32(&map, seq_num) < 0;
+        if (nanocbor_skip(&map) < 0) return 1;
+    }
+    return 1;
+}
+
+int _suit_bundle_check(const _suit_bundle_job_t * job, size_t idx)
+{
+    const suit_bundle_entry_t * e;
+    const uint8_t * env, * man;
+    size_t len_env, len_man;
+    uint8_t hash[SUIT_BUNDLE_DIGEST_SIZE];
+    uint32_t seq_num;
+
+    if (suit_bundle_get(job->b, idx, &e, &env, &len_env)) return 1;
+    mbedtls_sha256_ret(env, len_env, hash, 0);
+    if (memcmp(hash, e->digest, sizeof(hash))) return 1;
+
+    size_t key_id = sys_le32_to_cpu(e->key_id);
+    if (key_id >= job->key_count) return 1;
+    if (suit_manifest_unwrap_key(&job->keys[key_id], env, len_env,
+                &man, &len_man))
+        return 1;
+    if (_suit_bundle_get_seq_num(man, len_man, &seq_num)) return 1;
+    return seq_num != sys_le32_to_cpu(e->sequence_number);
+}
+
+int _suit_bundle_check_job(void * arg, size_t idx)
+{
+    _suit_bundle_job_t * job = arg;
+    if (_suit_bundle_check(job, idx)) {
+        atomic_set_bit(job->bad, idx);
+        atomic_inc(&job->count);
+    }
+    return 0;
+}
+
+size_t suit_bundle_verify(const suit_bundle_t * b, 
+        suit_key_t * keys, size_t key_count, 
+        size_t threads, atomic_t * bad)
+{
+    _suit_bundle_job_t job = { 
+        .b = b, .keys = keys, .key_count = key_count, .bad = bad,
+    };
+    atomic_set(&job.count, 0);
+    for (size_t i = 0; i < b->count; i += ATOMIC_BITS)
+        atomic_set(&bad[i / ATOMIC_BITS], 0);
+    _suit_parallel_for(b->count, threads, _suit_bundle_check_job, &job);
+    return atomic_get(&job.count);
+}
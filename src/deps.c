@@ -0,0 +1,165 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/deps.h>
+#include <mbedtls/sha256.h>
+#include "pool.h"
+
+/*
+ * Dependencies are resolved one level of the graph at a time. All
+ * manifests of a level are fetched on the calling thread, which also
+ * merges references to the same manifest into one node. The new 
+ * nodes are independent of one another and are verified in parallel.
+ */
+
+/* defined in auth.c */
+int _suit_envelope_parse(const uint8_t * env, size_t len_env,
+        const uint8_t ** auth, size_t * len_auth,
+        const uint8_t ** wrp, size_t * len_wrp);
+
+void suit_manifest_cache_init(suit_manifest_cache_t * cache)
+{
+    cache->count = 0;
+    cache->next = 0;
+}
+
+bool _suit_cache_has(const suit_resolver_t * res, const uint8_t * digest)
+{
+    suit_manifest_cache_t * cache = res->cache;
+    bool found = false;
+    k_spinlock_key_t key = k_spin_lock(&cache->lock);
+    for (size_t i = 0; i < cache->count && !found; i++) {
+        suit_cached_manifest_t * e = &cache->entries[i];
+        found = e->keys == res->keys && e->key_count == res->key_count
+            && e->threshold == res->threshold
+            && !memcmp(e->digest, digest, SUIT_DEP_DIGEST_SIZE);
+    }
+    k_spin_unlock(&cache->lock, key);
+    return found;
+}
+
+void _suit_cache_add(const suit_resolver_t * res, const uint8_t * digest)
+{
+    suit_manifest_cache_t * cache = res->cache;
+    k_spinlock_key_t key = k_spin_lock(&cache->lock);
+    suit_cached_manifest_t * e = &cache->entries[cache->next];
+    memcpy(e->digest, digest, SUIT_DEP_DIGEST_SIZE);
+    e->keys = res->keys;
+    e->key_count = res->key_count;
+    e->threshold = res->threshold;
+    cache->next = (cache->next + 1) % CONFIG_ZOOT_MANIFEST_CACHE_SIZE;
+    cache->count = MIN(cache->count + 1, CONFIG_ZOOT_MANIFEST_CACHE_SIZE);
+    k_spin_unlock(&cache->lock, key);
+}
+
+/*
+ * Checks one fetched manifest. The digest is compared first, since it
+ * is far cheaper than the signatures and rejects wrong manifests.
+ */
+int _suit_dep_verify(const suit_resolver_t * res, suit_dep_node_t * node)
+{
+    const uint8_t * auth, * wrp;
+    size_t len_auth, len_wrp;
+    if (_suit_envelope_parse(node->env, node->len_env, 
+                &auth, &len_auth, &wrp, &len_wrp))
+        return 1;
+
+    uint8_t hash[SUIT_DEP_DIGEST_SIZE];
+    mbedtls_sha256_ret(wrp, len_wrp, hash, 0);
+    if (memcmp(hash, node->digest, sizeof(hash))) return 1;
+
+    const uint8_t * man; size_t len_man;
+    if (res->cache && _suit_cache_has(res, hash)) {
+        nanocbor_value_t nc;
+        nanocbor_decoder_init(&nc, wrp, len_wrp);
+        if (nanocbor_get_bstr(&nc, &man, &len_man) < 0) return 1;
+    } else {
+        if (suit_manifest_unwrap_multi(res->keys, res->key_count,
+                    res->threshold, node->env, node->len_env, 
+                    &man, &len_man))
+            return 1;
+        if (res->cache) _suit_cache_add(res, hash);
+    }
+    return suit_parse_init(&node->ctx, man, len_man);
+}
+
+typedef struct {
+    const suit_resolver_t * res;
+    suit_dep_graph_t * graph;
+    size_t first;
+} _suit_dep_level_t;
+
+int _suit_dep_job(void * arg, size_t idx)
+{
+    _suit_dep_level_t * level = arg;
+    return _suit_dep_verify(level->res, 
+            &level->graph->nodes[level->first + idx]);
+}
+
+/* returns the node for a digest, fetching the manifest if it is new */
+int _suit_dep_node(const suit_resolver_t * res, suit_dep_graph_t * graph,
+        const suit_dependency_t * dep, size_t * idx)
+{
+    if (dep->digest_alg != suit_digest_alg_sha256 ||
+            dep->len_digest != SUIT_DEP_DIGEST_SIZE) 
+        return 1;
+
+    for (*idx = 1; *idx < graph->count; (*idx)++)
+        if (!memcmp(graph->nodes[*idx].digest, dep->digest, 
+                    SUIT_DEP_DIGEST_SIZE))
+            return 0;
+
+    if (graph->count == CONFIG_ZOOT_MAX_DEP_MANIFESTS) return 1;
+    suit_dep_node_t * node = &graph->nodes[graph->count];
+    memcpy(node->digest, dep->digest, SUIT_DEP_DIGEST_SIZE);
+    if (res->fetch(res->arg, node->digest, SUIT_DEP_DIGEST_SIZE,
+                &node->env, &node->len_env))
+        return 1;
+    graph->count++;
+    return 0;
+}
+
+int suit_resolve_dependencies(const suit_resolver_t * res, 
+        const suit_context_t * root, suit_dep_graph_t * graph)
+{
+    graph->count = 1;
+    graph->nodes[0].ctx = *root;
+    graph->nodes[0].env = NULL;
+    graph->nodes[0].len_env = 0;
+    memset(graph->nodes[0].digest, 0, SUIT_DEP_DIGEST_SIZE);
+
+    _suit_dep_level_t level = { .res = res, .graph = graph, .first = 0 };
+    while (level.first < graph->count) {
+
+        /* link the dependencies of this level, fetching new manifests */
+        size_t next = graph->count;
+        for (size_t i = level.first; i < next; i++) {
+            suit_dep_node_t * node = &graph->nodes[i];
+            for (size_t d = 0; d < node->ctx.dependency_count; d++)
+                if (_suit_dep_node(res, graph, 
+                            &node->ctx.dependencies[d], &node->deps[d]))
+                    return 1;
+        }
+
+        /* verify the new manifests, stopping at the first failure */
+        level.first = next;
+        if (_suit_parallel_for(graph->count - next, 0, 
+                    _suit_dep_job, &level))
+            return 1;
+    }
+    return 0;
+}
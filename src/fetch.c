@@ -0,0 +1,169 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/fetch.h>
+#include <mbedtls/sha256.h>
+#include "pool.h"
+
+/*
+ * Sources are chosen per range. A source that has not delivered
+ * anything yet is tried as soon as it is idle, so every source gets
+ * measured. After that, each range goes to the source that would
+ * deliver it first given the ranges it is already serving: the one
+ * with the lowest (inflight + 1) * cycles / bytes. Fast sources thus
+ * serve most ranges while slow ones still add to the total.
+ */
+
+#define SUIT_FETCH_DIGEST_SIZE 32 /* SHA-256 */
+
+/* estimated cycles per byte, in 1/256 */
+#define SUIT_FETCH_RATE(src) (((src)->cycles << 8) / (src)->bytes)
+
+typedef struct {
+    suit_fetcher_t * f;
+    uint8_t * buf;
+    size_t size;
+} _suit_fetch_job_t;
+
+void suit_fetcher_init(suit_fetcher_t * f, suit_fetch_range_t get,
+        void * arg, size_t range_size, size_t threads)
+{
+    memset(f, 0, sizeof(*f));
+    f->get = get;
+    f->arg = arg;
+    f->range_size = range_size;
+    f->threads = threads;
+}
+
+int suit_fetcher_add_source(suit_fetcher_t * f,
+        const uint8_t * uri, size_t len_uri)
+{
+    for (size_t i = 0; i < f->source_count; i++)
+        if (f->sources[i].len_uri == len_uri
+                && !memcmp(f->sources[i].uri, uri, len_uri))
+            return 0;
+    if (f->source_count == SUIT_FETCH_MAX_SOURCES) return 1;
+    suit_source_t * src = &f->sources[f->source_count++];
+    memset(src, 0, sizeof(*src));
+    src->uri = uri;
+    src->len_uri = len_uri;
+    return 0;
+}
+
+int suit_fetcher_add_component(suit_fetcher_t * f,
+        suit_context_t * ctx, size_t idx)
+{
+    const uint8_t * uri; size_t len_uri;
+    if (!suit_has_uri(ctx, idx)) return 1;
+    suit_get_uri(ctx, idx, &uri, &len_uri);
+    if (suit_fetcher_add_source(f, uri, len_uri)) return 1;
+    for (size_t i = 0; i < suit_get_uri_alt_count(ctx, idx); i++) {
+        suit_get_uri_alt(ctx, idx, i, &uri, &len_uri);
+        if (suit_fetcher_add_source(f, uri, len_uri)) return 1;
+    }
+    return 0;
+}
+
+/* picks a source not in tried and marks it busy; called locked */
+suit_source_t * _suit_fetch_pick(suit_fetcher_t * f, uint32_t tried)
+{
+    suit_source_t * best = NULL, * idle = NULL;
+    uint64_t best_cost = 0;
+    for (size_t i = 0; i < f->source_count; i++) {
+        suit_source_t * src = &f->sources[i];
+        if ((tried & BIT(i)) || src->failures >= SUIT_FETCH_MAX_FAILURES)
+            continue;
+
+        /* unmeasured sources are probed, one range at a time */
+        if (src->bytes == 0) {
+            if (src->inflight == 0) { best = src; break; }
+            if (idle == NULL) idle = src;
+            continue;
+        }
+
+        uint64_t cost = (src->inflight + 1) * SUIT_FETCH_RATE(src);
+        if (best == NULL || cost < best_cost) {
+            best = src;
+            best_cost = cost;
+        }
+    }
+    if (best == NULL) best = idle;
+    if (best) best->inflight++;
+    return best;
+}
+
+int _suit_fetch_range(void * arg, size_t idx)
+{
+    _suit_fetch_job_t * job = arg;
+    suit_fetcher_t * f = job->f;
+    size_t offset = idx * f->range_size;
+    size_t len = MIN(f->range_size, job->size - offset);
+
+    uint32_t tried = 0;
+    while (true) {
+        k_spinlock_key_t key = k_spin_lock(&f->lock);
+        suit_source_t * src = _suit_fetch_pick(f, tried);
+        k_spin_unlock(&f->lock, key);
+        if (src == NULL) return 1;
+
+        uint32_t start = k_cycle_get_32();
+        int err = f->get(f->arg, src->uri, src->len_uri,
+                offset, job->buf + offset, len);
+        uint32_t cycles = k_cycle_get_32() - start;
+        if (!err && f->merkle && !suit_merkle_block_is_match(f->merkle, 
+                    idx, job->buf + offset, len))
+            err = 1;
+
+        key = k_spin_lock(&f->lock);
+        src->inflight--;
+        if (err) src->failures++;
+        else {
+            src->bytes += len;
+            src->cycles += cycles;
+        }
+        k_spin_unlock(&f->lock, key);
+        if (!err) return 0;
+        tried |= BIT(src - f->sources);
+    }
+}
+
+int suit_fetch_image(suit_fetcher_t * f, suit_context_t * ctx, size_t idx,
+        uint8_t * buf, size_t size)
+{
+    _suit_fetch_job_t job = { .f = f, .buf = buf };
+    job.size = suit_get_size(ctx, idx);
+    if (job.size == 0 || job.size > size || f->range_size == 0) return 1;
+    if (f->merkle && (f->merkle->block_size != f->range_size 
+                || f->merkle->size != job.size))
+        return 1;
+
+    /* failures count per image; a source that was down may be back */
+    k_spinlock_key_t key = k_spin_lock(&f->lock);
+    for (size_t i = 0; i < f->source_count; i++)
+        f->sources[i].failures = 0;
+    k_spin_unlock(&f->lock, key);
+
+    size_t ranges = (job.size + f->range_size - 1) / f->range_size;
+    if (_suit_parallel_for(ranges, f->threads, _suit_fetch_range, &job))
+        return 1;
+
+    if (!suit_has_digest(ctx, idx)) return 0;
+    uint8_t hash[SUIT_FETCH_DIGEST_SIZE];
+    if (suit_get_digest_alg(ctx, idx) != suit_digest_alg_sha256) return 1;
+    mbedtls_sha256_ret(buf, job.size, hash, 0);
+    return !suit_digest_is_match(ctx, idx, hash, sizeof(hash));
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/suit.h>
+
+/*
+ * Identity checks must not reveal through their timing how much of 
+ * an ID matched. UUIDs are compared in 32-bit words without early
+ * exit, and an ID is compared with every entry of a table. Only the
+ * number of components and IDs, which are not secret, affect timing.
+ */
+
+/* returns 1 if both UUIDs are equal, else 0 */
+uint32_t _suit_uuid_is_equal(const uint8_t * a, const uint8_t * b)
+{
+    uint32_t x, y, diff = 0;
+    for (size_t i = 0; i < SUIT_UUID_LEN; i += sizeof(x)) {
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        diff |= x ^ y;
+    }
+    return 1 ^ ((diff | (0 - diff)) >> 31);
+}
+
+/* returns 1 if the ID is absent or equals an entry of the table */
+uint32_t _suit_uuid_is_listed(const uint8_t * id, size_t len_id,
+        const uint8_t * table, size_t count)
+{
+    if (id == NULL) return 1;
+    if (len_id != SUIT_UUID_LEN) return 0;
+    uint32_t found = 0;
+    for (size_t i = 0; i < count; i++)
+        found |= _suit_uuid_is_equal(id, table + i * SUIT_UUID_LEN);
+    return found;
+}
+
+/*
+ * Components sharing a parameter block share its IDs, so each block
+ * in use is matched once and the result is spread to its components.
+ */
+bool suit_identity_match(suit_context_t * ctx, const suit_identity_t * id,
+        uint32_t match[SUIT_MATCH_WORDS])
+{
+    uint8_t block_match[SUIT_MAX_PARAM_BLOCKS];
+    for (size_t i = 0; i < SUIT_MAX_PARAM_BLOCKS; i++) {
+        const suit_params_t * params = &ctx->params[i];
+        if (params->refs == 0) continue;
+        block_match[i] = 
+            _suit_uuid_is_listed(params->vendor_id, params->len_vendor_id,
+                    id->vendor_ids, id->vendor_id_count) &
+            _suit_uuid_is_listed(params->class_id, params->len_class_id,
+                    id->class_ids, id->class_id_count) &
+            _suit_uuid_is_listed(params->device_id, params->len_device_id,
+                    id->device_ids, id->device_id_count);
+    }
+
+    uint32_t all = 1;
+    memset(match, 0, SUIT_MATCH_WORDS * sizeof(uint32_t));
+    for (size_t idx = 0; idx < ctx->component_count; idx++) {
+        uint32_t bit = block_match[ctx->components[idx].params];
+        match[idx / 32] |= bit << (idx % 32);
+        all &= bit;
+    }
+    return all;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/index.h>
+
+/* UUIDs are random enough that folding them makes a good hash */
+uint32_t _suit_index_hash(const uint8_t * vendor_id, const uint8_t * class_id)
+{
+    uint32_t h = 0, x;
+    for (size_t i = 0; i < SUIT_UUID_LEN; i += sizeof(x)) {
+        memcpy(&x, vendor_id + i, sizeof(x));
+        h = (h ^ x) * 0x9e3779b1;
+        memcpy(&x, class_id + i, sizeof(x));
+        h = (h ^ x) * 0x9e3779b1;
+    }
+    return h ^ (h >> 16);
+}
+
+/* returns the record linked as ref, or NULL */
+const suit_index_record_t * _suit_index_deref(const suit_index_t * ix,
+        atomic_val_t ref)
+{
+    return ref ? &ix->records[ref - 1] : NULL;
+}
+
+/* 
+ * Returns the slot of the IDs, or the empty slot ending their probe 
+ * sequence. Slots are never emptied, so the sequence only grows.
+ */
+atomic_t * _suit_index_slot(const suit_index_t * ix,
+        const uint8_t * vendor_id, const uint8_t * class_id)
+{
+    size_t mask = ix->slot_count - 1;
+    size_t i = _suit_index_hash(vendor_id, class_id) & mask;
+    while (true) {
+        const suit_index_record_t * rec = 
+            _suit_index_deref(ix, atomic_get(&ix->slots[i]));
+        if (rec == NULL 
+                || (!memcmp(rec->vendor_id, vendor_id, SUIT_UUID_LEN)
+                    && !memcmp(rec->class_id, class_id, SUIT_UUID_LEN)))
+            return &ix->slots[i];
+        i = (i + 1) & mask;
+    }
+}
+
+int suit_index_init(suit_index_t * ix, atomic_t * slots, size_t slot_count,
+        suit_index_record_t * records, size_t record_count)
+{
+    if (slot_count == 0 || (slot_count & (slot_count - 1))) return 1;
+    memset(ix, 0, sizeof(*ix));
+    ix->slots = slots;
+    ix->slot_count = slot_count;
+    ix->records = records;
+    ix->record_count = record_count;
+    for (size_t i = 0; i < slot_count; i++)
+        atomic_set(&slots[i], 0);
+    atomic_set(&ix->used, 0);
+    return 0;
+}
+
+/* the IDs shared by all components, or 1 if they differ */
+int _suit_index_ids(suit_context_t * ctx, 
+        const uint8_t ** vendor_id, const uint8_t ** class_id)
+{
+    *vendor_id = *class_id = NULL;
+    for (size_t i = 0; i < ctx->component_count; i++) {
+        const suit_params_t * p = &ctx->params[ctx->components[i].params];
+        if (p->len_vendor_id != SUIT_UUID_LEN 
+                || p->len_class_id != SUIT_UUID_LEN
+                || (*vendor_id 
+                    && memcmp(*vendor_id, p->vendor_id, SUIT_UUID_LEN))
+                || (*class_id 
+                    && memcmp(*class_id, p->class_id, SUIT_UUID_LEN)))
+            return 1;
+        *vendor_id = p->vendor_id;
+        *class_id = p->class_id;
+    }
+    return *vendor_id == NULL;
+}
+
+/* links rec into the list at link, by falling sequence number; locked */
+int _suit_index_link(suit_index_t * ix, atomic_t * link, 
+        suit_index_record_t * rec)
+{
+    const suit_index_record_t * next;
+    while ((next = _suit_index_deref(ix, atomic_get(link))) != NULL
+            && next->sequence_number > rec->sequence_number)
+        link = (atomic_t *) &next->older;
+    if (next && next->sequence_number == rec->sequence_number) return 1;
+
+    /* readers see the record only once it is complete */
+    atomic_set(&rec->older, atomic_get(link));
+    atomic_set(link, rec - ix->records + 1);
+    return 0;
+}
+
+/* called locked */
+int _suit_index_add(suit_index_t * ix, const uint8_t * vendor_id,
+        const uint8_t * class_id, size_t seq_num, const void * manifest)
+{
+    size_t used = atomic_get(&ix->used);
+    atomic_t * slot = _suit_index_slot(ix, vendor_id, class_id);
+    bool new_key = atomic_get(slot) == 0;
+    if (used == ix->record_count 
+            || (new_key && ix->key_count + 1 > ix->slot_count * 3 / 4))
+        return 1;
+
+    suit_index_record_t * rec = &ix->records[used];
+    memcpy(rec->vendor_id, vendor_id, SUIT_UUID_LEN);
+    memcpy(rec->class_id, class_id, SUIT_UUID_LEN);
+    rec->sequence_number = seq_num;
+    rec->manifest = manifest;
+    if (_suit_index_link(ix, slot, rec)) return 1;
+    atomic_set(&ix->used, used + 1);
+    ix->key_count += new_key;
+    return 0;
+}
+
+int suit_index_add(suit_index_t * ix, suit_context_t * ctx, 
+        const void * manifest)
+{
+    const uint8_t * vendor_id, * class_id;
+    if (_suit_index_ids(ctx, &vendor_id, &class_id)) return 1;
+
+    k_spinlock_key_t key = k_spin_lock(&ix->lock);
+    int err = _suit_index_add(ix, vendor_id, class_id,
+            suit_get_sequence_number(ctx), manifest);
+    k_spin_unlock(&ix->lock, key);
+    return err;
+}
+
+const suit_index_record_t * suit_index_latest(const suit_index_t * ix,
+        const uint8_t * vendor_id, const uint8_t * class_id)
+{
+    return _suit_index_deref(ix, 
+            atomic_get(_suit_index_slot(ix, vendor_id, class_id)));
+}
+
+const suit_index_record_t * suit_index_older(const suit_index_t * ix,
+        const suit_index_record_t * rec)
+{
+    return _suit_index_deref(ix, atomic_get(&rec->older));
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/journal.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+
+/* 
+ * Records hold the state words of mbedTLS's own SHA-256 context; an
+ * alternative implementation keeps its state elsewhere.
+ */
+#ifdef MBEDTLS_SHA256_ALT
+#error "CONFIG_ZOOT_JOURNAL requires the mbedTLS SHA-256 implementation"
+#endif
+
+/* record layout */
+#define SUIT_JOURNAL_OFF_MAGIC 0
+#define SUIT_JOURNAL_OFF_SEQ 4
+#define SUIT_JOURNAL_OFF_IDX 8
+#define SUIT_JOURNAL_OFF_OFFSET 12
+#define SUIT_JOURNAL_OFF_STATE 16
+#define SUIT_JOURNAL_OFF_MANIFEST 48
+#define SUIT_JOURNAL_OFF_CRC (SUIT_JOURNAL_RECORD_SIZE - 4)
+
+bool _suit_journal_is_valid(const uint8_t * rec)
+{
+    return sys_get_le32(rec + SUIT_JOURNAL_OFF_MAGIC) == SUIT_JOURNAL_MAGIC
+        && sys_get_le32(rec + SUIT_JOURNAL_OFF_CRC) 
+            == crc32_ieee(rec, SUIT_JOURNAL_OFF_CRC);
+}
+
+bool _suit_journal_is_erased(const uint8_t * rec)
+{
+    for (size_t i = 0; i < SUIT_JOURNAL_RECORD_SIZE; i++)
+        if (rec[i] != 0xff) return false;
+    return true;
+}
+
+int suit_journal_init(suit_journal_t * j, const struct flash_area * fa,
+        size_t interval)
+{
+    memset(j, 0, sizeof(*j));
+    j->fa = fa;
+    j->interval = interval;
+    if (interval == 0 || interval % SUIT_JOURNAL_ALIGN) return 1;
+
+    size_t half = fa->fa_size / 2;
+    size_t slots = half / SUIT_JOURNAL_RECORD_SIZE;
+    if (slots == 0) return 1;
+
+    /* 
+     * The next record goes after the last slot written in the half 
+     * holding the newest record, valid or not: flash cannot be 
+     * written twice without an erase.
+     */
+    uint8_t rec[SUIT_JOURNAL_RECORD_SIZE];
+    size_t used[2] = { 0, 0 };
+    for (size_t h = 0; h < 2; h++) {
+        for (size_t s = 0; s < slots; s++) {
+            if (flash_area_read(fa, h * half + s * SUIT_JOURNAL_RECORD_SIZE,
+                        rec, sizeof(rec)))
+                return 1;
+            if (_suit_journal_is_erased(rec)) continue;
+            used[h] = s + 1;
+            if (!_suit_journal_is_valid(rec)) continue;
+            uint32_t seq = sys_get_le32(rec + SUIT_JOURNAL_OFF_SEQ);
+            if (!j->valid || (int32_t) (seq - j->seq) > 0) {
+                memcpy(j->last, rec, sizeof(rec));
+                j->seq = seq;
+                j->half = h;
+                j->valid = true;
+            }
+        }
+    }
+
+    /* without records, start by erasing the first half */
+    if (!j->valid) {
+        j->half = 1;
+        j->slot = slots;
+    } else j->slot = used[j->half];
+    return 0;
+}
+
+/* appends a record, moving to the other half when this one is full */
+int _suit_journal_write(suit_journal_t * j, const suit_progress_t * p,
+        size_t idx, size_t offset)
+{
+    size_t half = j->fa->fa_size / 2;
+    if (j->slot == half / SUIT_JOURNAL_RECORD_SIZE) {
+        j->half ^= 1;
+        j->slot = 0;
+    }
+    if (j->slot == 0 && flash_area_erase(j->fa, j->half * half, half))
+        return 1;
+
+    uint8_t * rec = j->last;
+    memset(rec, 0, SUIT_JOURNAL_RECORD_SIZE);
+    sys_put_le32(SUIT_JOURNAL_MAGIC, rec + SUIT_JOURNAL_OFF_MAGIC);
+    sys_put_le32(j->seq + 1, rec + SUIT_JOURNAL_OFF_SEQ);
+    sys_put_le32(idx, rec + SUIT_JOURNAL_OFF_IDX);
+    sys_put_le32(offset, rec + SUIT_JOURNAL_OFF_OFFSET);
+    for (size_t i = 0; i < 8; i++)
+        sys_put_le32(p->sha.state[i], rec + SUIT_JOURNAL_OFF_STATE + 4 * i);
+    memcpy(rec + SUIT_JOURNAL_OFF_MANIFEST, p->manifest, 
+            SUIT_JOURNAL_DIGEST_SIZE);
+    sys_put_le32(crc32_ieee(rec, SUIT_JOURNAL_OFF_CRC), 
+            rec + SUIT_JOURNAL_OFF_CRC);
+
+    /* the slot is used even if the write fails halfway */
+    off_t off = j->half * half + j->slot * SUIT_JOURNAL_RECORD_SIZE;
+    j->slot++;
+    j->valid = false;
+    if (flash_area_write(j->fa, off, rec, SUIT_JOURNAL_RECORD_SIZE)) 
+        return 1;
+    j->seq++;
+    j->valid = true;
+    return 0;
+}
+
+bool suit_journal_begin(suit_journal_t * j, 
+        const uint8_t manifest[SUIT_JOURNAL_DIGEST_SIZE], size_t idx,
+        suit_progress_t * progress)
+{
+    memcpy(progress->manifest, manifest, SUIT_JOURNAL_DIGEST_SIZE);
+    progress->idx = idx;
+    progress->offset = 0;
+    mbedtls_sha256_init(&progress->sha);
+    mbedtls_sha256_starts_ret(&progress->sha, 0);
+    if (!j->valid || memcmp(j->last + SUIT_JOURNAL_OFF_MANIFEST, 
+                manifest, SUIT_JOURNAL_DIGEST_SIZE))
+        return false;
+
+    size_t rec_idx = sys_get_le32(j->last + SUIT_JOURNAL_OFF_IDX);
+    if (rec_idx > idx) return true;
+    if (rec_idx < idx) return false;
+
+    /* 
+     * Records are only written at multiples of the SHA-256 block 
+     * size, so the state words and the length restore the context.
+     */
+    progress->offset = sys_get_le32(j->last + SUIT_JOURNAL_OFF_OFFSET);
+    for (size_t i = 0; i < 8; i++)
+        progress->sha.state[i] = sys_get_le32(
+                j->last + SUIT_JOURNAL_OFF_STATE + 4 * i);
+    progress->sha.total[0] = progress->offset;
+    progress->sha.total[1] = 0;
+    return false;
+}
+
+int suit_journal_update(suit_journal_t * j, suit_progress_t * progress,
+        const uint8_t * data, size_t len)
+{
+    while (len > 0) {
+        size_t n = MIN(len, j->interval - progress->offset % j->interval);
+        mbedtls_sha256_update_ret(&progress->sha, data, n);
+        progress->offset += n;
+        data += n; len -= n;
+        if (progress->offset % j->interval == 0 
+                && _suit_journal_write(j, progress, 
+                    progress->idx, progress->offset))
+            return 1;
+    }
+    return 0;
+}
+
+int suit_journal_finish(suit_journal_t * j, suit_context_t * ctx,
+        suit_progress_t * progress)
+{
+    uint8_t hash[SUIT_JOURNAL_DIGEST_SIZE];
+    size_t idx = progress->idx;
+    if (progress->offset != suit_get_size(ctx, idx)) return 1;
+    mbedtls_sha256_finish_ret(&progress->sha, hash);
+    if (suit_has_digest(ctx, idx)) {
+        if (suit_get_digest_alg(ctx, idx) != suit_digest_alg_sha256) 
+            return 1;
+        if (!suit_digest_is_match(ctx, idx, hash, sizeof(hash))) 
+            return 1;
+    }
+
+    /* the next component starts from scratch */
+    mbedtls_sha256_starts_ret(&progress->sha, 0);
+    return _suit_journal_write(j, progress, idx + 1, 0);
+}
+
+int suit_journal_reset(suit_journal_t * j)
+{
+    suit_progress_t none;
+    memset(&none, 0, sizeof(none));
+    return _suit_journal_write(j, &none, 0, 0);
+}
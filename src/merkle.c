@@ -0,0 +1,146 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/merkle.h>
+#include <mbedtls/sha256.h>
+#include "pool.h"
+
+#define SUIT_MERKLE_LEAF 0x00
+#define SUIT_MERKLE_NODE 0x01
+
+typedef struct {
+    const suit_merkle_t * m;
+    const uint8_t * image;
+    atomic_t * bad;
+    atomic_t count;
+} _suit_merkle_job_t;
+
+void _suit_merkle_hash(uint8_t prefix, const uint8_t * a, size_t len_a,
+        const uint8_t * b, size_t len_b, uint8_t out[SUIT_MERKLE_HASH_SIZE])
+{
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    mbedtls_sha256_update_ret(&sha, &prefix, 1);
+    mbedtls_sha256_update_ret(&sha, a, len_a);
+    mbedtls_sha256_update_ret(&sha, b, len_b);
+    mbedtls_sha256_finish_ret(&sha, out);
+    mbedtls_sha256_free(&sha);
+}
+
+void suit_merkle_leaf(const uint8_t * block, size_t len,
+        uint8_t leaf[SUIT_MERKLE_HASH_SIZE])
+{
+    _suit_merkle_hash(SUIT_MERKLE_LEAF, block, len, NULL, 0, leaf);
+}
+
+/*
+ * The root is computed in one pass over the leaves. Each stack entry
+ * is a complete subtree; two subtrees of the same size are joined as
+ * soon as the second one is complete, and the remaining ones are 
+ * joined right to left at the end. This gives the shape of RFC 6962
+ * with a stack of at most one entry per level.
+ */
+int suit_merkle_root(const uint8_t * leaves, size_t count,
+        uint8_t root[SUIT_MERKLE_HASH_SIZE])
+{
+    uint8_t stack[SUIT_MERKLE_MAX_DEPTH + 1][SUIT_MERKLE_HASH_SIZE];
+    size_t sizes[SUIT_MERKLE_MAX_DEPTH + 1];
+    size_t depth = 0;
+    if (count == 0 || count >= BIT(SUIT_MERKLE_MAX_DEPTH)) return 1;
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(stack[depth], leaves + i * SUIT_MERKLE_HASH_SIZE, 
+                SUIT_MERKLE_HASH_SIZE);
+        sizes[depth++] = 1;
+        while (depth > 1 && sizes[depth - 2] == sizes[depth - 1]) {
+            _suit_merkle_hash(SUIT_MERKLE_NODE, 
+                    stack[depth - 2], SUIT_MERKLE_HASH_SIZE,
+                    stack[depth - 1], SUIT_MERKLE_HASH_SIZE, 
+                    stack[depth - 2]);
+            sizes[depth - 2] *= 2;
+            depth--;
+        }
+    }
+    while (depth > 1) {
+        _suit_merkle_hash(SUIT_MERKLE_NODE, 
+                stack[depth - 2], SUIT_MERKLE_HASH_SIZE,
+                stack[depth - 1], SUIT_MERKLE_HASH_SIZE, 
+                stack[depth - 2]);
+        depth--;
+    }
+    memcpy(root, stack[0], SUIT_MERKLE_HASH_SIZE);
+    return 0;
+}
+
+int suit_merkle_init(suit_merkle_t * m, suit_context_t * ctx, size_t idx,
+        const uint8_t * leaves, size_t len_leaves)
+{
+    const uint8_t * root; size_t len_root;
+    suit_digest_alg_t alg;
+    uint8_t hash[SUIT_MERKLE_HASH_SIZE];
+    memset(m, 0, sizeof(*m));
+    if (!suit_has_block_digest(ctx, idx)) return 1;
+    suit_get_block_digest(ctx, idx, &m->block_size, &alg, &root, &len_root);
+    if (alg != suit_digest_alg_sha256) return 1;
+    if (len_root != SUIT_MERKLE_HASH_SIZE) return 1;
+
+    m->size = suit_get_size(ctx, idx);
+    m->block_count = (m->size + m->block_size - 1) / m->block_size;
+    if (len_leaves != m->block_count * SUIT_MERKLE_HASH_SIZE) return 1;
+    if (suit_merkle_root(leaves, m->block_count, hash)) return 1;
+    if (memcmp(hash, root, SUIT_MERKLE_HASH_SIZE)) return 1;
+    m->leaves = leaves;
+    return 0;
+}
+
+bool suit_merkle_block_is_match(const suit_merkle_t * m, size_t block,
+        const uint8_t * data, size_t len)
+{
+    uint8_t leaf[SUIT_MERKLE_HASH_SIZE];
+    if (block >= m->block_count) return false;
+    if (len != MIN(m->block_size, m->size - block * m->block_size))
+        return false;
+    suit_merkle_leaf(data, len, leaf);
+    return !memcmp(leaf, m->leaves + block * SUIT_MERKLE_HASH_SIZE, 
+            SUIT_MERKLE_HASH_SIZE);
+}
+
+int _suit_merkle_check_block(void * arg, size_t block)
+{
+    _suit_merkle_job_t * job = arg;
+    const suit_merkle_t * m = job->m;
+    size_t off = block * m->block_size;
+    if (!suit_merkle_block_is_match(m, block, job->image + off,
+                MIN(m->block_size, m->size - off))) {
+        atomic_set_bit(job->bad, block);
+        atomic_inc(&job->count);
+    }
+    return 0;
+}
+
+size_t suit_merkle_check_image(const suit_merkle_t * m, 
+        const uint8_t * image, size_t threads, atomic_t * bad)
+{
+    _suit_merkle_job_t job = { .m = m, .image = image, .bad = bad };
+    atomic_set(&job.count, 0);
+    for (size_t i = 0; i < m->block_count; i += ATOMIC_BITS)
+        atomic_set(&bad[i / ATOMIC_BITS], 0);
+    _suit_parallel_for(m->block_count, threads, 
+            _suit_merkle_check_block, &job);
+    return atomic_get(&job.count);
+}
@@ -16,6 +16,7 @@
  */
 
 #include <zoot/suit.h>
+#include <sys/util.h>
 
 /*
  * All strings in the SUIT manifest are copied by reference to 
@@ -42,39 +43,200 @@
     if (nanocbor_get_tstr(&nc, (const uint8_t **) &val, &len_val) < 0) \
     return 1;
 
+/*
+ * Commands apply to a set of components, kept as a bitset over the 
+ * component indices.
+ */
+#define SUIT_COMP_WORDS ((SUIT_MAX_COMPONENTS + 31) / 32)
+
+typedef struct {
+    uint32_t bits[SUIT_COMP_WORDS];
+} _suit_comp_set_t;
+
+/* returns the first component in the set at or after idx */
+size_t _suit_comp_next(const _suit_comp_set_t * set, size_t idx)
+{
+    while (idx < SUIT_MAX_COMPONENTS) {
+        uint32_t word = set->bits[idx / 32] >> (idx % 32);
+        if (word) return idx + __builtin_ctz(word);
+        idx = (idx / 32 + 1) * 32;
+    }
+    return SUIT_MAX_COMPONENTS;
+}
+
+#define SUIT_FOR_EACH_COMP(set, idx) \
+    for (size_t idx = _suit_comp_next(set, 0); \
+            idx < SUIT_MAX_COMPONENTS; \
+            idx = _suit_comp_next(set, idx + 1))
+
+/* compares two strings referenced from manifests */
+bool _suit_str_is_equal(const uint8_t * a, size_t len_a,
+        const uint8_t * b, size_t len_b)
+{
+    if (len_a != len_b) return false;
+    if (a == b) return true;
+    return a && b && !memcmp(a, b, len_a);
+}
+
+bool _suit_uri_alts_is_equal(const suit_params_t * a, const suit_params_t * b)
+{
+    if (a->uri_alt_count != b->uri_alt_count) return false;
+    for (size_t i = 0; i < a->uri_alt_count; i++)
+        if (!_suit_str_is_equal(a->uri_alts[i], a->len_uri_alts[i],
+                    b->uri_alts[i], b->len_uri_alts[i]))
+            return false;
+    return true;
+}
+
+/* returns true if both blocks hold the same parameters */
+bool _suit_params_is_equal(const suit_params_t * a, const suit_params_t * b)
+{
+    return a->size == b->size 
+        && a->digest_alg == b->digest_alg
+        && a->archive_alg == b->archive_alg
+        && a->source == b->source
+        && _suit_str_is_equal(a->uri, a->len_uri, b->uri, b->len_uri)
+        && _suit_str_is_equal(a->digest, a->len_digest, 
+                b->digest, b->len_digest)
+        && _suit_str_is_equal(a->class_id, a->len_class_id, 
+                b->class_id, b->len_class_id)
+        && _suit_str_is_equal(a->vendor_id, a->len_vendor_id, 
+                b->vendor_id, b->len_vendor_id)
+        && _suit_str_is_equal(a->device_id, a->len_device_id, 
+                b->device_id, b->len_device_id)
+        && a->block_size == b->block_size
+        && a->block_digest_alg == b->block_digest_alg
+        && _suit_str_is_equal(a->block_root, a->len_block_root,
+                b->block_root, b->len_block_root)
+        && a->priority == b->priority
+        && a->min_battery == b->min_battery
+        && _suit_str_is_equal(a->wait_info, a->len_wait_info,
+                b->wait_info, b->len_wait_info)
+        && _suit_uri_alts_is_equal(a, b);
+}
+
+/* 
+ * Returns a block holding the given parameters, reusing an identical
+ * block in use or else a free one.
+ */
+int _suit_params_get(suit_context_t * ctx, const suit_params_t * params,
+        uint16_t * out)
+{
+    size_t slot = SUIT_MAX_PARAM_BLOCKS;
+    for (size_t i = 0; i < SUIT_MAX_PARAM_BLOCKS; i++) {
+        if (ctx->params[i].refs == 0) {
+            if (slot == SUIT_MAX_PARAM_BLOCKS) slot = i;
+        } else if (_suit_params_is_equal(&ctx->params[i], params)) {
+            *out = i; return 0;
+        }
+    }
+    if (slot == SUIT_MAX_PARAM_BLOCKS) return 1;
+    ctx->params[slot] = *params;
+    ctx->params[slot].refs = 0;
+    *out = slot; return 0;
+}
+
+/* copies the parameters present in new into params */
+void _suit_params_merge(suit_params_t * params,
+        const suit_params_t * new, bool override)
+{
+    if (new->vendor_id && (override || params->vendor_id == NULL)) {
+        params->vendor_id = new->vendor_id;
+        params->len_vendor_id = new->len_vendor_id;
+    }
+    if (new->class_id && (override || params->class_id == NULL)) {
+        params->class_id = new->class_id;
+        params->len_class_id = new->len_class_id;
+    }
+    if (new->device_id && (override || params->device_id == NULL)) {
+        params->device_id = new->device_id;
+        params->len_device_id = new->len_device_id;
+    }
+    if (new->uri && (override || params->uri == NULL)) {
+        params->uri = new->uri;
+        params->len_uri = new->len_uri;
+    }
+    if (new->digest && (override || params->digest == NULL)) {
+        params->digest_alg = new->digest_alg;
+        params->digest = new->digest;
+        params->len_digest = new->len_digest;
+    }
+    if (new->block_root && (override || params->block_root == NULL)) {
+        params->block_size = new->block_size;
+        params->block_digest_alg = new->block_digest_alg;
+        params->block_root = new->block_root;
+        params->len_block_root = new->len_block_root;
+    }
+    if (new->size && (override || params->size == 0)) {
+        params->size = new->size;
+        params->size_at = new->size_at;
+    }
+    if (new->archive_alg && (override || params->archive_alg == 0))
+        params->archive_alg = new->archive_alg;
+    if (new->source && (override || params->source == NULL))
+        params->source = new->source;
+    if (new->priority && (override || params->priority == 0))
+        params->priority = new->priority;
+    if (new->min_battery && (override || params->min_battery == 0))
+        params->min_battery = new->min_battery;
+    if (new->wait_info && (override || params->wait_info == NULL)) {
+        params->wait_info = new->wait_info;
+        params->len_wait_info = new->len_wait_info;
+    }
+
+    /* alternative URIs are added to those known, up to the limit */
+    for (size_t i = 0; i < new->uri_alt_count; i++) {
+        bool known = _suit_str_is_equal(new->uri_alts[i], 
+                new->len_uri_alts[i], params->uri, params->len_uri);
+        for (size_t j = 0; j < params->uri_alt_count; j++)
+            known |= _suit_str_is_equal(new->uri_alts[i], 
+                    new->len_uri_alts[i], params->uri_alts[j], 
+                    params->len_uri_alts[j]);
+        if (known || params->uri_alt_count == SUIT_MAX_URI_ALTS) 
+            continue;
+        params->uri_alts[params->uri_alt_count] = new->uri_alts[i];
+        params->len_uri_alts[params->uri_alt_count] = new->len_uri_alts[i];
+        params->uri_alt_count++;
+    }
+}
+
+int _suit_params_apply(suit_context_t * ctx, const _suit_comp_set_t * set,
+        const suit_params_t * new, bool override);
+
+/*
+ * Parameters are decoded once into a block of their own and then 
+ * merged into the block of every selected component.
+ */
 int _suit_parse_parameters(
-        suit_context_t * ctx, size_t idx,
+        suit_context_t * ctx, const _suit_comp_set_t * set,
         nanocbor_value_t * map, bool override)
 {
     nanocbor_value_t arr;
-    size_t map_key; size_t map_val;
+    size_t map_key; uint32_t val;
+    suit_params_t new = { 0 };
     while (!nanocbor_at_end(map)) {
         CBOR_GET_INT(*map, map_key);
         switch (map_key) {
 
             /*
-             * The vendor ID, class ID and URI fields are encoded 
-             * as CBOR byte strings and are copied by reference.
+             * The vendor ID, class ID, device ID and URI fields are
+             * encoded as CBOR byte strings and are copied by 
+             * reference.
              */
             case suit_param_vendor_id:
-                if (override || ctx->components[idx].vendor_id == NULL) 
-                    CBOR_GET_BSTR(*map, 
-                            ctx->components[idx].vendor_id,
-                            ctx->components[idx].len_vendor_id);
+                CBOR_GET_BSTR(*map, new.vendor_id, new.len_vendor_id);
                 break;
 
             case suit_param_class_id:
-                if (override || ctx->components[idx].class_id == NULL)
-                    CBOR_GET_BSTR(*map, 
-                            ctx->components[idx].class_id,
-                            ctx->components[idx].len_class_id);
+                CBOR_GET_BSTR(*map, new.class_id, new.len_class_id);
+                break;
+
+            case suit_param_device_id:
+                CBOR_GET_BSTR(*map, new.device_id, new.len_device_id);
                 break;
 
             case suit_param_uri:
-                if (override || ctx->components[idx].uri == NULL)
-                    CBOR_GET_TSTR(*map, 
-                            ctx->components[idx].uri,
-                            ctx->components[idx].len_uri);
+                CBOR_GET_TSTR(*map, new.uri, new.len_uri);
                 break;
 
             /*
@@ -83,31 +245,42 @@ int _suit_parse_parameters(
              */
             case suit_param_image_digest:
                 CBOR_ENTER_ARR(*map, arr);
-                if (override || ctx->components[idx].digest == NULL) {
-                    if (nanocbor_get_uint32(&arr, 
-                                (uint32_t *) &ctx->components[idx].digest_alg) < 0) 
-                        return 1;
-                    CBOR_GET_BSTR(arr,
-                            ctx->components[idx].digest,
-                            ctx->components[idx].len_digest);
-                }
+                CBOR_GET_INT(arr, val);
+                new.digest_alg = val;
+                CBOR_GET_BSTR(arr, new.digest, new.len_digest);
                 nanocbor_skip(map); break;
 
+            /*
+             * Block digests are the root of a Merkle tree over 
+             * blocks of the image, stored with the block size and
+             * algorithm in a sub-array.
+             */
+#ifdef CONFIG_ZOOT_BLOCK_DIGEST
+            case suit_param_block_digest:
+                CBOR_ENTER_ARR(*map, arr);
+                CBOR_GET_INT(arr, val);
+                if (val == 0) return 1;
+                new.block_size = val;
+                CBOR_GET_INT(arr, val);
+                new.block_digest_alg = val;
+                CBOR_GET_BSTR(arr, new.block_root, new.len_block_root);
+                nanocbor_skip(map); break;
+#endif
+
             /*
              * The image size and archive (i.e., compression) 
              * information are encoded as CBOR integers and are 
              * copied by value.
              */
             case suit_param_image_size:
-                if (override || ctx->components[idx].size == 0)
-                    CBOR_GET_INT(*map, ctx->components[idx].size);
+                new.size_at = map->cur;
+                CBOR_GET_INT(*map, val);
+                new.size = val;
                 break;
 
             case suit_param_archive_info:
-                if (override || ctx->components[idx].archive_alg == 0)
-                    if (nanocbor_get_uint32(map, 
-                                (uint32_t *) &ctx->components[idx].archive_alg) < 0) 
-                        return 1;
+                CBOR_GET_INT(*map, val);
+                new.archive_alg = val;
                 break;
 
             /*
@@ -115,127 +288,502 @@ int _suit_parse_parameters(
              * to another. This is stored as a pointer in the
              * suit_component struct.
              */
+#ifdef CONFIG_ZOOT_COPY
             case suit_param_source_comp:
-                CBOR_GET_INT(*map, map_val);
-                if (override || ctx->components[idx].source == NULL)
-                    ctx->components[idx].source = &ctx->components[map_val];
+                CBOR_GET_INT(*map, val);
+                if (val >= ctx->component_count) return 1;
+                new.source = &ctx->components[val];
                 break;
+#endif
+
+            /*
+             * Scheduling parameters are kept for the scheduler (see
+             * schedule.c). Priorities may be negative; wait events 
+             * are a byte-string wrapped map, copied by reference.
+             */
+#ifdef CONFIG_ZOOT_SCHEDULING
+            case suit_param_update_priority:
+                if (nanocbor_get_int32(map, &new.priority) < 0) return 1;
+                break;
+
+            case suit_param_min_battery:
+                CBOR_GET_INT(*map, new.min_battery);
+                break;
+
+            case suit_param_wait_info:
+                CBOR_GET_BSTR(*map, new.wait_info, new.len_wait_info);
+                break;
+#endif
 
             /* FAIL if unsupported */
             default: return 1;
 
         }
     }
+
+    return _suit_params_apply(ctx, set, &new, override);
+}
+
+/*
+ * Merges new into the block of every component in the set. Components 
+ * that shared a block before share the merged block after, so the 
+ * merge runs once per distinct block.
+ */
+int _suit_params_apply(suit_context_t * ctx, const _suit_comp_set_t * set,
+        const suit_params_t * new, bool override)
+{
+    /* merged block for each block in use before, once computed */
+    uint16_t merged[SUIT_MAX_PARAM_BLOCKS];
+    bool done[SUIT_MAX_PARAM_BLOCKS] = { false };
+    SUIT_FOR_EACH_COMP(set, idx) {
+        suit_component_t * comp = &ctx->components[idx];
+        uint16_t old = comp->params;
+        if (!done[old]) {
+            suit_params_t params = ctx->params[old];
+            _suit_params_merge(&params, new, override);
+            if (_suit_params_get(ctx, &params, &merged[old]))
+                return 1;
+            done[old] = true;
+        }
+        comp->params = merged[old];
+        ctx->params[old].refs--;
+        ctx->params[comp->params].refs++;
+    }
+    return 0;
+}
+
+/*
+ * The component index argument is an index, true for all components
+ * or an array of indices.
+ */
+int _suit_parse_comp_idx(suit_context_t * ctx, 
+        nanocbor_value_t * seq, _suit_comp_set_t * set)
+{
+    nanocbor_value_t arr;
+    uint32_t idx; bool all;
+    memset(set, 0, sizeof(*set));
+    switch (nanocbor_get_type(seq)) {
+
+        case NANOCBOR_TYPE_UINT:
+            CBOR_GET_INT(*seq, idx);
+            if (idx >= ctx->component_count) return 1;
+            set->bits[idx / 32] |= BIT(idx % 32);
+            return 0;
+
+        case NANOCBOR_TYPE_FLOAT:
+            if (nanocbor_get_bool(seq, &all) < 0 || !all) return 1;
+            for (idx = 0; idx < ctx->component_count / 32; idx++)
+                set->bits[idx] = UINT32_MAX;
+            if (ctx->component_count % 32)
+                set->bits[idx] = BIT(ctx->component_count % 32) - 1;
+            return 0;
+
+        case NANOCBOR_TYPE_ARR:
+            CBOR_ENTER_ARR(*seq, arr);
+            while (!nanocbor_at_end(&arr)) {
+                CBOR_GET_INT(arr, idx);
+                if (idx >= ctx->component_count) return 1;
+                set->bits[idx / 32] |= BIT(idx % 32);
+            }
+            nanocbor_skip(seq);
+            return 0;
+
+        /* FAIL if unsupported */
+        default: return 1;
+
+    }
+}
+
+/*
+ * Command sequences are parsed without recursion. Every try-each
+ * directive pushes a frame onto a fixed-size stack, so the stack use
+ * of the parser does not depend on the manifest. Manifests nested 
+ * deeper than CONFIG_ZOOT_MAX_NESTING are rejected.
+ */
+typedef struct {
+    nanocbor_value_t seq;   /* remaining commands */
+    nanocbor_value_t alts;  /* remaining try-each alternatives */
+    _suit_comp_set_t comps; /* current components */
+    size_t dep_idx;         /* current dependency index */
+} _suit_frame_t;
+
+/* parses one command; try-each alternatives are returned in alts */
+int _suit_parse_command(suit_context_t * ctx, _suit_frame_t * frame,
+        nanocbor_value_t * alts, bool * nest)
+{
+    nanocbor_value_t map;
+    size_t arr_key; 
+    CBOR_GET_INT(frame->seq, arr_key);
+    switch (arr_key) {
+
+        /* DIRECTIVE override parameters */
+        case suit_dir_override_params:
+            CBOR_ENTER_MAP(frame->seq, map);
+            if (_suit_parse_parameters(ctx, &frame->comps, &map, true))
+                return 1;
+            nanocbor_skip(&frame->seq); break;
+        
+        /* DIRECTIVE set parameters */
+        case suit_dir_set_params:
+            CBOR_ENTER_MAP(frame->seq, map);
+            if (_suit_parse_parameters(ctx, &frame->comps, &map, false))
+                return 1;
+            nanocbor_skip(&frame->seq); break;
+
+        /* DIRECTIVE run this component */
+        case suit_dir_run:
+            SUIT_FOR_EACH_COMP(&frame->comps, idx)
+                ctx->components[idx].run = true;
+            nanocbor_skip(&frame->seq); break;
+
+        /* 
+         * A swap exchanges the contents of a component with those of
+         * its source component, which then replaces the copy implied 
+         * by the source (see zoot/swap.h).
+         */
+
+#ifdef CONFIG_ZOOT_SWAP
+        /* DIRECTIVE swap this component */
+        case suit_dir_swap:
+            SUIT_FOR_EACH_COMP(&frame->comps, idx)
+                ctx->components[idx].swap = true;
+            nanocbor_skip(&frame->seq); break;
+#endif
+
+#ifdef CONFIG_ZOOT_SCHEDULING
+        /* DIRECTIVE wait for the events in the wait parameter */
+        case suit_dir_wait:
+            SUIT_FOR_EACH_COMP(&frame->comps, idx)
+                ctx->components[idx].wait = true;
+            nanocbor_skip(&frame->seq); break;
+#endif
+
+        /* DIRECTIVE set component index */
+        case suit_dir_set_comp_idx:
+            if (_suit_parse_comp_idx(ctx, &frame->seq, &frame->comps))
+                return 1;
+            break;
+
+#ifdef CONFIG_ZOOT_DEPENDENCIES
+        /* DIRECTIVE set dependency index */
+        case suit_dir_set_dep_idx:
+            CBOR_GET_INT(frame->seq, frame->dep_idx);
+            if (frame->dep_idx >= ctx->dependency_count) return 1;
+            break;
+
+        /* 
+         * Dependencies are resolved after parsing (see deps.c); the 
+         * directive only marks the dependency for processing.
+         */
+
+        /* DIRECTIVE process dependency */
+        case suit_dir_process_dep:
+            if (frame->dep_idx >= ctx->dependency_count) return 1;
+            ctx->dependencies[frame->dep_idx].process = true;
+            nanocbor_skip(&frame->seq); break;
+#endif
+
+        /*
+         * This condition is underspecified in the latest 
+         * draft. There is insufficient information to create a 
+         * working implementation.
+         */
+
+        /* CONDITION check component offset */
+        case suit_cond_comp_offset:
+            nanocbor_skip(&frame->seq); break;
+
+        /* 
+         * This directive provides an ordered list of command
+         * sequences to attempt. The first to succeed is 
+         * accepted. If all fail, the manifest is rejected. 
+         */
+
+#ifdef CONFIG_ZOOT_TRY_EACH
+        /* DIRECTIVE try each */
+        case suit_dir_try_each:
+            CBOR_ENTER_ARR(frame->seq, *alts);
+            *nest = true;
+            nanocbor_skip(&frame->seq); break;
+#endif
+         
+        /* 
+         * These conditions and directives are not parsed 
+         * directly. They are implied by the existence of other 
+         * fields in the manifest.
+         *  - vendor IDs should be checked, if present
+         *  - class IDs should be checked, if present
+         *  - device IDs should be checked, if present
+         *  - battery levels should be checked, if present
+         *  - digests should be verified, if present
+         *  - components should be fetched if a URI is present
+         *  - components should be copied if a source component
+         *    is declared
+         */ 
+
+        /* CONDITION check vendor ID */
+        case suit_cond_vendor_id:
+            nanocbor_skip(&frame->seq); break;
+
+        /* CONDITION check class ID */ 
+        case suit_cond_class_id:
+            nanocbor_skip(&frame->seq); break;
+
+        /* CONDITION check device ID */ 
+        case suit_cond_device_id:
+            nanocbor_skip(&frame->seq); break;
+        
+#ifdef CONFIG_ZOOT_SCHEDULING
+        /* CONDITION check battery level */
+        case suit_cond_min_battery:
+            nanocbor_skip(&frame->seq); break;
+#endif
+
+        /* CONDITION check component digest */
+        case suit_cond_image_match:
+            nanocbor_skip(&frame->seq); break;
+
+        /* DIRECTIVE fetch this component */
+        case suit_dir_fetch:
+            nanocbor_skip(&frame->seq); break;
+
+#ifdef CONFIG_ZOOT_COPY
+        /* DIRECTIVE copy this component */
+        case suit_dir_copy:
+            nanocbor_skip(&frame->seq); break;
+#endif
+
+        /* FAIL if unsupported */
+        default: return 1;
+
+    }
     return 0;
 }
 
+#ifdef CONFIG_ZOOT_TRY_EACH
+/*
+ * Starts the next alternative of a try-each directive, which begins 
+ * at the component and dependency indices of the enclosing sequence.
+ * Alternatives that are not command sequences count as failed.
+ */
+int _suit_frame_next(_suit_frame_t * frame, const _suit_frame_t * parent)
+{
+    nanocbor_value_t top;
+    uint8_t * tmp; size_t len_tmp;
+    while (!nanocbor_at_end(&frame->alts)) {
+        CBOR_GET_BSTR(frame->alts, tmp, len_tmp);
+        nanocbor_decoder_init(&top, tmp, len_tmp);
+        if (nanocbor_enter_array(&top, &frame->seq) < 0) continue;
+        frame->comps = parent->comps;
+        frame->dep_idx = parent->dep_idx;
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Adds the URIs of an alternative to new if it names another location
+ * of the same image: it may only set parameters, and only URIs or a 
+ * digest and size equal to those each component already has. An 
+ * alternative with conditions or other commands, or that describes a
+ * different image, such as the other slot of an A/B update, is not a
+ * mirror and false is returned.
+ */
+bool _suit_alt_is_mirror(suit_context_t * ctx, 
+        const _suit_comp_set_t * comps, nanocbor_value_t * seq, 
+        suit_params_t * new)
+{
+    nanocbor_value_t map, arr;
+    const uint8_t * tmp; size_t len_tmp;
+    uint32_t key, val;
+    size_t n = new->uri_alt_count;
+    while (!nanocbor_at_end(seq)) {
+        if (nanocbor_get_uint32(seq, &key) < 0
+                || (key != suit_dir_set_params 
+                    && key != suit_dir_override_params)
+                || nanocbor_enter_map(seq, &map) < 0)
+            return false;
+        while (!nanocbor_at_end(&map)) {
+            if (nanocbor_get_uint32(&map, &key) < 0) return false;
+            if (key == suit_param_uri) {
+                if (nanocbor_get_tstr(&map, &tmp, &len_tmp) < 0)
+                    return false;
+                if (n < SUIT_MAX_URI_ALTS) {
+                    new->uri_alts[n] = (uint8_t *) tmp;
+                    new->len_uri_alts[n] = len_tmp;
+                    n++;
+                }
+            } else if (key == suit_param_image_digest) {
+                if (nanocbor_enter_array(&map, &arr) < 0
+                        || nanocbor_get_uint32(&arr, &val) < 0
+                        || nanocbor_get_bstr(&arr, &tmp, &len_tmp) < 0)
+                    return false;
+                SUIT_FOR_EACH_COMP(comps, idx) {
+                    suit_params_t * p = 
+                        &ctx->params[ctx->components[idx].params];
+                    if (p->digest_alg != val || !_suit_str_is_equal(
+                                p->digest, p->len_digest, tmp, len_tmp))
+                        return false;
+                }
+                if (nanocbor_skip(&map) < 0) return false;
+            } else if (key == suit_param_image_size) {
+                if (nanocbor_get_uint32(&map, &val) < 0) return false;
+                SUIT_FOR_EACH_COMP(comps, idx)
+                    if (ctx->params[ctx->components[idx].params].size 
+                            != val)
+                        return false;
+            } else return false;
+        }
+        if (nanocbor_skip(seq) < 0) return false;
+    }
+    new->uri_alt_count = n;
+    return true;
+}
+
+/*
+ * The alternatives left unexplored when a try-each directive passes 
+ * may name other locations of the same image: a mirror, a CDN or a 
+ * cache close to the device. Their URIs are kept as alternates of the
+ * components the directive applies to so that a fetcher can spread 
+ * the download over all of them. Alternatives that are not mirrors
+ * (see _suit_alt_is_mirror) or are malformed are ignored.
+ */
+int _suit_collect_uris(suit_context_t * ctx, nanocbor_value_t * alts,
+        const _suit_comp_set_t * comps)
+{
+    suit_params_t new = { 0 };
+    nanocbor_value_t top, seq;
+    const uint8_t * tmp; size_t len_tmp;
+    while (!nanocbor_at_end(alts) && new.uri_alt_count < SUIT_MAX_URI_ALTS) {
+        if (nanocbor_get_bstr(alts, &tmp, &len_tmp) < 0) break;
+        nanocbor_decoder_init(&top, tmp, len_tmp);
+        if (nanocbor_enter_array(&top, &seq) < 0) continue;
+        _suit_alt_is_mirror(ctx, comps, &seq, &new);
+    }
+    if (new.uri_alt_count == 0) return 0;
+    return _suit_params_apply(ctx, comps, &new, false);
+}
+
 int _suit_parse_sequence(
         suit_context_t * ctx, size_t idx,
         const uint8_t * seq, size_t len_seq)
 {
-    nanocbor_value_t top, arr, subarr, map;
+    _suit_frame_t stack[CONFIG_ZOOT_MAX_NESTING + 1];
+    size_t depth = 0;
+    nanocbor_value_t top, alts;
     nanocbor_decoder_init(&top, seq, len_seq);
-    uint8_t * tmp; size_t len_tmp; bool pass;
-
-    CBOR_ENTER_ARR(top, arr);
-    size_t arr_key; 
-    while (!nanocbor_at_end(&arr)) {
-        CBOR_GET_INT(arr, arr_key);
-        switch (arr_key) {
-
-            /* DIRECTIVE override parameters */
-            case suit_dir_override_params:
-                CBOR_ENTER_MAP(arr, map);
-                if (_suit_parse_parameters(ctx, idx, &map, true))
-                    return 1;
-                nanocbor_skip(&arr); break;
-            
-            /* DIRECTIVE set parameters */
-            case suit_dir_set_params:
-                CBOR_ENTER_MAP(arr, map);
-                if (_suit_parse_parameters(ctx, idx, &map, false))
-                    return 1;
-                nanocbor_skip(&arr); break;
+    CBOR_ENTER_ARR(top, stack[0].seq);
+    memset(&stack[0].comps, 0, sizeof(stack[0].comps));
+    stack[0].comps.bits[idx / 32] = BIT(idx % 32);
+    stack[0].dep_idx = 0;
+
+    while (true) {
+        _suit_frame_t * frame = &stack[depth];
+
+        /* a completed alternative passes its try-each directive */
+        if (nanocbor_at_end(&frame->seq)) {
+            if (depth == 0) return 0;
+            if (_suit_collect_uris(ctx, &frame->alts, 
+                        &stack[depth - 1].comps))
+                return 1;
+            depth--; continue;
+        }
 
-            /* DIRECTIVE run this component */
-            case suit_dir_run:
-                ctx->components[idx].run = true;
-                nanocbor_skip(&arr); break;
+        bool nest = false;
+        int err = _suit_parse_command(ctx, frame, &alts, &nest);
+        if (!err && nest) {
+            if (depth == CONFIG_ZOOT_MAX_NESTING) err = 1;
+            else {
+                stack[depth + 1].alts = alts;
+                err = _suit_frame_next(&stack[depth + 1], frame);
+                if (!err) depth++;
+            }
+        }
 
-            /* DIRECTIVE set component index */
-            case suit_dir_set_comp_idx:
-                CBOR_GET_INT(arr, idx);
-                if (idx > ctx->component_count - 1) return 1;
-                break;
+        /* 
+         * On failure, move on to the next alternative of the closest
+         * try-each directive. A try-each without alternatives left 
+         * fails in turn, and so does a failing top-level sequence.
+         */
+        while (err) {
+            if (depth == 0) return 1;
+            err = _suit_frame_next(&stack[depth], &stack[depth - 1]);
+            if (err) depth--;
+        }
+    }
+}
+#else
+/* 
+ * Without try-each, a sequence is a single frame and the first 
+ * failing command fails it.
+ */
+int _suit_parse_sequence(
+        suit_context_t * ctx, size_t idx,
+        const uint8_t * seq, size_t len_seq)
+{
+    _suit_frame_t frame;
+    nanocbor_value_t top, alts;
+    bool nest;
+    nanocbor_decoder_init(&top, seq, len_seq);
+    CBOR_ENTER_ARR(top, frame.seq);
+    memset(&frame.comps, 0, sizeof(frame.comps));
+    frame.comps.bits[idx / 32] = BIT(idx % 32);
+    frame.dep_idx = 0;
+
+    while (!nanocbor_at_end(&frame.seq))
+        if (_suit_parse_command(ctx, &frame, &alts, &nest))
+            return 1;
+    return 0;
+}
+#endif
 
-            /*
-             * This condition is underspecified in the latest 
-             * draft. There is insufficient information to create a 
-             * working implementation.
-             */
+#ifdef CONFIG_ZOOT_DEPENDENCIES
+/*
+ * Dependencies are listed by the digest of the manifest they refer 
+ * to. The digest is copied by reference; the component prefix is not
+ * used.
+ */
+int _suit_parse_dependencies(suit_context_t * ctx,
+        const uint8_t * deps, size_t len_deps)
+{
+    nanocbor_value_t top, arr, map, digest;
+    nanocbor_decoder_init(&top, deps, len_deps);
 
-            /* CONDITION check component offset */
-            case suit_cond_comp_offset:
-                nanocbor_skip(&arr); break;
+    CBOR_ENTER_ARR(top, arr);
+    ctx->dependency_count = arr.remaining;
+    if (ctx->dependency_count > SUIT_MAX_DEPENDENCIES)
+        return 1;
+
+    size_t map_key;
+    for (size_t idx = 0; !nanocbor_at_end(&arr); idx++) {
+        suit_dependency_t * dep = &ctx->dependencies[idx];
+        CBOR_ENTER_MAP(arr, map);
+        while (!nanocbor_at_end(&map)) {
+            CBOR_GET_INT(map, map_key);
+            switch (map_key) {
+
+                case suit_dep_digest:
+                    CBOR_ENTER_ARR(map, digest);
+                    if (nanocbor_get_uint32(&digest, 
+                                (uint32_t *) &dep->digest_alg) < 0)
+                        return 1;
+                    CBOR_GET_BSTR(digest, dep->digest, dep->len_digest);
+                    nanocbor_skip(&map); break;
 
-            /* 
-             * This directive provides an ordered list of command
-             * sequences to attempt. The first to succeed is 
-             * accepted. If all fail, the manifest is rejected. 
-             */
+                case suit_dep_prefix:
+                    nanocbor_skip(&map); break;
 
-            /* DIRECTIVE try each */
-            case suit_dir_try_each:
-                pass = false;
-                CBOR_ENTER_ARR(arr, subarr);
-                while (!nanocbor_at_end(&subarr)) {
-                    CBOR_GET_BSTR(subarr, tmp, len_tmp);
-                    if (!_suit_parse_sequence(ctx, idx, tmp, len_tmp)) {
-                        pass = true; break;
-                    }
-                }
-                if (!pass) return 1;
-                nanocbor_skip(&arr); break;
-             
-            /* 
-             * These conditions and directives are not parsed 
-             * directly. They are implied by the existence of other 
-             * fields in the manifest.
-             *  - vendor IDs should be checked, if present
-             *  - class IDs should be checked, if present
-             *  - digests should be verified, if present
-             *  - components should be fetched if a URI is present
-             *  - components should be copied if a source component
-             *    is declared
-             */ 
-
-            /* CONDITION check vendor ID */
-            case suit_cond_vendor_id:
-                nanocbor_skip(&arr); break;
-
-            /* CONDITION check class ID */ 
-            case suit_cond_class_id:
-                nanocbor_skip(&arr); break;
-            
-            /* CONDITION check component digest */
-            case suit_cond_image_match:
-                nanocbor_skip(&arr); break;
-
-            /* DIRECTIVE fetch this component */
-            case suit_dir_fetch:
-                nanocbor_skip(&arr); break;
-
-            /* DIRECTIVE copy this component */
-            case suit_dir_copy:
-                nanocbor_skip(&arr); break;
-
-            /* FAIL if unsupported */
-            default: return 1;
+                /* FAIL if unsupported */
+                default: return 1;
 
+            }
         }
+        if (dep->digest == NULL) return 1;
+        nanocbor_skip(&arr);
     }
     return 0;
 }
+#endif
 
 int _suit_parse_common(suit_context_t * ctx,
         const uint8_t * com, size_t len_com)
@@ -265,6 +813,17 @@ int _suit_parse_common(suit_context_t * ctx,
                     return 1;
                 break;
 
+            /* FAIL if dependencies are not supported */
+            case suit_common_deps:
+#ifdef CONFIG_ZOOT_DEPENDENCIES
+                CBOR_GET_BSTR(map, tmp, len_tmp);
+                if (_suit_parse_dependencies(ctx, tmp, len_tmp))
+                    return 1;
+                break;
+#else
+                return 1;
+#endif
+
             case suit_common_seq:
                 CBOR_GET_BSTR(map, tmp, len_tmp);
                 if (_suit_parse_sequence(ctx, 0, tmp, len_tmp))
@@ -287,9 +846,18 @@ int suit_parse_init(suit_context_t * ctx,
     nanocbor_decoder_init(&top, man, len_man);
     uint8_t * tmp; size_t len_tmp;
 
-    /* initialize components */
+    /* initialize components, all sharing one empty parameter block */
     suit_component_t nil = {
         .run            = false, 
+        .swap           = false,
+        .params         = 0,
+    };
+
+    for (size_t idx = 0; idx < SUIT_MAX_COMPONENTS; idx++)
+        ctx->components[idx] = nil;
+    ctx->component_count = 0;
+
+    suit_params_t nil_params = {
         .size           = 0,
         .digest_alg     = 0, 
         .archive_alg    = 0,
@@ -298,10 +866,26 @@ int suit_parse_init(suit_context_t * ctx,
         .digest         = NULL,
         .class_id       = NULL,
         .vendor_id      = NULL,
+        .device_id      = NULL,
+        .block_root     = NULL,
+        .payload        = NULL,
+        .refs           = 0,
     };
 
-    for (size_t idx = 0; idx < SUIT_MAX_COMPONENTS; idx++)
-        ctx->components[idx] = nil;
+    for (size_t idx = 0; idx < SUIT_MAX_PARAM_BLOCKS; idx++)
+        ctx->params[idx] = nil_params;
+    ctx->params[0].refs = SUIT_MAX_COMPONENTS;
+
+    /* initialize dependencies */
+    suit_dependency_t nil_dep = {
+        .process        = false,
+        .digest_alg     = 0,
+        .digest         = NULL,
+    };
+
+    for (size_t idx = 0; idx < SUIT_MAX_DEPENDENCIES; idx++)
+        ctx->dependencies[idx] = nil_dep;
+    ctx->dependency_count = 0;
 
     /* parse top-level map */
     CBOR_ENTER_MAP(top, map);
@@ -322,9 +906,16 @@ int suit_parse_init(suit_context_t * ctx,
                 break;
 
             case suit_header_manifest_seq_num:
+                ctx->sequence_number_at = map.cur;
                 CBOR_GET_INT(map, ctx->sequence_number);
                 break;
 
+            case suit_header_dep_resolution:
+                CBOR_GET_BSTR(map, tmp, len_tmp);
+                if (_suit_parse_sequence(ctx, 0, tmp, len_tmp))
+                    return 1;
+                break;
+
             case suit_header_payload_fetch:
                 CBOR_GET_BSTR(map, tmp, len_tmp);
                 if (_suit_parse_sequence(ctx, 0, tmp, len_tmp))
@@ -355,6 +946,16 @@ int suit_parse_init(suit_context_t * ctx,
                     return 1;
                 break;
 
+            /* 
+             * Text and CoSWID describe the update to people and to
+             * software inventories; nothing in them affects the 
+             * install.
+             */
+            case suit_header_text:
+            case suit_header_coswid:
+                nanocbor_skip(&map);
+                break;
+
             /* FAIL if unsupported */
             default: return 1;
 
@@ -363,6 +964,12 @@ int suit_parse_init(suit_context_t * ctx,
     return 0;
 }
 
+/* returns the parameter block of a component */
+suit_params_t * _suit_params(suit_context_t * ctx, size_t idx)
+{
+    return &ctx->params[ctx->components[idx].params];
+}
+
 size_t suit_get_version(suit_context_t * ctx) 
 {
     return ctx->version;
@@ -383,9 +990,41 @@ bool suit_must_run(suit_context_t * ctx, size_t idx)
     return ctx->components[idx].run;
 }
 
+bool suit_must_swap(suit_context_t * ctx, size_t idx)
+{
+    return ctx->components[idx].swap;
+}
+
+bool suit_must_wait(suit_context_t * ctx, size_t idx)
+{
+    return ctx->components[idx].wait;
+}
+
+int32_t suit_get_priority(suit_context_t * ctx, size_t idx)
+{
+    return _suit_params(ctx, idx)->priority;
+}
+
+uint32_t suit_get_min_battery(suit_context_t * ctx, size_t idx)
+{
+    return _suit_params(ctx, idx)->min_battery;
+}
+
+bool suit_has_wait_info(suit_context_t * ctx, size_t idx)
+{
+    return _suit_params(ctx, idx)->wait_info != NULL;
+}
+
+void suit_get_wait_info(suit_context_t * ctx, size_t idx,
+        const uint8_t ** wait_info, size_t * len_wait_info)
+{
+    *wait_info = _suit_params(ctx, idx)->wait_info;
+    *len_wait_info = _suit_params(ctx, idx)->len_wait_info;
+}
+
 size_t suit_get_size(suit_context_t * ctx, size_t idx)
 {
-    return ctx->components[idx].size;
+    return _suit_params(ctx, idx)->size;
 }
 
 bool suit_has_size(suit_context_t * ctx, size_t idx)
@@ -395,78 +1034,159 @@ bool suit_has_size(suit_context_t * ctx, size_t idx)
 
 suit_digest_alg_t suit_get_digest_alg(suit_context_t * ctx, size_t idx)
 {
-    return ctx->components[idx].digest_alg;
+    return _suit_params(ctx, idx)->digest_alg;
 }
 
 bool suit_has_digest(suit_context_t * ctx, size_t idx)
 {
     return (suit_get_digest_alg(ctx, idx) != 0 &&
-            ctx->components[idx].digest != NULL);
+            _suit_params(ctx, idx)->digest != NULL);
 }
 
 bool suit_digest_is_match(suit_context_t * ctx, size_t idx,
         const uint8_t * digest, size_t len_digest)
 {
+    suit_params_t * params = _suit_params(ctx, idx);
     if (suit_has_digest(ctx, idx))
-        if (len_digest == ctx->components[idx].len_digest)
-            if (!memcmp(digest, ctx->components[idx].digest, len_digest))
+        if (len_digest == params->len_digest)
+            if (!memcmp(digest, params->digest, len_digest))
                 return true;
     return false;
 }
 
 suit_archive_alg_t suit_get_archive_alg(suit_context_t * ctx, size_t idx)
 {
-    return ctx->components[idx].archive_alg;
+    return _suit_params(ctx, idx)->archive_alg;
 }
 
 bool suit_has_uri(suit_context_t * ctx, size_t idx)
 {
-    return (ctx->components[idx].uri != NULL);
+    return (_suit_params(ctx, idx)->uri != NULL);
 }
 
 void suit_get_uri(suit_context_t * ctx, size_t idx,
         const uint8_t ** uri, size_t * len_uri)
 {
-    *uri = ctx->components[idx].uri;
-    *len_uri = ctx->components[idx].len_uri;
+    suit_params_t * params = _suit_params(ctx, idx);
+    *uri = params->uri;
+    *len_uri = params->len_uri;
+}
+
+size_t suit_get_uri_alt_count(suit_context_t * ctx, size_t idx)
+{
+    return _suit_params(ctx, idx)->uri_alt_count;
+}
+
+void suit_get_uri_alt(suit_context_t * ctx, size_t idx, size_t alt,
+        const uint8_t ** uri, size_t * len_uri)
+{
+    suit_params_t * params = _suit_params(ctx, idx);
+    *uri = params->uri_alts[alt];
+    *len_uri = params->len_uri_alts[alt];
+}
+
+bool suit_has_block_digest(suit_context_t * ctx, size_t idx)
+{
+    return (_suit_params(ctx, idx)->block_root != NULL);
+}
+
+void suit_get_block_digest(suit_context_t * ctx, size_t idx,
+        size_t * block_size, suit_digest_alg_t * alg,
+        const uint8_t ** root, size_t * len_root)
+{
+    suit_params_t * params = _suit_params(ctx, idx);
+    *block_size = params->block_size;
+    *alg = params->block_digest_alg;
+    *root = params->block_root;
+    *len_root = params->len_block_root;
+}
+
+bool suit_has_payload(suit_context_t * ctx, size_t idx)
+{
+    return (_suit_params(ctx, idx)->payload != NULL);
+}
+
+void suit_get_payload(suit_context_t * ctx, size_t idx,
+        const uint8_t ** payload, size_t * len_payload)
+{
+    suit_params_t * params = _suit_params(ctx, idx);
+    *payload = params->payload;
+    *len_payload = params->len_payload;
 }
 
 bool suit_has_class_id(suit_context_t * ctx, size_t idx)
 {
-    return (ctx->components[idx].class_id != NULL);
+    return (_suit_params(ctx, idx)->class_id != NULL);
 }
 
 bool suit_class_id_is_match(suit_context_t * ctx, size_t idx,
         const uint8_t * class_id, size_t len_class_id)
 {
+    suit_params_t * params = _suit_params(ctx, idx);
     if (suit_has_class_id(ctx, idx))
-        if (len_class_id == ctx->components[idx].len_class_id)
-            if (!memcmp(class_id, ctx->components[idx].class_id, len_class_id))
+        if (len_class_id == params->len_class_id)
+            if (!memcmp(class_id, params->class_id, len_class_id))
                 return true;
     return false;
 }
 
 bool suit_has_vendor_id(suit_context_t * ctx, size_t idx)
 {
-    return (ctx->components[idx].vendor_id != NULL);
+    return (_suit_params(ctx, idx)->vendor_id != NULL);
 }
 
 bool suit_vendor_id_is_match(suit_context_t * ctx, size_t idx,
         const uint8_t * vendor_id, size_t len_vendor_id)
 {
+    suit_params_t * params = _suit_params(ctx, idx);
     if (suit_has_vendor_id(ctx, idx))
-        if (len_vendor_id == ctx->components[idx].len_vendor_id)
-            if (!memcmp(vendor_id, ctx->components[idx].vendor_id, len_vendor_id))
+        if (len_vendor_id == params->len_vendor_id)
+            if (!memcmp(vendor_id, params->vendor_id, len_vendor_id))
+                return true;
+    return false;
+}
+
+bool suit_has_device_id(suit_context_t * ctx, size_t idx)
+{
+    return (_suit_params(ctx, idx)->device_id != NULL);
+}
+
+bool suit_device_id_is_match(suit_context_t * ctx, size_t idx,
+        const uint8_t * device_id, size_t len_device_id)
+{
+    suit_params_t * params = _suit_params(ctx, idx);
+    if (suit_has_device_id(ctx, idx))
+        if (len_device_id == params->len_device_id)
+            if (!memcmp(device_id, params->device_id, len_device_id))
                 return true;
     return false;
 }
 
 bool suit_has_source_component(suit_context_t * ctx, size_t idx)
 {
-    return (ctx->components[idx].source != NULL);
+    return (_suit_params(ctx, idx)->source != NULL);
 }
 
 suit_component_t * suit_get_source_component(suit_context_t * ctx, size_t idx)
 {
-    return ctx->components[idx].source;
+    return _suit_params(ctx, idx)->source;
+}
+
+size_t suit_get_dependency_count(suit_context_t * ctx)
+{
+    return ctx->dependency_count;
+}
+
+bool suit_must_process_dependency(suit_context_t * ctx, size_t idx)
+{
+    return ctx->dependencies[idx].process;
+}
+
+bool suit_dependency_digest_is_match(suit_context_t * ctx, size_t idx,
+        const uint8_t * digest, size_t len_digest)
+{
+    if (len_digest == ctx->dependencies[idx].len_digest)
+        if (!memcmp(digest, ctx->dependencies[idx].digest, len_digest))
+            return true;
+    return false;
 }
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/suit.h>
+#include <mbedtls/sha256.h>
+
+/*
+ * Integrated payloads are carried in the envelope map under a text 
+ * key, such as "#image", that components use as their URI. They are
+ * returned as views into the envelope. The envelope itself is not 
+ * authenticated beyond the manifest, so every payload is checked 
+ * against the digest in the (authenticated) manifest before use. 
+ * Components sharing a parameter block are resolved once.
+ */
+
+#define SUIT_PAYLOAD_DIGEST_SIZE 32 /* SHA-256 */
+
+/* finds the envelope entry with the given text key */
+int _suit_envelope_find(const uint8_t * env, size_t len_env,
+        const uint8_t * key, size_t len_key,
+        const uint8_t ** pld, size_t * len_pld)
+{
+    nanocbor_value_t nc, map;
+    nanocbor_decoder_init(&nc, env, len_env);
+    if (nanocbor_enter_map(&nc, &map) < 0) return 1;
+
+    const uint8_t * str; size_t len_str;
+    while (!nanocbor_at_end(&map)) {
+        if (nanocbor_get_type(&map) == NANOCBOR_TYPE_TSTR) {
+            if (nanocbor_get_tstr(&map, &str, &len_str) < 0) return 1;
+            if (len_str == len_key && !memcmp(str, key, len_key))
+                return nanocbor_get_bstr(&map, pld, len_pld) < 0;
+        } else if (nanocbor_skip(&map) < 0) return 1;
+        if (nanocbor_skip(&map) < 0) return 1;
+    }
+    return 1;
+}
+
+int suit_resolve_payloads(suit_context_t * ctx,
+        const uint8_t * env, size_t len_env)
+{
+    uint8_t hash[SUIT_PAYLOAD_DIGEST_SIZE];
+    const uint8_t * pld; size_t len_pld;
+    for (size_t i = 0; i < SUIT_MAX_PARAM_BLOCKS; i++) {
+        suit_params_t * params = &ctx->params[i];
+        params->payload = NULL;
+        params->len_payload = 0;
+        if (params->refs == 0 || params->uri == NULL) continue;
+        if (params->len_uri == 0 || params->uri[0] != '#') continue;
+
+        if (params->digest_alg != suit_digest_alg_sha256) return 1;
+        if (params->len_digest != sizeof(hash)) return 1;
+        if (_suit_envelope_find(env, len_env, 
+                    params->uri, params->len_uri, &pld, &len_pld))
+            return 1;
+        if (params->size != 0 && params->size != len_pld) return 1;
+
+        mbedtls_sha256_ret(pld, len_pld, hash, 0);
+        if (memcmp(hash, params->digest, sizeof(hash))) return 1;
+        params->payload = pld;
+        params->len_payload = len_pld;
+    }
+    return 0;
+}
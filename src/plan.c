@@ -0,0 +1,344 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/plan.h>
+#include <sys/byteorder.h>
+#include <mbedtls/md.h>
+
+/*
+ * Header: magic (4), format version (1), reserved (1), component 
+ * count (2), step count (2), pool size (2), sequence number (4).
+ *
+ * Step: step (1), algorithm (1), component (2), image size (4), pool
+ * offset (2) and length (2) of the step's string. Copy and swap steps
+ * have no string and keep the source component in the offset field.
+ *
+ * Tag: HMAC-SHA256 of header, steps and pool.
+ */
+#define SUIT_PLAN_VERSION 1
+
+typedef struct {
+    uint8_t step, alg;
+    uint16_t idx;
+    uint32_t size;
+    uint16_t off, len;
+} _suit_step_t;
+
+/* defined in identity.c */
+uint32_t _suit_uuid_is_listed(const uint8_t * id, size_t len_id,
+        const uint8_t * table, size_t count);
+
+/* defined in auth.c */
+bool _suit_equal_ct(const uint8_t * a, const uint8_t * b, size_t len);
+
+int _suit_plan_tag(const uint8_t * key, size_t len_key,
+        const uint8_t * plan, size_t len, uint8_t * tag)
+{
+    if (!key || !len_key) return 1;
+    return mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+            key, len_key, plan, len, tag) != 0;
+}
+
+/* adds a string to the pool, reusing an identical one already in it */
+int _suit_plan_add_str(uint8_t * pool, size_t * len_pool, size_t size,
+        const uint8_t * str, size_t len_str, uint16_t * off)
+{
+    for (size_t i = 0; i + len_str <= *len_pool; i++) {
+        if (!memcmp(pool + i, str, len_str)) {
+            *off = i; return 0;
+        }
+    }
+    if (*len_pool + len_str > size || *len_pool + len_str > UINT16_MAX)
+        return 1;
+    memcpy(pool + *len_pool, str, len_str);
+    *off = *len_pool;
+    *len_pool += len_str;
+    return 0;
+}
+
+void _suit_plan_put_step(uint8_t * out, const _suit_step_t * step)
+{
+    out[0] = step->step;
+    out[1] = step->alg;
+    sys_put_le16(step->idx, out + 2);
+    sys_put_le32(step->size, out + 4);
+    sys_put_le16(step->off, out + 8);
+    sys_put_le16(step->len, out + 10);
+}
+
+void _suit_plan_get_step(const uint8_t * in, _suit_step_t * step)
+{
+    step->step = in[0];
+    step->alg = in[1];
+    step->idx = sys_get_le16(in + 2);
+    step->size = sys_get_le32(in + 4);
+    step->off = sys_get_le16(in + 8);
+    step->len = sys_get_le16(in + 10);
+}
+
+/*
+ * Steps are emitted phase by phase across all components, as SUIT
+ * orders its sequences: every identity is checked before any image is
+ * touched, and every image is fetched before one is copied from it.
+ */
+typedef enum {
+    suit_phase_identity,
+    suit_phase_fetch,
+    suit_phase_copy,
+    suit_phase_digest,
+    suit_phase_run,
+    suit_phase_count,
+} _suit_phase_t;
+
+/* 
+ * Lists the steps of a component in one phase; returns how many there
+ * are. Strings are referenced from the parameter block until they are
+ * pooled.
+ */
+size_t _suit_plan_steps(suit_context_t * ctx, size_t idx, 
+        _suit_phase_t phase, _suit_step_t * steps, 
+        const uint8_t ** strs, size_t * lens)
+{
+    const suit_params_t * params = &ctx->params[ctx->components[idx].params];
+    size_t n = 0;
+    _suit_step_t nil = { .idx = idx, .size = params->size };
+
+#define SUIT_PLAN_STEP(s, a, str, len) do { \
+        steps[n] = nil; steps[n].step = s; steps[n].alg = a; \
+        strs[n] = str; lens[n] = len; n++; \
+    } while (0)
+
+    switch (phase) {
+
+        case suit_phase_identity:
+            if (params->vendor_id)
+                SUIT_PLAN_STEP(suit_step_check_vendor_id, 0, 
+                        params->vendor_id, params->len_vendor_id);
+            if (params->class_id)
+                SUIT_PLAN_STEP(suit_step_check_class_id, 0, 
+                        params->class_id, params->len_class_id);
+            if (params->device_id)
+                SUIT_PLAN_STEP(suit_step_check_device_id, 0, 
+                        params->device_id, params->len_device_id);
+            break;
+
+        case suit_phase_fetch:
+            if (params->uri)
+                SUIT_PLAN_STEP(suit_step_fetch, params->archive_alg, 
+                        params->uri, params->len_uri);
+            break;
+
+        case suit_phase_copy:
+            if (params->source) {
+                SUIT_PLAN_STEP(ctx->components[idx].swap ? suit_step_swap 
+                        : suit_step_copy, 0, NULL, 0);
+                steps[n - 1].off = params->source - ctx->components;
+            }
+            break;
+
+        case suit_phase_digest:
+            if (suit_has_digest(ctx, idx))
+                SUIT_PLAN_STEP(suit_step_check_digest, params->digest_alg, 
+                        params->digest, params->len_digest);
+            break;
+
+        case suit_phase_run:
+            if (ctx->components[idx].run)
+                SUIT_PLAN_STEP(suit_step_run, 0, NULL, 0);
+            break;
+
+        default: break;
+
+    }
+
+#undef SUIT_PLAN_STEP
+    return n;
+}
+
+#define SUIT_PLAN_MAX_STEPS 3 /* per component and phase */
+
+int suit_plan_compile(suit_context_t * ctx,
+        const uint8_t * key, size_t len_key,
+        uint8_t * plan, size_t * len_plan)
+{
+    _suit_step_t steps[SUIT_PLAN_MAX_STEPS];
+    const uint8_t * strs[SUIT_PLAN_MAX_STEPS];
+    size_t lens[SUIT_PLAN_MAX_STEPS];
+
+    /* the pool follows the steps, so count them first */
+    size_t step_count = 0;
+    for (_suit_phase_t ph = 0; ph < suit_phase_count; ph++)
+        for (size_t idx = 0; idx < ctx->component_count; idx++)
+            step_count += _suit_plan_steps(ctx, idx, ph, 
+                    steps, strs, lens);
+    size_t len_steps = SUIT_PLAN_HDR_SIZE 
+        + step_count * SUIT_PLAN_STEP_SIZE;
+    if (step_count > UINT16_MAX 
+            || len_steps + SUIT_PLAN_TAG_SIZE > *len_plan) 
+        return 1;
+
+    uint8_t * pool = plan + len_steps;
+    size_t len_pool = 0;
+    uint8_t * out = plan + SUIT_PLAN_HDR_SIZE;
+    for (_suit_phase_t ph = 0; ph < suit_phase_count; ph++) {
+        for (size_t idx = 0; idx < ctx->component_count; idx++) {
+            size_t n = _suit_plan_steps(ctx, idx, ph, steps, strs, lens);
+            for (size_t i = 0; i < n; i++) {
+                if (strs[i]) {
+                    if (_suit_plan_add_str(pool, &len_pool, 
+                                *len_plan - len_steps - SUIT_PLAN_TAG_SIZE,
+                                strs[i], lens[i], 
+                                &steps[i].off))
+                        return 1;
+                    steps[i].len = lens[i];
+                }
+                _suit_plan_put_step(out, &steps[i]);
+                out += SUIT_PLAN_STEP_SIZE;
+            }
+        }
+    }
+
+    sys_put_le32(SUIT_PLAN_MAGIC, plan);
+    plan[4] = SUIT_PLAN_VERSION;
+    plan[5] = 0;
+    sys_put_le16(ctx->component_count, plan + 6);
+    sys_put_le16(step_count, plan + 8);
+    sys_put_le16(len_pool, plan + 10);
+    sys_put_le32(ctx->sequence_number, plan + 12);
+    if (_suit_plan_tag(key, len_key, plan, len_steps + len_pool,
+                plan + len_steps + len_pool))
+        return 1;
+    *len_plan = len_steps + len_pool + SUIT_PLAN_TAG_SIZE;
+    return 0;
+}
+
+/* checks the tag, the header and every step; returns the step count */
+int _suit_plan_check(const uint8_t * plan, size_t len_plan,
+        const uint8_t * key, size_t len_key, size_t * step_count)
+{
+    uint8_t tag[SUIT_PLAN_TAG_SIZE];
+    if (len_plan < SUIT_PLAN_HDR_SIZE + SUIT_PLAN_TAG_SIZE) return 1;
+    len_plan -= SUIT_PLAN_TAG_SIZE;
+    if (_suit_plan_tag(key, len_key, plan, len_plan, tag)
+            || !_suit_equal_ct(tag, plan + len_plan, sizeof(tag)))
+        return 1;
+
+    if (sys_get_le32(plan) != SUIT_PLAN_MAGIC) return 1;
+    if (plan[4] != SUIT_PLAN_VERSION) return 1;
+    size_t comp_count = sys_get_le16(plan + 6);
+    *step_count = sys_get_le16(plan + 8);
+    size_t len_pool = sys_get_le16(plan + 10);
+    if (len_plan != SUIT_PLAN_HDR_SIZE 
+            + *step_count * SUIT_PLAN_STEP_SIZE + len_pool)
+        return 1;
+
+    _suit_step_t step;
+    const uint8_t * in = plan + SUIT_PLAN_HDR_SIZE;
+    for (size_t i = 0; i < *step_count; i++) {
+        _suit_plan_get_step(in + i * SUIT_PLAN_STEP_SIZE, &step);
+        if (step.idx >= comp_count) return 1;
+        if (step.step == suit_step_copy || step.step == suit_step_swap) {
+            if (step.off >= comp_count) return 1;
+        } else if ((size_t) step.off + step.len > len_pool) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int suit_plan_execute(const uint8_t * plan, size_t len_plan,
+        const uint8_t * key, size_t len_key,
+        const suit_plan_handler_t * handler)
+{
+    size_t step_count;
+    if (_suit_plan_check(plan, len_plan, key, len_key, &step_count))
+        return 1;
+    
+    const suit_identity_t * id = handler->id;
+    const uint8_t * in = plan + SUIT_PLAN_HDR_SIZE;
+    const uint8_t * pool = in + step_count * SUIT_PLAN_STEP_SIZE;
+    _suit_step_t step;
+    for (size_t i = 0; i < step_count; i++) {
+        _suit_plan_get_step(in + i * SUIT_PLAN_STEP_SIZE, &step);
+        const uint8_t * str = pool + step.off;
+        switch (step.step) {
+
+            case suit_step_check_vendor_id:
+                if (!id || !_suit_uuid_is_listed(str, step.len,
+                            id->vendor_ids, id->vendor_id_count))
+                    return 1;
+                break;
+
+            case suit_step_check_class_id:
+                if (!id || !_suit_uuid_is_listed(str, step.len,
+                            id->class_ids, id->class_id_count))
+                    return 1;
+                break;
+
+            case suit_step_check_device_id:
+                if (!id || !_suit_uuid_is_listed(str, step.len,
+                            id->device_ids, id->device_id_count))
+                    return 1;
+                break;
+
+            case suit_step_fetch:
+                if (!handler->fetch || handler->fetch(handler->arg, 
+                            step.idx, str, step.len, step.size, step.alg))
+                    return 1;
+                break;
+
+            case suit_step_copy:
+                if (!handler->copy || handler->copy(handler->arg, 
+                            step.idx, step.off, step.size))
+                    return 1;
+                break;
+
+            case suit_step_swap:
+                if (!handler->swap || handler->swap(handler->arg, 
+                            step.idx, step.off, step.size))
+                    return 1;
+                break;
+
+            case suit_step_check_digest:
+                if (!handler->check_digest || handler->check_digest(
+                            handler->arg, step.idx, step.alg, 
+                            str, step.len, step.size))
+                    return 1;
+                break;
+
+            case suit_step_run:
+                if (!handler->run || handler->run(handler->arg, step.idx))
+                    return 1;
+                break;
+
+            /* FAIL if unsupported */
+            default: return 1;
+
+        }
+    }
+    return 0;
+}
+
+int suit_plan_sequence_number(const uint8_t * plan, size_t len_plan,
+        const uint8_t * key, size_t len_key, size_t * seq_num)
+{
+    size_t step_count;
+    if (_suit_plan_check(plan, len_plan, key, len_key, &step_count))
+        return 1;
+    *seq_num = sys_get_le32(plan + 12);
+    return 0;
+}
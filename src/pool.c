@@ -0,0 +1,108 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "pool.h"
+
+/*
+ * Workers are started per call and claim items from a shared counter,
+ * so uneven jobs balance themselves. With no workers configured, all
+ * items run in order on the calling thread.
+ */
+
+typedef struct {
+    _suit_job_t job;
+    void * arg;
+    size_t n;
+    atomic_t next;
+    atomic_t stop;
+} _suit_pool_t;
+
+#if CONFIG_ZOOT_WORKER_THREADS > 0
+K_THREAD_STACK_ARRAY_DEFINE(_suit_pool_stacks, 
+        CONFIG_ZOOT_WORKER_THREADS, CONFIG_ZOOT_WORKER_STACK_SIZE);
+struct k_thread _suit_pool_threads[CONFIG_ZOOT_WORKER_THREADS];
+K_SEM_DEFINE(_suit_pool_lock, 1, 1);
+k_tid_t _suit_pool_caller;  /* thread the workers run for */
+#endif
+
+void _suit_pool_run(_suit_pool_t * pool)
+{
+    while (!atomic_get(&pool->stop)) {
+        size_t idx = atomic_inc(&pool->next);
+        if (idx >= pool->n) break;
+        if (pool->job(pool->arg, idx)) atomic_set(&pool->stop, 1);
+    }
+}
+
+#if CONFIG_ZOOT_WORKER_THREADS > 0
+void _suit_pool_entry(void * pool, void * unused1, void * unused2)
+{
+    _suit_pool_run(pool);
+}
+#endif
+
+int _suit_parallel_for(size_t n, size_t threads, 
+        _suit_job_t job, void * arg)
+{
+    _suit_pool_t pool = { .job = job, .arg = arg, .n = n };
+    atomic_set(&pool.next, 0);
+    atomic_set(&pool.stop, 0);
+
+#if CONFIG_ZOOT_WORKER_THREADS > 0
+    /* 
+     * The caller counts as one thread. Workers are joined before the
+     * pool is released, so their threads are never reused while they
+     * are still exiting.
+     */
+    size_t workers = (threads == 0) ? CONFIG_ZOOT_WORKER_THREADS : 
+        MIN(threads - 1, CONFIG_ZOOT_WORKER_THREADS);
+    workers = MIN(workers, n > 0 ? n - 1 : 0);
+    if (workers > 0 && k_sem_take(&_suit_pool_lock, K_NO_WAIT)) 
+        workers = 0;
+
+    if (workers > 0) _suit_pool_caller = k_current_get();
+    int prio = k_thread_priority_get(k_current_get());
+    for (size_t i = 0; i < workers; i++)
+        k_thread_create(&_suit_pool_threads[i], _suit_pool_stacks[i],
+                K_THREAD_STACK_SIZEOF(_suit_pool_stacks[i]),
+                _suit_pool_entry, &pool, NULL, NULL, prio, 0, K_NO_WAIT);
+#endif
+
+    _suit_pool_run(&pool);
+
+#if CONFIG_ZOOT_WORKER_THREADS > 0
+    for (size_t i = 0; i < workers; i++)
+        k_thread_join(&_suit_pool_threads[i], K_FOREVER);
+    if (workers > 0) {
+        _suit_pool_caller = NULL;
+        k_sem_give(&_suit_pool_lock);
+    }
+#endif
+
+    return atomic_get(&pool.stop);
+}
+
+bool _suit_pool_is_worker_of(k_tid_t caller)
+{
+#if CONFIG_ZOOT_WORKER_THREADS > 0
+    k_tid_t self = k_current_get();
+    for (size_t i = 0; i < CONFIG_ZOOT_WORKER_THREADS; i++)
+        if (self == &_suit_pool_threads[i]) 
+            return _suit_pool_caller == caller;
+#endif
+    return false;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_POOL_H
+#define SUIT_POOL_H
+
+#include <zephyr.h>
+
+/*
+ * A job processes item idx. Returning nonzero stops the pool: items
+ * that have not been started yet are never run.
+ */
+typedef int (*_suit_job_t)(void * arg, size_t idx);
+
+/*
+ * Runs job(arg, idx) for every idx below n on the calling thread and
+ * on up to threads - 1 of the CONFIG_ZOOT_WORKER_THREADS workers (all
+ * of them if threads is 0). The pool is shared; a call made while it
+ * is busy, including one from within a job, runs on the calling
+ * thread alone.
+ *
+ * Returns 1 if a job stopped the pool, otherwise 0.
+ */
+int _suit_parallel_for(size_t n, size_t threads, 
+        _suit_job_t job, void * arg);
+
+/* Returns true if the calling thread is a worker running a job for caller. */
+bool _suit_pool_is_worker_of(k_tid_t caller);
+
+#endif /* SUIT_POOL_H */
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/schedule.h>
+
+/*
+ * Wait events are a byte-string wrapped map from event to argument.
+ * They stay in the manifest and are decoded every time they are 
+ * evaluated, so a queued manifest costs no more than its entry. With
+ * met NULL, the events are only checked to be well-formed and known
+ * to the environment.
+ */
+int _suit_sched_events(const suit_sched_env_t * env,
+        const uint8_t * info, size_t len_info, bool * met)
+{
+    nanocbor_value_t top, map, arr;
+    const uint8_t * dev, * ver; size_t len_dev;
+    uint32_t event, val; int32_t level;
+    bool pass = true;
+
+    nanocbor_decoder_init(&top, info, len_info);
+    if (nanocbor_enter_map(&top, &map) < 0) return 1;
+    while (!nanocbor_at_end(&map)) {
+        if (nanocbor_get_uint32(&map, &event) < 0) return 1;
+        switch (event) {
+
+            case suit_wait_authorization:
+            case suit_wait_power:
+            case suit_wait_network:
+                if (env->level == NULL 
+                        || nanocbor_get_int32(&map, &level) < 0)
+                    return 1;
+                if (met) pass &= env->level(env->arg, event) >= level;
+                break;
+
+            /* [device, [+ version match]] */
+            case suit_wait_other_device_version:
+                if (env->other_device == NULL
+                        || nanocbor_enter_array(&map, &arr) < 0
+                        || nanocbor_get_bstr(&arr, &dev, &len_dev) < 0)
+                    return 1;
+                ver = arr.cur;
+                if (nanocbor_skip(&arr) < 0) return 1;
+                if (met) pass &= env->other_device(env->arg, 
+                        dev, len_dev, ver, arr.cur - ver);
+                nanocbor_leave_container(&map, &arr);
+                break;
+
+            /* a timestamp, then a time of day opening a window */
+            case suit_wait_time:
+            case suit_wait_time_of_day:
+            case suit_wait_day_of_week:
+                if (env->now == NULL 
+                        || nanocbor_get_uint32(&map, &val) < 0)
+                    return 1;
+                if (met == NULL) break;
+                uint32_t now = env->now(env->arg);
+                uint32_t tod = now % SUIT_SCHED_DAY;
+                if (event == suit_wait_time) 
+                    pass &= now >= val;
+                else if (event == suit_wait_time_of_day && env->window)
+                    pass &= (tod + SUIT_SCHED_DAY - val) % SUIT_SCHED_DAY
+                        < env->window;
+                else if (event == suit_wait_time_of_day)
+                    pass &= tod >= val;
+                else /* 1970-01-01 was a Thursday */
+                    pass &= (now / SUIT_SCHED_DAY + 4) % 7 == val;
+                break;
+
+            /* FAIL if unsupported */
+            default: return 1;
+
+        }
+    }
+    if (met) *met = pass;
+    return 0;
+}
+
+/* evaluates the wait events of a component, or checks them if met is NULL */
+int _suit_sched_component(const suit_sched_env_t * env,
+        suit_context_t * ctx, size_t idx, bool * met)
+{
+    const uint8_t * info; size_t len_info;
+    uint32_t battery = suit_get_min_battery(ctx, idx);
+    if (met) *met = true;
+    if (battery) {
+        if (env->battery == NULL) return 1;
+        if (met && env->battery(env->arg) < battery) *met = false;
+    }
+    if (!suit_must_wait(ctx, idx) || !suit_has_wait_info(ctx, idx)) 
+        return 0;
+    if (met && !*met) return 0;
+    suit_get_wait_info(ctx, idx, &info, &len_info);
+    return _suit_sched_events(env, info, len_info, met);
+}
+
+int32_t _suit_sched_priority(suit_context_t * ctx)
+{
+    int32_t priority = INT32_MAX;
+    for (size_t i = 0; i < suit_get_component_count(ctx); i++)
+        priority = MIN(priority, suit_get_priority(ctx, i));
+    return priority == INT32_MAX ? 0 : priority;
+}
+
+void suit_sched_init(suit_scheduler_t * s, const suit_sched_env_t * env)
+{
+    memset(s, 0, sizeof(*s));
+    s->env = env;
+}
+
+int suit_sched_add(suit_scheduler_t * s, suit_context_t * ctx, void * arg)
+{
+    if (s->count == SUIT_SCHED_MAX_PENDING) return 1;
+    for (size_t i = 0; i < suit_get_component_count(ctx); i++)
+        if (_suit_sched_component(s->env, ctx, i, NULL)) return 1;
+
+    /* after every entry at least as urgent */
+    int32_t priority = _suit_sched_priority(ctx);
+    size_t pos = s->count;
+    while (pos > 0 && s->entries[pos - 1].priority > priority) {
+        s->entries[pos] = s->entries[pos - 1];
+        pos--;
+    }
+    s->entries[pos].ctx = ctx;
+    s->entries[pos].arg = arg;
+    s->entries[pos].priority = priority;
+    s->count++;
+    return 0;
+}
+
+bool suit_sched_is_ready(const suit_scheduler_t * s, suit_context_t * ctx)
+{
+    bool met;
+    for (size_t i = 0; i < suit_get_component_count(ctx); i++)
+        if (_suit_sched_component(s->env, ctx, i, &met) || !met)
+            return false;
+
+    /* system-critical updates do not wait for the device to be idle */
+    if (_suit_sched_priority(ctx) < 0 || s->env->idle == NULL) 
+        return true;
+    return s->env->idle(s->env->arg);
+}
+
+int suit_sched_next(suit_scheduler_t * s, 
+        suit_context_t ** ctx, void ** arg)
+{
+    for (size_t i = 0; i < s->count; i++) {
+        if (!suit_sched_is_ready(s, s->entries[i].ctx)) continue;
+        *ctx = s->entries[i].ctx;
+        *arg = s->entries[i].arg;
+        memmove(&s->entries[i], &s->entries[i + 1],
+                (s->count - i - 1) * sizeof(s->entries[0]));
+        s->count--;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/storage.h>
+#include <mbedtls/sha256.h>
+
+/* bytes read at a time through the CPU */
+#define SUIT_STORAGE_BUF_SIZE 256
+
+/* reads len bytes of idx at offset and adds them to the hash, if any */
+int _suit_storage_hash(const suit_storage_t * st, size_t idx, 
+        size_t offset, size_t len, mbedtls_sha256_context * sha)
+{
+    uint8_t buf[SUIT_STORAGE_BUF_SIZE];
+    for (size_t off = 0; off < len; off += sizeof(buf)) {
+        size_t n = MIN(sizeof(buf), len - off);
+        if (st->read(st->arg, idx, offset + off, buf, n)) return 1;
+        if (sha) mbedtls_sha256_update_ret(sha, buf, n);
+    }
+    return 0;
+}
+
+/* copies len bytes at offset through a buffer */
+int _suit_storage_copy(const suit_storage_t * st, size_t dst, size_t src,
+        size_t offset, size_t len)
+{
+    uint8_t buf[SUIT_STORAGE_BUF_SIZE];
+    for (size_t off = 0; off < len; off += sizeof(buf)) {
+        size_t n = MIN(sizeof(buf), len - off);
+        if (st->read(st->arg, src, offset + off, buf, n)) return 1;
+        if (st->write(st->arg, dst, offset + off, buf, n)) return 1;
+    }
+    return 0;
+}
+
+/* 
+ * Transfers len bytes at offset. Meanwhile, the prev bytes of dst 
+ * before offset, which the last transfer wrote, are hashed.
+ */
+int _suit_storage_transfer(const suit_storage_t * st, size_t dst, 
+        size_t src, size_t offset, size_t len, size_t prev,
+        mbedtls_sha256_context * sha)
+{
+    if (st->transfer(st->arg, dst, offset, src, offset, len)) return 1;
+    int err = sha ? _suit_storage_hash(st, dst, offset - prev, prev, sha)
+        : 0;
+    return st->wait(st->arg) || err;
+}
+
+/* 
+ * The hash is made from what dst holds once each chunk is written, 
+ * so that it also covers the transfer.
+ */
+int _suit_storage_copy_all(const suit_storage_t * st, size_t dst, 
+        size_t src, size_t size, mbedtls_sha256_context * sha)
+{
+    bool async = st->transfer && st->wait;
+    size_t chunk = st->chunk_size ? st->chunk_size : st->sector_size;
+    if (st->sector_size == 0 || chunk % st->sector_size) return 1;
+
+    if (st->remap && !st->remap(st->arg, dst, src, size))
+        return sha ? _suit_storage_hash(st, dst, 0, size, sha) : 0;
+
+    size_t prev = 0;
+    for (size_t off = 0; off < size; off += chunk) {
+        size_t len = MIN(chunk, size - off);
+        for (size_t s = 0; s < len; s += st->sector_size)
+            if (st->erase(st->arg, dst, off + s)) return 1;
+        if (async) {
+            if (_suit_storage_transfer(st, dst, src, off, len, prev, sha))
+                return 1;
+            prev = len;
+        } else if (_suit_storage_copy(st, dst, src, off, len)
+                || (sha && _suit_storage_hash(st, dst, off, len, sha))) {
+            return 1;
+        }
+    }
+    return sha && prev ? _suit_storage_hash(st, dst, size - prev, prev, sha)
+        : 0;
+}
+
+int suit_copy(const suit_storage_t * st, size_t dst, size_t src,
+        size_t size, uint8_t hash[SUIT_COPY_DIGEST_SIZE])
+{
+    if (dst == src) return 1;
+    if (hash == NULL) 
+        return _suit_storage_copy_all(st, dst, src, size, NULL);
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    int err = _suit_storage_copy_all(st, dst, src, size, &sha);
+    if (!err) mbedtls_sha256_finish_ret(&sha, hash);
+    mbedtls_sha256_free(&sha);
+    return err;
+}
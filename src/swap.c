@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/swap.h>
+
+/* bytes copied at a time */
+#define SUIT_SWAP_CHUNK 256
+
+/* erases sector dst and copies sector src into it */
+int _suit_swap_copy(const suit_storage_t * st, 
+        size_t dst, size_t dst_off, size_t src, size_t src_off)
+{
+    uint8_t buf[SUIT_SWAP_CHUNK];
+    if (st->erase(st->arg, dst, dst_off)) return 1;
+    for (size_t off = 0; off < st->sector_size; off += sizeof(buf)) {
+        size_t len = MIN(sizeof(buf), st->sector_size - off);
+        if (st->read(st->arg, src, src_off + off, buf, len)) return 1;
+        if (st->write(st->arg, dst, dst_off + off, buf, len)) return 1;
+    }
+    return 0;
+}
+
+/* 
+ * Steps 0 to n - 1 move the sectors of a up by one, from the last to
+ * the first. Then steps n + 2i and n + 2i + 1 fill sector i of a and
+ * of b. Sector n of a is the spare.
+ */
+int _suit_swap_step(const suit_storage_t * st, 
+        const suit_swap_status_t * s)
+{
+    size_t n = s->sectors, ss = st->sector_size;
+    size_t i = (s->step - n) / 2;
+
+    /* sector k of a once moved up, the spare for k == n */
+    size_t k = (s->step < n) ? n - s->step : i + 1;
+    size_t idx = (k == n) ? SUIT_STORAGE_SPARE : s->a;
+    size_t off = (k == n) ? 0 : k * ss;
+
+    if (s->step < n) 
+        return _suit_swap_copy(st, idx, off, s->a, (k - 1) * ss);
+    if ((s->step - n) % 2 == 0)
+        return _suit_swap_copy(st, s->a, i * ss, s->b, i * ss);
+    return _suit_swap_copy(st, s->b, i * ss, idx, off);
+}
+
+int _suit_swap_run(const suit_storage_t * st, suit_swap_status_t * s)
+{
+    while (s->step < 3 * s->sectors) {
+        if (_suit_swap_step(st, s)) return 1;
+        s->step++;
+        if (st->save(st->arg, s)) return 1;
+    }
+    return st->save(st->arg, NULL);
+}
+
+int suit_swap(const suit_storage_t * st, size_t a, size_t b, size_t size)
+{
+    suit_swap_status_t s = { .a = a, .b = b, .step = 0 };
+    if (a == b || a > UINT16_MAX || b > UINT16_MAX) return 1;
+    if (st->sector_size == 0 || size == 0) return 1;
+    s.sectors = (size + st->sector_size - 1) / st->sector_size;
+
+    /* resume the same swap, but do not start over another one */
+    suit_swap_status_t saved;
+    if (!st->load(st->arg, &saved)) {
+        if (saved.a != s.a || saved.b != s.b || saved.sectors != s.sectors)
+            return 1;
+        s.step = saved.step;
+    } else if (st->save(st->arg, &s))
+        return 1; /* the swap starts once its status is saved */
+    return _suit_swap_run(st, &s);
+}
+
+int suit_swap_resume(const suit_storage_t * st)
+{
+    suit_swap_status_t s;
+    if (st->load(st->arg, &s)) return 0;
+    if (s.a == s.b || s.step > 3 * s.sectors) return 1;
+    return _suit_swap_run(st, &s);
+}
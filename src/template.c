@@ -0,0 +1,201 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/template.h>
+#include <nanocbor/nanocbor.h>
+
+/* defined in parse.c */
+suit_params_t * _suit_params(suit_context_t * ctx, size_t idx);
+
+/* true if [offset, offset + len) of man is exactly the string at str */
+bool _suit_template_is_str(const uint8_t * man, size_t offset, size_t len,
+        const uint8_t * str, size_t len_str)
+{
+    return str == man + offset && len_str == len;
+}
+
+bool _suit_template_is_field(const suit_context_t * ctx, 
+        const uint8_t * man, size_t offset, size_t len)
+{
+    for (size_t i = 0; i < SUIT_MAX_PARAM_BLOCKS; i++) {
+        const suit_params_t * p = &ctx->params[i];
+        if (p->refs == 0) continue;
+        if (_suit_template_is_str(man, offset, len, p->uri, p->len_uri)
+                || _suit_template_is_str(man, offset, len, 
+                    p->digest, p->len_digest)
+                || _suit_template_is_str(man, offset, len, 
+                    p->class_id, p->len_class_id)
+                || _suit_template_is_str(man, offset, len, 
+                    p->vendor_id, p->len_vendor_id)
+                || _suit_template_is_str(man, offset, len, 
+                    p->device_id, p->len_device_id)
+                || _suit_template_is_str(man, offset, len, 
+                    p->block_root, p->len_block_root))
+            return true;
+        for (size_t j = 0; j < p->uri_alt_count; j++)
+            if (_suit_template_is_str(man, offset, len,
+                        p->uri_alts[j], p->len_uri_alts[j]))
+                return true;
+    }
+    for (size_t i = 0; i < ctx->dependency_count; i++)
+        if (_suit_template_is_str(man, offset, len,
+                    ctx->dependencies[i].digest, 
+                    ctx->dependencies[i].len_digest))
+            return true;
+    return false;
+}
+
+/* decodes a uint filling exactly len bytes */
+int _suit_template_get_uint(const uint8_t * p, size_t len, size_t * val)
+{
+    nanocbor_value_t v;
+    uint32_t tmp;
+    nanocbor_decoder_init(&v, p, len);
+    if (nanocbor_get_uint32(&v, &tmp) < 0 || !nanocbor_at_end(&v)) 
+        return 1;
+    *val = tmp;
+    return 0;
+}
+
+int _suit_template_set_fields(suit_context_t * ctx, 
+        const suit_template_t * t, const uint8_t * man)
+{
+    for (size_t i = 0; i < t->field_count; i++) {
+        const suit_template_field_t * f = &t->fields[i];
+        const uint8_t * p = man + f->offset;
+        if (f->field == suit_field_seq_num) {
+            if (_suit_template_get_uint(p, f->len, 
+                        &ctx->sequence_number))
+                return 1;
+        } else if (f->field == suit_field_size) {
+            if (_suit_template_get_uint(p, f->len, 
+                        &_suit_params(ctx, f->idx)->size))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/* compares everything but the fields */
+bool _suit_template_is_match(const suit_template_t * t, 
+        const uint8_t * man, size_t len_man)
+{
+    if (len_man != t->len_man) return false;
+    size_t off = 0;
+    for (size_t i = 0; i < t->field_count; i++) {
+        const suit_template_field_t * f = &t->fields[i];
+        if (memcmp(man + off, t->man + off, f->offset - off)) 
+            return false;
+        off = f->offset + f->len;
+    }
+    return !memcmp(man + off, t->man + off, len_man - off);
+}
+
+/* moves a pointer into the template manifest to the same offset in man */
+#define SUIT_TEMPLATE_REBASE(ptr) \
+    if (ptr) ptr = (uint8_t *) man + ((ptr) - t->man)
+
+void _suit_template_rebase(suit_context_t * ctx, 
+        const suit_template_t * t, const uint8_t * man)
+{
+    for (size_t i = 0; i < SUIT_MAX_PARAM_BLOCKS; i++) {
+        suit_params_t * p = &ctx->params[i];
+        if (p->refs == 0) continue;
+        SUIT_TEMPLATE_REBASE(p->uri);
+        SUIT_TEMPLATE_REBASE(p->digest);
+        SUIT_TEMPLATE_REBASE(p->class_id);
+        SUIT_TEMPLATE_REBASE(p->vendor_id);
+        SUIT_TEMPLATE_REBASE(p->device_id);
+        SUIT_TEMPLATE_REBASE(p->block_root);
+        SUIT_TEMPLATE_REBASE(p->wait_info);
+        SUIT_TEMPLATE_REBASE(p->size_at);
+        for (size_t j = 0; j < p->uri_alt_count; j++)
+            SUIT_TEMPLATE_REBASE(p->uri_alts[j]);
+        if (p->source) 
+            p->source = ctx->components + (p->source - t->ctx.components);
+    }
+    for (size_t i = 0; i < ctx->dependency_count; i++)
+        SUIT_TEMPLATE_REBASE(ctx->dependencies[i].digest);
+    SUIT_TEMPLATE_REBASE(ctx->sequence_number_at);
+}
+
+int suit_template_init(suit_template_t * t, 
+        const uint8_t * man, size_t len_man,
+        const suit_template_field_t * fields, size_t field_count)
+{
+    if (field_count > SUIT_TEMPLATE_MAX_FIELDS) return 1;
+    if (suit_parse_init(&t->ctx, man, len_man)) return 1;
+    t->man = man;
+    t->len_man = len_man;
+    t->field_count = field_count;
+    memcpy(t->fields, fields, field_count * sizeof(*fields));
+
+    /* a field must not change how parameters are shared */
+    uint16_t refs[SUIT_MAX_PARAM_BLOCKS] = { 0 };
+    for (size_t i = 0; i < t->ctx.component_count; i++)
+        if (refs[t->ctx.components[i].params]++)
+            return 1;
+
+    size_t end = 0;
+    for (size_t i = 0; i < field_count; i++) {
+        const suit_template_field_t * f = &fields[i];
+        if (f->offset < end || f->len == 0 || f->offset > len_man 
+                || f->len > len_man - f->offset)
+            return 1;
+        end = f->offset + f->len;
+
+        /* integers must be where the parser read the value it kept */
+        size_t val;
+        const uint8_t * at;
+        switch (f->field) {
+            case suit_field_bytes:
+                if (!_suit_template_is_field(&t->ctx, man, f->offset, 
+                            f->len))
+                    return 1;
+                break;
+            case suit_field_size:
+                if (f->idx >= t->ctx.component_count) return 1;
+                at = _suit_params(&t->ctx, f->idx)->size_at;
+                if (at != man + f->offset || _suit_template_get_uint(
+                            at, f->len, &val))
+                    return 1;
+                break;
+            case suit_field_seq_num:
+                at = t->ctx.sequence_number_at;
+                if (at != man + f->offset || _suit_template_get_uint(
+                            at, f->len, &val))
+                    return 1;
+                break;
+            default: return 1;
+        }
+    }
+    return 0;
+}
+
+int suit_parse_template(suit_context_t * ctx, 
+        const suit_template_t * templates, size_t count,
+        const uint8_t * man, size_t len_man)
+{
+    for (size_t i = 0; i < count; i++) {
+        const suit_template_t * t = &templates[i];
+        if (!_suit_template_is_match(t, man, len_man)) continue;
+        *ctx = t->ctx;
+        _suit_template_rebase(ctx, t, man);
+        if (!_suit_template_set_fields(ctx, t, man)) return 0;
+    }
+    return suit_parse_init(ctx, man, len_man);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/writer.h>
+
+/* bytes of the old page compared at a time */
+#define SUIT_WRITER_CHUNK 64
+
+int suit_writer_init(suit_writer_t * w, const struct flash_area * fa,
+        size_t offset, uint8_t * page, size_t page_size)
+{
+    memset(w, 0, sizeof(*w));
+    w->fa = fa;
+    w->page = page;
+    w->page_size = page_size;
+    if (page_size == 0 || page_size % flash_area_align(fa)) return 1;
+    w->offset = offset - offset % page_size;
+    w->fill = offset - w->offset;
+    if (offset > fa->fa_size) return 1;
+    return w->fill && flash_area_read(fa, w->offset, page, w->fill);
+}
+
+/*
+ * Compares the buffered page with flash. Bytes are only programmed 
+ * from the first one that differs, rounded down to the write block; 
+ * if all of those are still erased, the page is written as it is, 
+ * otherwise it is erased first.
+ */
+int _suit_writer_commit(suit_writer_t * w)
+{
+    const struct flash_area * fa = w->fa;
+    size_t align = flash_area_align(fa);
+    size_t len = ROUND_UP(w->fill, align);
+    memset(w->page + w->fill, 0xff, len - w->fill);
+
+    uint8_t old[SUIT_WRITER_CHUNK];
+    size_t diff = len;
+    bool blank = true;
+    uint32_t start = k_cycle_get_32();
+    for (size_t off = 0; off < len; off += sizeof(old)) {
+        size_t n = MIN(sizeof(old), len - off);
+        if (flash_area_read(fa, w->offset + off, old, n)) return 1;
+        for (size_t i = 0; i < n; i++) {
+            if (diff == len && old[i] != w->page[off + i]) diff = off + i;
+            if (diff != len && old[i] != 0xff) blank = false;
+        }
+    }
+
+    w->stats.pages++;
+    if (diff == len) {
+        w->stats.pages_skipped++;
+        w->stats.cycles += k_cycle_get_32() - start;
+        return 0;
+    }
+
+    /* the bytes of the write block before diff must be blank too */
+    size_t from = ROUND_DOWN(diff, align);
+    for (size_t i = from; i < diff; i++)
+        if (w->page[i] != 0xff) blank = false;
+    if (!blank) {
+        from = 0;
+        if (flash_area_erase(fa, w->offset, w->page_size)) return 1;
+        w->stats.pages_erased++;
+    }
+    if (flash_area_write(fa, w->offset + from, w->page + from, len - from))
+        return 1;
+    w->stats.writes++;
+    w->stats.bytes_written += len - from;
+    w->stats.cycles += k_cycle_get_32() - start;
+    return 0;
+}
+
+int suit_writer_write(suit_writer_t * w, const uint8_t * data, size_t len)
+{
+    w->stats.bytes += len;
+    while (len > 0) {
+        size_t n = MIN(len, w->page_size - w->fill);
+        if (w->offset + w->fill + n > w->fa->fa_size) return 1;
+        memcpy(w->page + w->fill, data, n);
+        w->fill += n;
+        data += n; len -= n;
+        if (w->fill < w->page_size) break;
+        if (_suit_writer_commit(w)) return 1;
+        w->offset += w->page_size;
+        w->fill = 0;
+    }
+    return 0;
+}
+
+int suit_writer_flush(suit_writer_t * w)
+{
+    if (w->fill == 0) return 0;
+    return _suit_writer_commit(w);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <ztest.h>
+#include <mbedtls/platform.h>
+#include <stdlib.h>
+#ifdef CONFIG_ARCH_POSIX
+#include <time.h>
+#endif
+#include "bench.h"
+
+#define SUIT_BENCH_STACK_SIZE 8192
+#define SUIT_BENCH_ALLOCS 256
+
+/* the allocator Zoot installs, or else the C library */
+#ifdef CONFIG_ZOOT_ARENA
+extern void * _suit_arena_calloc(size_t n, size_t size);
+extern void _suit_arena_free(void * ptr);
+#define SUIT_BENCH_CALLOC _suit_arena_calloc
+#define SUIT_BENCH_FREE _suit_arena_free
+#else
+#define SUIT_BENCH_CALLOC calloc
+#define SUIT_BENCH_FREE free
+#endif
+
+uint32_t suit_bench_now(void)
+{
+#ifdef CONFIG_ARCH_POSIX
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t) t.tv_sec * 1000000000u + t.tv_nsec;
+#else
+    return k_cycle_get_32();
+#endif
+}
+
+K_THREAD_STACK_DEFINE(suit_bench_stack_area, SUIT_BENCH_STACK_SIZE);
+struct k_thread suit_bench_thread;
+K_SEM_DEFINE(suit_bench_done, 0, 1);
+
+void _suit_bench_entry(void * fn, void * arg, void * unused)
+{
+    ((suit_bench_fn_t) fn)(arg);
+    k_sem_give(&suit_bench_done);
+}
+
+size_t suit_bench_stack(suit_bench_fn_t fn, void * arg)
+{
+    k_thread_create(&suit_bench_thread, suit_bench_stack_area,
+            K_THREAD_STACK_SIZEOF(suit_bench_stack_area),
+            _suit_bench_entry, fn, arg, NULL,
+            k_thread_priority_get(k_current_get()), 0, K_NO_WAIT);
+    k_sem_take(&suit_bench_done, K_FOREVER);
+
+    size_t unused;
+    if (k_thread_stack_space_get(&suit_bench_thread, &unused)) return 0;
+    return suit_bench_thread.stack_info.size - unused;
+}
+
+struct {
+    void * ptr;
+    size_t size;
+} suit_bench_allocs[SUIT_BENCH_ALLOCS];
+
+void * _suit_bench_calloc(size_t n, size_t size)
+{
+    void * ptr = SUIT_BENCH_CALLOC(n, size);
+    for (size_t i = 0; ptr && i < SUIT_BENCH_ALLOCS; i++)
+        if (suit_bench_allocs[i].ptr == NULL) {
+            suit_bench_allocs[i].ptr = ptr;
+            suit_bench_allocs[i].size = n * size;
+            break;
+        }
+    return ptr;
+}
+
+void _suit_bench_free(void * ptr)
+{
+    for (size_t i = 0; ptr && i < SUIT_BENCH_ALLOCS; i++)
+        if (suit_bench_allocs[i].ptr == ptr) {
+            suit_bench_allocs[i].ptr = NULL;
+            break;
+        }
+    SUIT_BENCH_FREE(ptr);
+}
+
+size_t suit_bench_retained(suit_bench_fn_t fn, void * arg)
+{
+    memset(suit_bench_allocs, 0, sizeof(suit_bench_allocs));
+    mbedtls_platform_set_calloc_free(_suit_bench_calloc, _suit_bench_free);
+    fn(arg);
+    mbedtls_platform_set_calloc_free(SUIT_BENCH_CALLOC, SUIT_BENCH_FREE);
+
+    size_t retained = 0;
+    for (size_t i = 0; i < SUIT_BENCH_ALLOCS; i++)
+        if (suit_bench_allocs[i].ptr) retained += suit_bench_allocs[i].size;
+    return retained;
+}
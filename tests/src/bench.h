@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_BENCH_H
+#define SUIT_BENCH_H
+
+#include <zephyr.h>
+
+typedef void (*suit_bench_fn_t)(void * arg);
+
+/*
+ * Benchmarks read suit_bench_now() and print SUIT_BENCH_UNIT. On 
+ * native_posix, code runs in zero simulated time and the cycle 
+ * counter does not move, so the host's monotonic clock is read in 
+ * nanoseconds instead. Both wrap around, so intervals must be shorter
+ * than 2^32 units (about 4 s in nanoseconds).
+ */
+#ifdef CONFIG_ARCH_POSIX
+#define SUIT_BENCH_UNIT "ns"
+#else
+#define SUIT_BENCH_UNIT "cycles"
+#endif
+
+uint32_t suit_bench_now(void);
+
+/*
+ * Runs fn(arg) to completion on a dedicated thread with a freshly 
+ * painted stack and returns the number of stack bytes it touched.
+ * Requires CONFIG_INIT_STACKS and CONFIG_THREAD_STACK_INFO.
+ */
+size_t suit_bench_stack(suit_bench_fn_t fn, void * arg);
+
+/*
+ * Runs fn(arg) with the mbedTLS allocator counting, and returns the
+ * bytes allocated by fn that are still allocated when it returns, 
+ * such as the memory held by a key it initializes.
+ */
+size_t suit_bench_retained(suit_bench_fn_t fn, void * arg);
+
+#endif /* SUIT_BENCH_H */
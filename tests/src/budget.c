@@ -0,0 +1,48 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "budget.h"
+
+/*
+ * An operation without an entry for the board fails the test. To 
+ * record a baseline, build the tests for the board with 
+ * -DSUIT_TEST_BUDGET_ONLY=y, run them and copy the lines that 
+ * test_suit_budget prints in this format. Record again, in the same 
+ * commit, when a change is meant to cost more. No scenario in 
+ * testcase.yaml runs the test until a board has entries here.
+ */
+const struct suit_budget suit_budget_baseline[] = {
+    { NULL },
+};
+
+const struct suit_budget * suit_budget_find(const char * name)
+{
+    for (const struct suit_budget * b = suit_budget_baseline; 
+            b->board; b++)
+        if (!strcmp(b->board, CONFIG_BOARD) && !strcmp(b->name, name))
+            return b;
+    return NULL;
+}
+
+bool suit_budget_is_met(const struct suit_budget * b, 
+        uint32_t cycles, size_t stack)
+{
+    return (b->cycles == 0 || (uint64_t) cycles * 100 
+                <= (uint64_t) b->cycles * (100 + SUIT_BUDGET_CYCLES_PCT))
+        && (b->stack == 0 || stack * 100 
+                <= b->stack * (100 + SUIT_BUDGET_STACK_PCT));
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_BUDGET_H
+#define SUIT_BUDGET_H
+
+#include <zephyr.h>
+
+/*
+ * Measurements may exceed their baseline by this much before the 
+ * performance test fails. Cycles vary more between runs than stack.
+ */
+#define SUIT_BUDGET_CYCLES_PCT 25
+#define SUIT_BUDGET_STACK_PCT 10
+
+/*
+ * The median cycles and the stack high-water mark of an operation, as
+ * recorded on a board. A measure of 0 is not checked: native_posix,
+ * for one, does not advance its clock while code runs.
+ */
+struct suit_budget {
+    const char * board;
+    const char * name;
+    uint32_t cycles;
+    size_t stack;
+};
+
+/* the checked-in baseline, ending with an entry without a board */
+extern const struct suit_budget suit_budget_baseline[];
+
+/*
+ * Returns the baseline of an operation on the board the tests run 
+ * on, or NULL if none has been recorded.
+ */
+const struct suit_budget * suit_budget_find(const char * name);
+
+/* returns true if both measures are within tolerance of the baseline */
+bool suit_budget_is_met(const struct suit_budget * b, 
+        uint32_t cycles, size_t stack);
+
+#endif /* SUIT_BUDGET_H */
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <zoot/suit.h>
+#include "corpus.h"
+
+#define SUIT_CORPUS_URI "coap://fw.example/image.bin"
+#define SUIT_CORPUS_MIRROR "coap://mirror.example/image.bin"
+#define SUIT_CORPUS_PAYLOAD_KEY "#image"
+#define SUIT_CORPUS_TEXT_LINE "Synthetic image for scaling tests. "
+#define SUIT_CORPUS_MAX_TEXT 4096
+
+/*
+ * Sections are written straight into the manifest. The length of a
+ * byte-string wrapped section is found by encoding it without a
+ * buffer first, which nanocbor counts.
+ */
+typedef void (*_suit_corpus_write_t)(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc);
+
+size_t _suit_corpus_measure(_suit_corpus_write_t write,
+        const struct suit_corpus_shape * shape, size_t idx, size_t level)
+{
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, NULL, 0);
+    write(shape, idx, level, &nc);
+    return nanocbor_encoded_len(&nc);
+}
+
+void _suit_corpus_wrap(_suit_corpus_write_t write,
+        const struct suit_corpus_shape * shape, size_t idx, size_t level,
+        nanocbor_encoder_t * nc)
+{
+    nanocbor_fmt_bstr(nc, _suit_corpus_measure(write, shape, idx, level));
+    write(shape, idx, level, nc);
+}
+
+/* items in the commands of a level */
+size_t _suit_corpus_items(const struct suit_corpus_shape * shape, 
+        size_t level)
+{
+    return level ? 2 : 4 + 2 * shape->commands;
+}
+
+void _suit_corpus_sequence(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc);
+
+/* mirror URI, the second alternative of every try-each */
+void _suit_corpus_mirror(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc)
+{
+    nanocbor_fmt_array(nc, 2);
+    nanocbor_fmt_uint(nc, suit_dir_set_params);
+    nanocbor_fmt_map(nc, 1);
+    nanocbor_fmt_uint(nc, suit_param_uri);
+    nanocbor_put_tstr(nc, SUIT_CORPUS_MIRROR);
+}
+
+/* commands installing component idx, level try-each directives deep */
+void _suit_corpus_commands(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc)
+{
+    static const uint8_t conditions[] = {
+        suit_cond_vendor_id, suit_cond_class_id, suit_cond_image_match,
+    };
+
+    if (level > 0) {
+        nanocbor_fmt_uint(nc, suit_dir_try_each);
+        nanocbor_fmt_array(nc, 2);
+        _suit_corpus_wrap(_suit_corpus_sequence, shape, idx, level - 1, nc);
+        _suit_corpus_wrap(_suit_corpus_mirror, shape, idx, 0, nc);
+        return;
+    }
+
+    uint8_t digest[32];
+    memset(digest, 0x5a, sizeof(digest));
+    digest[0] = idx;
+    digest[1] = idx >> 8;
+    nanocbor_fmt_uint(nc, suit_dir_set_params);
+    nanocbor_fmt_map(nc, 3);
+    nanocbor_fmt_uint(nc, suit_param_image_digest);
+    nanocbor_fmt_array(nc, 2);
+    nanocbor_fmt_uint(nc, suit_digest_alg_sha256);
+    nanocbor_put_bstr(nc, digest, sizeof(digest));
+    nanocbor_fmt_uint(nc, suit_param_image_size);
+    nanocbor_fmt_uint(nc, 1024 + idx);
+    nanocbor_fmt_uint(nc, suit_param_uri);
+    nanocbor_put_tstr(nc, SUIT_CORPUS_URI);
+    for (size_t i = 0; i < shape->commands; i++) {
+        nanocbor_fmt_uint(nc, conditions[i % sizeof(conditions)]);
+        nanocbor_fmt_uint(nc, 0); /* report policy */
+    }
+    nanocbor_fmt_uint(nc, suit_dir_fetch);
+    nanocbor_fmt_null(nc);
+}
+
+void _suit_corpus_sequence(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc)
+{
+    nanocbor_fmt_array(nc, _suit_corpus_items(shape, level));
+    _suit_corpus_commands(shape, idx, level, nc);
+}
+
+void _suit_corpus_install(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc)
+{
+    nanocbor_fmt_array(nc, shape->components 
+            * (2 + _suit_corpus_items(shape, shape->depth)));
+    for (size_t i = 0; i < shape->components; i++) {
+        nanocbor_fmt_uint(nc, suit_dir_set_comp_idx);
+        nanocbor_fmt_uint(nc, i);
+        _suit_corpus_commands(shape, i, shape->depth, nc);
+    }
+}
+
+void _suit_corpus_comps(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc)
+{
+    nanocbor_fmt_array(nc, shape->components);
+    for (size_t i = 0; i < shape->components; i++) {
+        uint8_t id[2] = { i >> 8, i };
+        nanocbor_fmt_array(nc, 1);
+        nanocbor_put_bstr(nc, id, sizeof(id));
+    }
+}
+
+void _suit_corpus_common(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc)
+{
+    nanocbor_fmt_map(nc, 1);
+    nanocbor_fmt_uint(nc, suit_common_comps);
+    _suit_corpus_wrap(_suit_corpus_comps, shape, 0, 0, nc);
+}
+
+/* a description of text characters, the sentence over and over */
+void _suit_corpus_text(const struct suit_corpus_shape * shape,
+        size_t idx, size_t level, nanocbor_encoder_t * nc)
+{
+    static const char line[] = SUIT_CORPUS_TEXT_LINE;
+    static char text[SUIT_CORPUS_MAX_TEXT + 1];
+    for (size_t i = 0; i < shape->text; i++)
+        text[i] = line[i % (sizeof(line) - 1)];
+    text[shape->text] = '\0';
+    nanocbor_fmt_map(nc, 1);
+    nanocbor_fmt_uint(nc, 1); /* manifest description */
+    nanocbor_put_tstr(nc, text);
+}
+
+size_t suit_corpus_manifest(const struct suit_corpus_shape * shape,
+        uint8_t * man, size_t size_man)
+{
+    if (shape->components == 0 || shape->text > SUIT_CORPUS_MAX_TEXT) 
+        return 0;
+
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, man, size_man);
+    nanocbor_fmt_map(&nc, shape->text ? 5 : 4);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_version);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_seq_num);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_common);
+    _suit_corpus_wrap(_suit_corpus_common, shape, 0, 0, &nc);
+    nanocbor_fmt_uint(&nc, suit_header_install);
+    _suit_corpus_wrap(_suit_corpus_install, shape, 0, 0, &nc);
+    if (shape->text) {
+        nanocbor_fmt_uint(&nc, suit_header_text);
+        _suit_corpus_wrap(_suit_corpus_text, shape, 0, 0, &nc);
+    }
+
+    size_t len = nanocbor_encoded_len(&nc);
+    return len > size_man ? 0 : len;
+}
+
+size_t suit_corpus_add_payload(const struct suit_corpus_shape * shape,
+        uint8_t * env, size_t len_env, size_t size_env)
+{
+    if (shape->payload == 0) return len_env;
+    if (len_env == 0 || (env[0] & 0xe0) != 0xa0 || (env[0] & 0x1f) >= 23) 
+        return 0;
+
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, env + len_env, size_env - len_env);
+    nanocbor_put_tstr(&nc, SUIT_CORPUS_PAYLOAD_KEY);
+    nanocbor_fmt_bstr(&nc, shape->payload);
+    size_t len = len_env + nanocbor_encoded_len(&nc);
+    if (len + shape->payload > size_env) return 0;
+    for (size_t i = 0; i < shape->payload; i++)
+        env[len + i] = i * 7;
+    env[0]++; /* one more envelope member */
+    return len + shape->payload;
+}
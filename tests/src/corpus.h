@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 RISE Research Institutes of Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SUIT_CORPUS_H
+#define SUIT_CORPUS_H
+
+#include <zephyr.h>
+
+/*
+ * The shape of a synthetic manifest. Every component gets its own 
+ * digest, size and URI, set in an install sequence nested depth 
+ * try-each directives deep, each offering a mirror URI as its second 
+ * alternative. The innermost sequence carries commands extra 
+ * conditions before the fetch. The manifest has a text section of 
+ * text characters, and its envelope an integrated payload of payload
+ * bytes.
+ */
+struct suit_corpus_shape {
+    size_t components;
+    size_t depth;
+    size_t commands;
+    size_t text;
+    size_t payload;
+};
+
+/*
+ * Writes a manifest of the given shape and returns its length, or 0
+ * if it does not fit.
+ */
+size_t suit_corpus_manifest(const struct suit_corpus_shape * shape,
+        uint8_t * man, size_t size_man);
+
+/*
+ * Appends the integrated payload of the shape to an envelope written
+ * by one of the wrap functions and returns the new length, or 0 if it
+ * does not fit.
+ */
+size_t suit_corpus_add_payload(const struct suit_corpus_shape * shape,
+        uint8_t * env, size_t len_env, size_t size_env);
+
+#endif /* SUIT_CORPUS_H */
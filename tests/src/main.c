@@ -24,10 +24,40 @@ extern void test_suit_load_external_storage(void);
 extern void test_suit_load_decompress_external_storage(void);
 extern void test_suit_compatibility_download_install_boot(void);
 extern void test_suit_two_images(void);
+extern void test_suit_pinned_key(void);
+extern void test_suit_auth_algorithms(void);
+extern void test_suit_multi_signature(void);
+extern void test_suit_nested_try_each(void);
+extern void test_suit_arena_high_water(void);
+extern void test_suit_dependencies(void);
+extern void test_suit_component_sets(void);
+extern void test_suit_shared_params(void);
+extern void test_suit_identity_match(void);
+extern void test_suit_install_plan(void);
+extern void test_suit_plan_order(void);
+extern void test_suit_integrated_payload(void);
+extern void test_suit_fetch_sources(void);
+extern void test_suit_journal_resume(void);
+extern void test_suit_flash_writer(void);
+extern void test_suit_block_digests(void);
+extern void test_suit_swap(void);
+extern void test_suit_copy(void);
+extern void test_suit_template(void);
+extern void test_suit_build(void);
+extern void test_suit_bundle(void);
+extern void test_suit_corpus(void);
+extern void test_suit_schedule(void);
+extern void test_suit_index(void);
+extern void test_suit_budget(void);
 
 /* test case main entry */
 void test_main(void)
 {
+    /* the budget is checked on its own, see budget.c */
+#ifdef SUIT_TEST_BUDGET_ONLY
+    ztest_test_suite(suit_tests,
+        ztest_unit_test(test_suit_budget));
+#else
     ztest_test_suite(suit_tests,
         ztest_unit_test(test_suit_boot),
         ztest_unit_test(test_suit_download_install),
@@ -35,6 +65,31 @@ void test_main(void)
         ztest_unit_test(test_suit_load_external_storage),
         ztest_unit_test(test_suit_load_decompress_external_storage),
         ztest_unit_test(test_suit_compatibility_download_install_boot),
-        ztest_unit_test(test_suit_two_images));
+        ztest_unit_test(test_suit_two_images),
+        ztest_unit_test(test_suit_pinned_key),
+        ztest_unit_test(test_suit_auth_algorithms),
+        ztest_unit_test(test_suit_multi_signature),
+        ztest_unit_test(test_suit_nested_try_each),
+        ztest_unit_test(test_suit_arena_high_water),
+        ztest_unit_test(test_suit_dependencies),
+        ztest_unit_test(test_suit_component_sets),
+        ztest_unit_test(test_suit_shared_params),
+        ztest_unit_test(test_suit_identity_match),
+        ztest_unit_test(test_suit_install_plan),
+        ztest_unit_test(test_suit_plan_order),
+        ztest_unit_test(test_suit_integrated_payload),
+        ztest_unit_test(test_suit_fetch_sources),
+        ztest_unit_test(test_suit_journal_resume),
+        ztest_unit_test(test_suit_flash_writer),
+        ztest_unit_test(test_suit_block_digests),
+        ztest_unit_test(test_suit_swap),
+        ztest_unit_test(test_suit_copy),
+        ztest_unit_test(test_suit_template),
+        ztest_unit_test(test_suit_build),
+        ztest_unit_test(test_suit_bundle),
+        ztest_unit_test(test_suit_corpus),
+        ztest_unit_test(test_suit_schedule),
+        ztest_unit_test(test_suit_index));
+#endif
     ztest_run_test_suite(suit_tests);
 }
@@ -17,7 +17,23 @@
 
 #include <ztest.h>
 #include <zoot/suit.h>
+#include <zoot/deps.h>
+#include <zoot/plan.h>
+#include <zoot/fetch.h>
+#include <zoot/journal.h>
+#include <zoot/writer.h>
+#include <zoot/merkle.h>
+#include <zoot/swap.h>
+#include <zoot/template.h>
+#include <zoot/build.h>
+#include <zoot/bundle.h>
+#include <zoot/schedule.h>
+#include <zoot/index.h>
+#include <mbedtls/sha256.h>
 #include "vectors.h"
+#include "bench.h"
+#include "corpus.h"
+#include "budget.h"
 
 static size_t test_size = 34768;
 static uint8_t test_digest[] = {
@@ -49,6 +65,15 @@ static uint8_t test_uri[] = {
     zassert_false(suit_parse_init(&ctx, man, len_man),                  \
             "Failed to parse SUIT manifest.");
 
+/* skips a test whose feature is compiled out of this build */
+#define SUIT_TEST_REQUIRES(feature)                                     \
+    do {                                                                \
+        if (!IS_ENABLED(feature)) {                                     \
+            ztest_test_skip();                                          \
+            return;                                                     \
+        }                                                               \
+    } while (0)
+
 /* converts hex-formatted IETF examples to raw bytes */
 void _xxd_r(char * hex, uint8_t * out)
 {
@@ -65,6 +90,7 @@ const uint8_t * pem_pub = SUIT_TEST_KEY_256_PUB;
 const uint8_t * pem_prv = SUIT_TEST_KEY_256_PRV;
 
 void test_suit_boot(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_ES256);
     SUIT_TEST_PARSE(0);
 
     /* encode a signed manifest envelope */
@@ -129,6 +155,7 @@ void test_suit_download_install_boot(void) {
 }
 
 void test_suit_load_external_storage(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_COPY);
     SUIT_TEST_PARSE(3);
     zassert_true(
             suit_class_id_is_match(&ctx, 0, test_class_id, sizeof(test_class_id)),
@@ -153,6 +180,7 @@ void test_suit_load_external_storage(void) {
 }
 
 void test_suit_load_decompress_external_storage(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_COPY);
     SUIT_TEST_PARSE(4);
     zassert_true(
             suit_class_id_is_match(&ctx, 0, test_class_id, sizeof(test_class_id)),
@@ -177,6 +205,7 @@ void test_suit_load_decompress_external_storage(void) {
 }
 
 void test_suit_compatibility_download_install_boot(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_COPY);
     SUIT_TEST_PARSE(5);
     zassert_true(
             suit_class_id_is_match(&ctx, 1, test_class_id, sizeof(test_class_id)),
@@ -201,6 +230,7 @@ void test_suit_compatibility_download_install_boot(void) {
 }
 
 void test_suit_two_images(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_TRY_EACH);
     SUIT_TEST_PARSE(6);
     zassert_true(
             suit_class_id_is_match(&ctx, 0, test_class_id, sizeof(test_class_id)),
@@ -225,4 +255,3170 @@ void test_suit_two_images(void) {
     uint8_t * uri; size_t len_uri;
     suit_get_uri(&ctx, 0, (const uint8_t **) &uri, &len_uri);
     zassert_false(memcmp(test_uri_, uri, len_uri), "Unexpected URI.");
+
+    /* the slot B image differs from slot A, so it is not a mirror */
+    zassert_true(suit_get_uri_alt_count(&ctx, 0) == 0,
+            "Kept the other slot as an alternative URI.");
+}
+
+#define SUIT_TEST_BENCH_ROUNDS 10
+
+struct suit_test_pin {
+    suit_key_t * key;
+    int err;
+};
+
+void _suit_test_pin(void * arg)
+{
+    struct suit_test_pin * pin = arg;
+    pin->err = suit_key_init(pin->key, pem_pub);
+}
+
+/* RAM held by a pinned key, and unwrap latency with and without it */
+void test_suit_pinned_key(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_ES256);
+    SUIT_TEST_PARSE(0);
+
+    size_t len_env = 256; uint8_t env[len_env];
+    zassert_false(suit_manifest_wrap(
+                pem_prv, man, len_man, env, &len_env),
+                "Failed to write manifest envelope.");
+
+    /* RAM held by the pinned key, comb table included */
+    suit_key_t key;
+    struct suit_test_pin pin = { &key, 1 };
+    size_t ram = suit_bench_retained(_suit_test_pin, &pin);
+    zassert_false(pin.err, "Failed to pin key.");
+    zassert_true(ram > 0, "Pinned key holds no precomputation.");
+    printk("pinned key:             %u bytes of RAM\n", ram);
+
+    /* verify against the pinned key and extract manifest */
+    uint8_t * man_out;
+    size_t len_man_out;
+    zassert_false(suit_manifest_unwrap_key(
+                &key, env, len_env,
+                (const uint8_t **) &man_out, &len_man_out),
+                "Failed to authenticate envelope contents.");
+    zassert_true(len_man == len_man_out,
+            "Failed to extract manifest.");
+    zassert_false(memcmp(man, man_out, len_man),
+            "Failed to extract manifest.");
+
+    /* compare verification latency with and without pinning */
+    uint32_t start = suit_bench_now();
+    for (int i = 0; i < SUIT_TEST_BENCH_ROUNDS; i++)
+        suit_manifest_unwrap(pem_pub, env, len_env, 
+                (const uint8_t **) &man_out, &len_man_out);
+    uint32_t cycles_pem = suit_bench_now() - start;
+
+    start = suit_bench_now();
+    for (int i = 0; i < SUIT_TEST_BENCH_ROUNDS; i++)
+        suit_manifest_unwrap_key(&key, env, len_env, 
+                (const uint8_t **) &man_out, &len_man_out);
+    uint32_t cycles_key = suit_bench_now() - start;
+
+    printk("unwrap with PEM key:    %u " SUIT_BENCH_UNIT "\n", 
+            cycles_pem / SUIT_TEST_BENCH_ROUNDS);
+    printk("unwrap with pinned key: %u " SUIT_BENCH_UNIT "\n", 
+            cycles_key / SUIT_TEST_BENCH_ROUNDS);
+
+    /* a modified manifest must be rejected */
+    env[len_env - 1] ^= 0x01;
+    zassert_true(suit_manifest_unwrap_key(
+                &key, env, len_env,
+                (const uint8_t **) &man_out, &len_man_out),
+                "Accepted a modified manifest.");
+
+    suit_key_free(&key);
+}
+
+static uint8_t test_hmac_secret[] = {
+    0x84, 0x9b, 0x57, 0x21, 0x9d, 0xae, 0x48, 0xde,
+    0x64, 0x6d, 0x07, 0xdb, 0xb5, 0x33, 0x56, 0x6e,
+    0x97, 0x66, 0x86, 0x45, 0x7c, 0x14, 0x91, 0xbe,
+    0x3a, 0x76, 0xdc, 0xea, 0x6c, 0x42, 0x71, 0x88
+};
+
+struct suit_test_unwrap {
+    const char * name;
+    suit_key_t * key;
+    uint8_t * env; size_t len_env;
+    int err;
+};
+
+void _suit_test_unwrap(void * arg)
+{
+    struct suit_test_unwrap * run = arg;
+    const uint8_t * man; size_t len_man;
+    run->err = suit_manifest_unwrap_key(
+            run->key, run->env, run->len_env, &man, &len_man);
+}
+
+/* verification time and stack of each enabled algorithm */
+void test_suit_auth_algorithms(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_ES256);
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_HMAC);
+    SUIT_TEST_PARSE(0);
+
+    suit_key_t es256, hmac;
+    zassert_false(suit_key_init(&es256, pem_pub), "Failed to pin key.");
+    zassert_false(suit_key_init_hmac(
+                &hmac, test_hmac_secret, sizeof(test_hmac_secret)),
+                "Failed to set HMAC key.");
+
+    size_t len_env_es256 = 512; uint8_t env_es256[len_env_es256];
+    zassert_false(suit_manifest_wrap(
+                pem_prv, man, len_man, env_es256, &len_env_es256),
+                "Failed to write ES256 envelope.");
+    size_t len_env_hmac = 512; uint8_t env_hmac[len_env_hmac];
+    zassert_false(suit_manifest_wrap_key(
+                &hmac, man, len_man, env_hmac, &len_env_hmac),
+                "Failed to write HMAC envelope.");
+
+    /* keys only accept wrappers of their own algorithm */
+    const uint8_t * man_out; size_t len_man_out;
+    zassert_true(suit_manifest_unwrap_key(
+                &es256, env_hmac, len_env_hmac, &man_out, &len_man_out),
+                "Accepted COSE_Mac0 with a signature key.");
+    zassert_true(suit_manifest_unwrap_key(
+                &hmac, env_es256, len_env_es256, &man_out, &len_man_out),
+                "Accepted COSE Sign1 with an HMAC key.");
+
+    /* compare verification time and stack usage per algorithm */
+    struct suit_test_unwrap runs[] = {
+        { "ES256", &es256, env_es256, len_env_es256, 0 },
+        { "HMAC 256/256", &hmac, env_hmac, len_env_hmac, 0 },
+    };
+    for (int i = 0; i < ARRAY_SIZE(runs); i++) {
+        size_t stack = suit_bench_stack(_suit_test_unwrap, &runs[i]);
+        zassert_false(runs[i].err, "Failed to authenticate envelope.");
+
+        uint32_t start = suit_bench_now();
+        for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++)
+            _suit_test_unwrap(&runs[i]);
+        uint32_t cycles = suit_bench_now() - start;
+
+        printk("unwrap %-14s %10u " SUIT_BENCH_UNIT " %6u bytes of stack\n",
+                runs[i].name, cycles / SUIT_TEST_BENCH_ROUNDS, stack);
+    }
+
+    suit_key_free(&es256);
+    suit_key_free(&hmac);
+}
+
+static const uint8_t * test_multi_prv[] = {
+    SUIT_TEST_KEY_256_PRV, SUIT_TEST_KEY_256_PRV_1,
+    SUIT_TEST_KEY_256_PRV_2, SUIT_TEST_KEY_256_PRV_3,
+};
+static const uint8_t * test_multi_pub[] = {
+    SUIT_TEST_KEY_256_PUB, SUIT_TEST_KEY_256_PUB_1,
+    SUIT_TEST_KEY_256_PUB_2, SUIT_TEST_KEY_256_PUB_3,
+};
+
+/* verification time for 1, 2 and 4 signers */
+void test_suit_multi_signature(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_ES256);
+    SUIT_TEST_PARSE(0);
+
+    suit_key_t keys[ARRAY_SIZE(test_multi_pub)];
+    for (int i = 0; i < ARRAY_SIZE(keys); i++)
+        zassert_false(suit_key_init(&keys[i], test_multi_pub[i]),
+                "Failed to pin key.");
+
+    /* time n-of-n verification for a growing number of signers */
+    size_t size_env = 1024; uint8_t env[size_env];
+    const uint8_t * man_out; size_t len_man_out;
+    for (size_t n = 1; n <= ARRAY_SIZE(keys); n *= 2) {
+        size_t len_env = size_env;
+        zassert_false(suit_manifest_wrap(
+                    test_multi_prv[0], man, len_man, env, &len_env),
+                    "Failed to write manifest envelope.");
+        for (size_t i = 1; i < n; i++)
+            zassert_false(suit_manifest_countersign(
+                        test_multi_prv[i], env, &len_env, size_env),
+                        "Failed to add signature.");
+
+        zassert_false(suit_manifest_unwrap_multi(
+                    keys, n, n, env, len_env, &man_out, &len_man_out),
+                    "Failed to authenticate envelope contents.");
+        zassert_true(len_man == len_man_out && 
+                !memcmp(man, man_out, len_man),
+                "Failed to extract manifest.");
+
+        uint32_t start = suit_bench_now();
+        for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++)
+            suit_manifest_unwrap_multi(
+                    keys, n, n, env, len_env, &man_out, &len_man_out);
+        uint32_t cycles = suit_bench_now() - start;
+        printk("unwrap %u-of-%u signatures %10u " SUIT_BENCH_UNIT "\n",
+                n, n, cycles / SUIT_TEST_BENCH_ROUNDS);
+    }
+
+    /* a single signature meets 1-of-2 but not 2-of-2 */
+    size_t len_env = size_env;
+    zassert_false(suit_manifest_wrap(
+                test_multi_prv[1], man, len_man, env, &len_env),
+                "Failed to write manifest envelope.");
+    zassert_false(suit_manifest_unwrap_multi(
+                keys, 2, 1, env, len_env, &man_out, &len_man_out),
+                "Rejected envelope meeting the threshold.");
+    zassert_true(suit_manifest_unwrap_multi(
+                keys, 2, 2, env, len_env, &man_out, &len_man_out),
+                "Accepted envelope below the threshold.");
+
+    /* signing twice with one key does not count twice */
+    zassert_false(suit_manifest_countersign(
+                test_multi_prv[1], env, &len_env, size_env),
+                "Failed to add signature.");
+    zassert_true(suit_manifest_unwrap_multi(
+                keys, 2, 2, env, len_env, &man_out, &len_man_out),
+                "Counted a key twice.");
+
+    /* COSE_Sign wrapper with two signers */
+    len_env = strlen(SUIT_ENVELOPE_COSE_SIGN) / 2;
+    _xxd_r(SUIT_ENVELOPE_COSE_SIGN, env);
+    zassert_false(suit_manifest_unwrap_multi(
+                keys, 2, 2, env, len_env, &man_out, &len_man_out),
+                "Failed to authenticate COSE_Sign envelope.");
+    zassert_true(len_man == len_man_out && 
+            !memcmp(man, man_out, len_man),
+            "Failed to extract manifest.");
+    zassert_true(suit_manifest_unwrap_multi(
+                keys, 4, 3, env, len_env, &man_out, &len_man_out),
+                "Accepted envelope below the threshold.");
+    env[len_env - 1] ^= 0x01;
+    zassert_true(suit_manifest_unwrap_multi(
+                keys, 2, 1, env, len_env, &man_out, &len_man_out),
+                "Accepted a modified manifest.");
+
+    for (int i = 0; i < ARRAY_SIZE(keys); i++)
+        suit_key_free(&keys[i]);
+}
+
+/* 
+ * Builds a manifest whose install sequence nests try-each directives
+ * depth levels deep. At every level the first alternative fails and 
+ * the second descends; the innermost sequence sets the image size.
+ */
+size_t _suit_test_nested(size_t depth, uint8_t * man, size_t size_man)
+{
+    uint8_t seq[2][512];
+    uint8_t bad[2];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, bad, sizeof(bad));
+    nanocbor_fmt_array(&nc, 1);
+    nanocbor_fmt_uint(&nc, 99);
+
+    nanocbor_encoder_init(&nc, seq[0], sizeof(seq[0]));
+    nanocbor_fmt_array(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_param_image_size);
+    nanocbor_fmt_uint(&nc, test_size);
+    size_t len_seq = nanocbor_encoded_len(&nc);
+
+    for (size_t i = 0; i < depth; i++) {
+        uint8_t * in = seq[i % 2], * out = seq[(i + 1) % 2];
+        nanocbor_encoder_init(&nc, out, sizeof(seq[0]));
+        nanocbor_fmt_array(&nc, 2);
+        nanocbor_fmt_uint(&nc, suit_dir_try_each);
+        nanocbor_fmt_array(&nc, 2);
+        nanocbor_put_bstr(&nc, bad, sizeof(bad));
+        nanocbor_put_bstr(&nc, in, len_seq);
+        len_seq = nanocbor_encoded_len(&nc);
+    }
+
+    /* one component, installed by the nested sequence */
+    uint8_t comps[4], com[8];
+    nanocbor_encoder_init(&nc, comps, sizeof(comps));
+    nanocbor_fmt_array(&nc, 1);
+    nanocbor_fmt_array(&nc, 1);
+    nanocbor_put_bstr(&nc, (uint8_t *) "", 0);
+    size_t len_comps = nanocbor_encoded_len(&nc);
+    nanocbor_encoder_init(&nc, com, sizeof(com));
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_common_comps);
+    nanocbor_put_bstr(&nc, comps, len_comps);
+    size_t len_com = nanocbor_encoded_len(&nc);
+
+    nanocbor_encoder_init(&nc, man, size_man);
+    nanocbor_fmt_map(&nc, 4);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_version);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_seq_num);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_common);
+    nanocbor_put_bstr(&nc, com, len_com);
+    nanocbor_fmt_uint(&nc, suit_header_install);
+    nanocbor_put_bstr(&nc, seq[depth % 2], len_seq);
+    return nanocbor_encoded_len(&nc);
+}
+
+struct suit_test_parse {
+    uint8_t * man; size_t len_man;
+    suit_context_t * ctx;
+    int err;
+};
+
+void _suit_test_parse(void * arg)
+{
+    struct suit_test_parse * run = arg;
+    run->err = suit_parse_init(run->ctx, run->man, run->len_man);
+}
+
+/* stack that may differ between runs of the same code path */
+#define SUIT_TEST_STACK_SLACK 64
+
+/* the parse stack at several nesting depths, which must not grow */
+void test_suit_nested_try_each(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_TRY_EACH);
+    uint8_t man[512];
+    suit_context_t ctx;
+    struct suit_test_parse run = { man, 0, &ctx, 0 };
+
+    /* stack use must not grow with the nesting depth */
+    size_t depths[] = { 0, 1, SUIT_MAX_NESTING };
+    size_t stack[ARRAY_SIZE(depths)];
+    for (int i = 0; i < ARRAY_SIZE(depths); i++) {
+        run.len_man = _suit_test_nested(depths[i], man, sizeof(man));
+        stack[i] = suit_bench_stack(_suit_test_parse, &run);
+        zassert_false(run.err, "Failed to parse SUIT manifest.");
+        zassert_true(suit_get_size(&ctx, 0) == test_size,
+                "Failed to parse nested parameters.");
+        printk("parse try-each depth %2u %6u bytes of stack\n", 
+                depths[i], stack[i]);
+    }
+    zassert_true(stack[ARRAY_SIZE(depths) - 1] 
+                <= stack[0] + SUIT_TEST_STACK_SLACK,
+            "Stack use grows with the nesting depth.");
+
+    /* manifests nested beyond the limit are rejected */
+    run.len_man = _suit_test_nested(
+            SUIT_MAX_NESTING + 1, man, sizeof(man));
+    zassert_true(suit_parse_init(&ctx, man, run.len_man),
+            "Accepted a manifest nested beyond the limit.");
+}
+
+/* arena use of each operation, for sizing CONFIG_ZOOT_ARENA_SIZE */
+void test_suit_arena_high_water(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_ES256);
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_HMAC);
+    SUIT_TEST_PARSE(0);
+
+    suit_key_t es256, hmac;
+    zassert_false(suit_key_init(&es256, pem_pub), "Failed to pin key.");
+    zassert_false(suit_key_init_hmac(
+                &hmac, test_hmac_secret, sizeof(test_hmac_secret)),
+                "Failed to set HMAC key.");
+
+    /* the arena is empty outside of wrap and unwrap */
+    suit_arena_reset_high_water();
+    zassert_true(suit_arena_high_water() == 0, "Arena in use.");
+
+    size_t len_env_es256 = 512; uint8_t env_es256[len_env_es256];
+    zassert_false(suit_manifest_wrap(
+                pem_prv, man, len_man, env_es256, &len_env_es256),
+                "Failed to write ES256 envelope.");
+    size_t wrap_pem = suit_arena_high_water();
+
+    suit_arena_reset_high_water();
+    size_t len_env_hmac = 512; uint8_t env_hmac[len_env_hmac];
+    zassert_false(suit_manifest_wrap_key(
+                &hmac, man, len_man, env_hmac, &len_env_hmac),
+                "Failed to write HMAC envelope.");
+    size_t wrap_hmac = suit_arena_high_water();
+
+    const uint8_t * man_out; size_t len_man_out;
+    suit_arena_reset_high_water();
+    zassert_false(suit_manifest_unwrap(pem_pub, env_es256, len_env_es256,
+                &man_out, &len_man_out),
+                "Failed to authenticate envelope contents.");
+    size_t unwrap_pem = suit_arena_high_water();
+
+    suit_arena_reset_high_water();
+    zassert_false(suit_manifest_unwrap_key(&es256, env_es256, 
+                len_env_es256, &man_out, &len_man_out),
+                "Failed to authenticate envelope contents.");
+    size_t unwrap_es256 = suit_arena_high_water();
+
+    suit_arena_reset_high_water();
+    zassert_false(suit_manifest_unwrap_key(&hmac, env_hmac, 
+                len_env_hmac, &man_out, &len_man_out),
+                "Failed to authenticate envelope contents.");
+    size_t unwrap_hmac = suit_arena_high_water();
+
+    printk("arena wrap   PEM ES256     %6u bytes\n", wrap_pem);
+    printk("arena wrap   HMAC 256/256  %6u bytes\n", wrap_hmac);
+    printk("arena unwrap PEM ES256     %6u bytes\n", unwrap_pem);
+    printk("arena unwrap pinned ES256  %6u bytes\n", unwrap_es256);
+    printk("arena unwrap HMAC 256/256  %6u bytes\n", unwrap_hmac);
+
+    suit_arena_reset_high_water();
+    zassert_true(suit_arena_high_water() == 0, "Arena not reset.");
+
+    suit_key_free(&es256);
+    suit_key_free(&hmac);
+}
+
+/* SHA-256 over a manifest and its byte string header */
+void _suit_test_digest(const uint8_t * man, size_t len_man, uint8_t * out)
+{
+    uint8_t hdr[9];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, hdr, sizeof(hdr));
+    nanocbor_fmt_bstr(&nc, len_man);
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    mbedtls_sha256_update_ret(&sha, hdr, nanocbor_encoded_len(&nc));
+    mbedtls_sha256_update_ret(&sha, man, len_man);
+    mbedtls_sha256_finish_ret(&sha, out);
+    mbedtls_sha256_free(&sha);
+}
+
+/* builds a manifest that depends on count other manifests */
+size_t _suit_test_dep_manifest(size_t seq_num,
+        uint8_t digests[][SUIT_DEP_DIGEST_SIZE], size_t count,
+        uint8_t * man, size_t size_man)
+{
+    uint8_t deps[128], com[136];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, deps, sizeof(deps));
+    nanocbor_fmt_array(&nc, count);
+    for (size_t i = 0; i < count; i++) {
+        nanocbor_fmt_map(&nc, 1);
+        nanocbor_fmt_uint(&nc, suit_dep_digest);
+        nanocbor_fmt_array(&nc, 2);
+        nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+        nanocbor_put_bstr(&nc, digests[i], SUIT_DEP_DIGEST_SIZE);
+    }
+    size_t len_deps = nanocbor_encoded_len(&nc);
+    nanocbor_encoder_init(&nc, com, sizeof(com));
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_common_deps);
+    nanocbor_put_bstr(&nc, deps, len_deps);
+    size_t len_com = nanocbor_encoded_len(&nc);
+
+    nanocbor_encoder_init(&nc, man, size_man);
+    nanocbor_fmt_map(&nc, 3);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_version);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_seq_num);
+    nanocbor_fmt_uint(&nc, seq_num);
+    nanocbor_fmt_uint(&nc, suit_header_common);
+    nanocbor_put_bstr(&nc, com, len_com);
+    return nanocbor_encoded_len(&nc);
+}
+
+/* envelopes the fetch callback can serve, by manifest digest */
+struct suit_test_store {
+    size_t count, fetches;
+    uint8_t digest[3][SUIT_DEP_DIGEST_SIZE];
+    uint8_t env[3][384]; size_t len_env[3];
+};
+
+int _suit_test_fetch(void * arg, const uint8_t * digest, size_t len_digest,
+        const uint8_t ** env, size_t * len_env)
+{
+    struct suit_test_store * store = arg;
+    store->fetches++;
+    for (size_t i = 0; i < store->count; i++) {
+        if (!memcmp(store->digest[i], digest, len_digest)) {
+            *env = store->env[i];
+            *len_env = store->len_env[i];
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static suit_manifest_cache_t test_cache;
+static suit_dep_graph_t test_graph;
+
+/* resolution time with a cold and a warm manifest cache */
+void test_suit_dependencies(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_ES256);
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_DEPENDENCIES);
+
+    /* root depends on A and B, which both depend on C */
+    static struct suit_test_store store;
+    uint8_t man[3][160]; size_t len_man[3];
+    uint8_t root[256]; size_t len_root;
+    store.count = 3;
+    len_man[2] = _suit_test_dep_manifest(3, NULL, 0, man[2], sizeof(man[2]));
+    _suit_test_digest(man[2], len_man[2], store.digest[2]);
+    for (size_t i = 0; i < 2; i++) {
+        len_man[i] = _suit_test_dep_manifest(
+                1 + i, &store.digest[2], 1, man[i], sizeof(man[i]));
+        _suit_test_digest(man[i], len_man[i], store.digest[i]);
+    }
+    for (size_t i = 0; i < 3; i++) {
+        store.len_env[i] = sizeof(store.env[i]);
+        zassert_false(suit_manifest_wrap(pem_prv, man[i], len_man[i], 
+                    store.env[i], &store.len_env[i]),
+                "Failed to write manifest envelope.");
+    }
+    len_root = _suit_test_dep_manifest(
+            4, store.digest, 2, root, sizeof(root));
+
+    suit_context_t ctx;
+    zassert_false(suit_parse_init(&ctx, root, len_root),
+            "Failed to parse SUIT manifest.");
+    zassert_true(suit_get_dependency_count(&ctx) == 2,
+            "Failed to parse dependencies.");
+    zassert_true(suit_dependency_digest_is_match(
+                &ctx, 1, store.digest[1], SUIT_DEP_DIGEST_SIZE),
+            "Failed to parse dependency digest.");
+
+    suit_key_t key;
+    zassert_false(suit_key_init(&key, pem_pub), "Failed to pin key.");
+    suit_resolver_t res = {
+        .keys = &key, .key_count = 1, .threshold = 1,
+        .fetch = _suit_test_fetch, .arg = &store,
+        .cache = &test_cache,
+    };
+    suit_manifest_cache_init(&test_cache);
+
+    /* the shared dependency is fetched and verified once */
+    uint32_t start = suit_bench_now();
+    zassert_false(suit_resolve_dependencies(&res, &ctx, &test_graph),
+            "Failed to resolve dependencies.");
+    uint32_t cycles_cold = suit_bench_now() - start;
+    zassert_true(test_graph.count == 4, "Wrong number of manifests.");
+    zassert_true(store.fetches == 3, "Fetched a manifest twice.");
+    suit_dep_node_t * nodes = test_graph.nodes;
+    zassert_true(nodes[nodes[0].deps[0]].deps[0] == 
+            nodes[nodes[0].deps[1]].deps[0], 
+            "Failed to merge shared dependency.");
+    zassert_true(suit_get_sequence_number(&nodes[3].ctx) == 3,
+            "Failed to parse dependency.");
+
+    /* a second resolution in the same update skips the signatures */
+    start = suit_bench_now();
+    zassert_false(suit_resolve_dependencies(&res, &ctx, &test_graph),
+            "Failed to resolve dependencies.");
+    uint32_t cycles_warm = suit_bench_now() - start;
+    printk("resolve 3 dependencies     %10u " SUIT_BENCH_UNIT "\n", 
+            cycles_cold);
+    printk("resolve 3 cached           %10u " SUIT_BENCH_UNIT "\n", 
+            cycles_warm);
+
+    /* entries cached under one key policy do not satisfy another */
+    suit_resolver_t strict = res;
+    strict.threshold = 2;
+    zassert_true(suit_resolve_dependencies(&strict, &ctx, &test_graph),
+            "Used a cache entry from another key policy.");
+
+    /* an envelope that does not match the digest is rejected */
+    suit_manifest_cache_init(&test_cache);
+    memcpy(store.env[2], store.env[0], store.len_env[0]);
+    store.len_env[2] = store.len_env[0];
+    zassert_true(suit_resolve_dependencies(&res, &ctx, &test_graph),
+            "Accepted a mismatched dependency.");
+
+    suit_key_free(&key);
+}
+
+/* builds a manifest with count components and an install sequence */
+size_t _suit_test_comp_wrap(size_t count, const uint8_t * seq,
+        size_t len_seq, uint8_t * man, size_t size_man)
+{
+    static uint8_t comps[4 * 256 + 8];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, comps, sizeof(comps));
+    nanocbor_fmt_array(&nc, count);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t id = i;
+        nanocbor_fmt_array(&nc, 1);
+        nanocbor_put_bstr(&nc, &id, 1);
+    }
+    size_t len_comps = nanocbor_encoded_len(&nc);
+
+    uint8_t com[8];
+    nanocbor_encoder_init(&nc, com, sizeof(com));
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_common_comps);
+    nanocbor_fmt_bstr(&nc, len_comps);
+    size_t len_com = nanocbor_encoded_len(&nc);
+
+    nanocbor_encoder_init(&nc, man, size_man);
+    nanocbor_fmt_map(&nc, 4);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_version);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_seq_num);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_common);
+    nanocbor_fmt_bstr(&nc, len_com + len_comps);
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_common_comps);
+    nanocbor_put_bstr(&nc, comps, len_comps);
+    nanocbor_fmt_uint(&nc, suit_header_install);
+    nanocbor_put_bstr(&nc, seq, len_seq);
+    return nanocbor_encoded_len(&nc);
+}
+
+/*
+ * Builds a manifest with count components that all get the same 
+ * parameters, through one set-parameters command per component, one
+ * for all components, or one for an array listing every index.
+ */
+enum { suit_test_comp_repeat, suit_test_comp_all, suit_test_comp_list };
+
+size_t _suit_test_comp_manifest(size_t count, int form,
+        uint8_t * man, size_t size_man)
+{
+    static uint8_t seq[128 * 256 + 8];
+    nanocbor_encoder_t nc;
+    size_t commands = form == suit_test_comp_repeat ? count : 1;
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 4 * commands);
+    for (size_t i = 0; i < commands; i++) {
+        nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+        if (form == suit_test_comp_repeat) {
+            nanocbor_fmt_uint(&nc, i);
+        } else if (form == suit_test_comp_all) {
+            nanocbor_fmt_bool(&nc, true);
+        } else {
+            nanocbor_fmt_array(&nc, count);
+            for (size_t j = 0; j < count; j++)
+                nanocbor_fmt_uint(&nc, j);
+        }
+        nanocbor_fmt_uint(&nc, suit_dir_set_params);
+        nanocbor_fmt_map(&nc, 4);
+        nanocbor_fmt_uint(&nc, suit_param_vendor_id);
+        nanocbor_put_bstr(&nc, test_vendor_id, sizeof(test_vendor_id));
+        nanocbor_fmt_uint(&nc, suit_param_class_id);
+        nanocbor_put_bstr(&nc, test_class_id, sizeof(test_class_id));
+        nanocbor_fmt_uint(&nc, suit_param_image_digest);
+        nanocbor_fmt_array(&nc, 2);
+        nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+        nanocbor_put_bstr(&nc, test_digest, sizeof(test_digest));
+        nanocbor_fmt_uint(&nc, suit_param_image_size);
+        nanocbor_fmt_uint(&nc, test_size);
+    }
+    size_t len_seq = nanocbor_encoded_len(&nc);
+
+    return _suit_test_comp_wrap(count, seq, len_seq, man, size_man);
+}
+
+static uint8_t test_comp_man[136 * 256 + 1024];
+static suit_context_t test_comp_ctx;
+
+/* one command per component against one for a component set */
+void test_suit_component_sets(void) {
+    suit_context_t * ctx = &test_comp_ctx;
+
+    /* every form reaches every component */
+    for (int form = suit_test_comp_all; form <= suit_test_comp_list; form++) {
+        size_t len_man = _suit_test_comp_manifest(SUIT_MAX_COMPONENTS,
+                form, test_comp_man, sizeof(test_comp_man));
+        zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+                "Failed to parse SUIT manifest.");
+        for (size_t i = 0; i < SUIT_MAX_COMPONENTS; i++) {
+            zassert_true(suit_get_size(ctx, i) == test_size,
+                    "Failed to apply parameters to component set.");
+            zassert_true(suit_vendor_id_is_match(ctx, i,
+                        test_vendor_id, sizeof(test_vendor_id)),
+                    "Failed to apply parameters to component set.");
+            zassert_true(suit_digest_is_match(ctx, i,
+                        test_digest, sizeof(test_digest)),
+                    "Failed to apply parameters to component set.");
+        }
+    }
+
+    /* one command for all components against one per component */
+    size_t counts[] = { 64, 256 };
+    for (int i = 0; i < ARRAY_SIZE(counts); i++) {
+        if (counts[i] > SUIT_MAX_COMPONENTS) {
+            printk("components %3u skipped, max is %u\n",
+                    counts[i], SUIT_MAX_COMPONENTS);
+            continue;
+        }
+        int forms[] = { suit_test_comp_all, suit_test_comp_repeat };
+        for (int f = 0; f < ARRAY_SIZE(forms); f++) {
+            size_t len_man = _suit_test_comp_manifest(counts[i], forms[f],
+                    test_comp_man, sizeof(test_comp_man));
+            uint32_t start = suit_bench_now();
+            for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++)
+                zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+                        "Failed to parse SUIT manifest.");
+            uint32_t cycles = suit_bench_now() - start;
+            zassert_true(suit_has_digest(ctx, counts[i] - 1),
+                    "Failed to apply parameters to component set.");
+            printk("components %3u %-8s %6u bytes %10u " SUIT_BENCH_UNIT "\n",
+                    counts[i], f ? "repeated" : "all",
+                    len_man, cycles / SUIT_TEST_BENCH_ROUNDS);
+        }
+    }
+}
+
+/* returns the number of parameter blocks in use */
+size_t _suit_test_param_blocks(suit_context_t * ctx)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < SUIT_MAX_PARAM_BLOCKS; i++)
+        if (ctx->params[i].refs) count++;
+    return count;
+}
+
+/* context size against one parameter copy per component */
+void test_suit_shared_params(void) {
+    suit_context_t * ctx = &test_comp_ctx;
+    size_t last = SUIT_MAX_COMPONENTS - 1;
+    uint8_t seq[32];
+    nanocbor_encoder_t nc;
+
+    /* identical parameters share a block, however they are set */
+    for (int form = suit_test_comp_repeat; 
+            form <= suit_test_comp_list; form++) {
+        size_t len_man = _suit_test_comp_manifest(SUIT_MAX_COMPONENTS,
+                form, test_comp_man, sizeof(test_comp_man));
+        zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+                "Failed to parse SUIT manifest.");
+        zassert_true(_suit_test_param_blocks(ctx) == 1,
+                "Failed to share parameter block.");
+    }
+
+    /* an override copies the block; overriding it back shares it again */
+    for (size_t size = 1; size <= test_size; size += test_size - 1) {
+        nanocbor_encoder_init(&nc, seq, sizeof(seq));
+        nanocbor_fmt_array(&nc, 8);
+        nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+        nanocbor_fmt_bool(&nc, true);
+        nanocbor_fmt_uint(&nc, suit_dir_set_params);
+        nanocbor_fmt_map(&nc, 1);
+        nanocbor_fmt_uint(&nc, suit_param_image_size);
+        nanocbor_fmt_uint(&nc, test_size);
+        nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+        nanocbor_fmt_uint(&nc, last);
+        nanocbor_fmt_uint(&nc, suit_dir_override_params);
+        nanocbor_fmt_map(&nc, 1);
+        nanocbor_fmt_uint(&nc, suit_param_image_size);
+        nanocbor_fmt_uint(&nc, size);
+        size_t len_man = _suit_test_comp_wrap(SUIT_MAX_COMPONENTS, 
+                seq, nanocbor_encoded_len(&nc), 
+                test_comp_man, sizeof(test_comp_man));
+        zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+                "Failed to parse SUIT manifest.");
+        zassert_true(suit_get_size(ctx, last) == size,
+                "Failed to override parameters.");
+        zassert_true(suit_get_size(ctx, 0) == test_size,
+                "Override changed a shared parameter block.");
+        zassert_true(_suit_test_param_blocks(ctx) == 
+                (size == test_size || last == 0 ? 1 : 2),
+                "Failed to copy parameter block on write.");
+    }
+
+    /* every component can have parameters of its own */
+    static uint8_t sizes[8 * 256 + 8];
+    nanocbor_encoder_init(&nc, sizes, sizeof(sizes));
+    nanocbor_fmt_array(&nc, 4 * SUIT_MAX_COMPONENTS);
+    for (size_t i = 0; i < SUIT_MAX_COMPONENTS; i++) {
+        nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+        nanocbor_fmt_uint(&nc, i);
+        nanocbor_fmt_uint(&nc, suit_dir_set_params);
+        nanocbor_fmt_map(&nc, 1);
+        nanocbor_fmt_uint(&nc, suit_param_image_size);
+        nanocbor_fmt_uint(&nc, i + 1);
+    }
+    size_t len_man = _suit_test_comp_wrap(SUIT_MAX_COMPONENTS,
+            sizes, nanocbor_encoded_len(&nc),
+            test_comp_man, sizeof(test_comp_man));
+    zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+            "Failed to parse distinct parameters per component.");
+    zassert_true(_suit_test_param_blocks(ctx) == SUIT_MAX_COMPONENTS
+            && suit_get_size(ctx, last) == SUIT_MAX_COMPONENTS,
+            "Distinct parameters parsed wrong.");
+
+    printk("context %6u bytes, parameters %6u bytes shared, "
+            "%6u bytes copied per component\n",
+            sizeof(suit_context_t), sizeof(ctx->params),
+            SUIT_MAX_COMPONENTS * sizeof(suit_params_t));
+}
+
+#define SUIT_TEST_CLASSES 16
+
+void test_suit_identity_match(void) {
+    suit_context_t * ctx = &test_comp_ctx;
+    size_t last = SUIT_MAX_COMPONENTS - 1;
+    uint32_t match[SUIT_MATCH_WORDS];
+
+    /* the device hosts many classes; the last component is another */
+    static uint8_t classes[SUIT_TEST_CLASSES][SUIT_UUID_LEN];
+    for (size_t i = 0; i < SUIT_TEST_CLASSES; i++) {
+        memcpy(classes[i], test_class_id, SUIT_UUID_LEN);
+        classes[i][SUIT_UUID_LEN - 1] ^= i;
+    }
+    uint8_t other[SUIT_UUID_LEN];
+    memcpy(other, test_class_id, SUIT_UUID_LEN);
+    other[0] ^= 0xff;
+
+    uint8_t seq[96];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 8);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_bool(&nc, true);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_param_vendor_id);
+    nanocbor_put_bstr(&nc, test_vendor_id, sizeof(test_vendor_id));
+    nanocbor_fmt_uint(&nc, suit_param_class_id);
+    nanocbor_put_bstr(&nc, classes[SUIT_TEST_CLASSES - 1], SUIT_UUID_LEN);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, last);
+    nanocbor_fmt_uint(&nc, suit_dir_override_params);
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_param_class_id);
+    nanocbor_put_bstr(&nc, other, sizeof(other));
+    size_t len_man = _suit_test_comp_wrap(SUIT_MAX_COMPONENTS, 
+            seq, nanocbor_encoded_len(&nc), 
+            test_comp_man, sizeof(test_comp_man));
+    zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+            "Failed to parse SUIT manifest.");
+
+    suit_identity_t id = {
+        .vendor_ids = test_vendor_id, .vendor_id_count = 1,
+        .class_ids = classes[0], .class_id_count = SUIT_TEST_CLASSES,
+        .device_ids = NULL, .device_id_count = 0,
+    };
+    zassert_false(suit_identity_match(ctx, &id, match),
+            "Matched a component of another class.");
+    for (size_t i = 0; i < SUIT_MAX_COMPONENTS; i++)
+        zassert_true(!!(match[i / 32] & BIT(i % 32)) == (i != last),
+                "Wrong component match bitmap.");
+
+    /* compare with one check per component and device class */
+    uint32_t start = suit_bench_now();
+    for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++)
+        suit_identity_match(ctx, &id, match);
+    uint32_t batch = suit_bench_now() - start;
+    start = suit_bench_now();
+    for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++) {
+        for (size_t i = 0; i < SUIT_MAX_COMPONENTS; i++) {
+            bool found = false;
+            for (size_t k = 0; k < SUIT_TEST_CLASSES && !found; k++)
+                found = suit_class_id_is_match(ctx, i, 
+                        classes[k], SUIT_UUID_LEN);
+            if (found && suit_vendor_id_is_match(ctx, i,
+                        test_vendor_id, sizeof(test_vendor_id)))
+                match[i / 32] |= BIT(i % 32);
+        }
+    }
+    uint32_t single = suit_bench_now() - start;
+    printk("identity %3u components %2u classes batch %10u " 
+            SUIT_BENCH_UNIT "\n",
+            SUIT_MAX_COMPONENTS, SUIT_TEST_CLASSES,
+            batch / SUIT_TEST_BENCH_ROUNDS);
+    printk("identity %3u components %2u classes each  %10u " 
+            SUIT_BENCH_UNIT "\n",
+            SUIT_MAX_COMPONENTS, SUIT_TEST_CLASSES,
+            single / SUIT_TEST_BENCH_ROUNDS);
+
+    /* a device ID in the manifest must be one of the device's */
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 4);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_bool(&nc, true);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_param_device_id);
+    nanocbor_put_bstr(&nc, other, sizeof(other));
+    len_man = _suit_test_comp_wrap(SUIT_MAX_COMPONENTS, 
+            seq, nanocbor_encoded_len(&nc), 
+            test_comp_man, sizeof(test_comp_man));
+    zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+            "Failed to parse SUIT manifest.");
+    zassert_false(suit_identity_match(ctx, &id, match),
+            "Matched an unknown device ID.");
+    id.device_ids = other; id.device_id_count = 1;
+    zassert_true(suit_identity_match(ctx, &id, match),
+            "Failed to match device ID.");
+}
+
+/* what an update handler was asked to do */
+struct suit_test_steps {
+    size_t fetch, copy, check_digest, run;
+    size_t size; /* sum over fetched, copied and checked images */
+};
+
+int _suit_test_fetch_image(void * arg, size_t idx,
+        const uint8_t * uri, size_t len_uri,
+        size_t size, suit_archive_alg_t archive_alg)
+{
+    struct suit_test_steps * steps = arg;
+    steps->fetch++; steps->size += size + len_uri;
+    return 0;
+}
+
+int _suit_test_copy_image(void * arg, size_t idx, size_t source,
+        size_t size)
+{
+    struct suit_test_steps * steps = arg;
+    steps->copy++; steps->size += size + source;
+    return 0;
+}
+
+int _suit_test_check_digest(void * arg, size_t idx,
+        suit_digest_alg_t digest_alg,
+        const uint8_t * digest, size_t len_digest, size_t size)
+{
+    struct suit_test_steps * steps = arg;
+    steps->check_digest++; steps->size += size;
+    return memcmp(digest, test_digest, len_digest) != 0;
+}
+
+int _suit_test_run_image(void * arg, size_t idx)
+{
+    struct suit_test_steps * steps = arg;
+    steps->run++;
+    return 0;
+}
+
+/* interprets a parsed manifest the way an update handler does today */
+int _suit_test_interpret(suit_context_t * ctx, 
+        const suit_plan_handler_t * h)
+{
+    const suit_identity_t * id = h->id;
+    for (size_t idx = 0; idx < suit_get_component_count(ctx); idx++) {
+        if (suit_has_vendor_id(ctx, idx) && !suit_vendor_id_is_match(
+                    ctx, idx, id->vendor_ids, SUIT_UUID_LEN))
+            return 1;
+        if (suit_has_class_id(ctx, idx) && !suit_class_id_is_match(
+                    ctx, idx, id->class_ids, SUIT_UUID_LEN))
+            return 1;
+        size_t size = suit_get_size(ctx, idx);
+        if (suit_has_uri(ctx, idx)) {
+            const uint8_t * uri; size_t len_uri;
+            suit_get_uri(ctx, idx, &uri, &len_uri);
+            if (h->fetch(h->arg, idx, uri, len_uri, size,
+                        suit_get_archive_alg(ctx, idx)))
+                return 1;
+        }
+        if (suit_has_source_component(ctx, idx)) {
+            size_t source = suit_get_source_component(ctx, idx) 
+                - ctx->components;
+            if (suit_must_swap(ctx, idx) 
+                    ? h->swap(h->arg, idx, source, size)
+                    : h->copy(h->arg, idx, source, size))
+                return 1;
+        }
+        if (suit_has_digest(ctx, idx)) {
+            suit_params_t * params = &ctx->params[ctx->components[idx].params];
+            if (h->check_digest(h->arg, idx, params->digest_alg, 
+                        params->digest, params->len_digest, size))
+                return 1;
+        }
+        if (suit_must_run(ctx, idx) && h->run(h->arg, idx))
+            return 1;
+    }
+    return 0;
+}
+
+static uint8_t test_plan[SUIT_PLAN_HDR_SIZE 
+        + 4 * SUIT_PLAN_STEP_SIZE * SUIT_MAX_COMPONENTS + 512
+        + SUIT_PLAN_TAG_SIZE];
+static const uint8_t test_plan_key[] = "zoot install plan secret";
+
+/* interpreting a manifest against replaying its plan */
+void test_suit_install_plan(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_COPY);
+    suit_context_t * ctx = &test_comp_ctx;
+    suit_identity_t id = {
+        .vendor_ids = test_vendor_id, .vendor_id_count = 1,
+        .class_ids = test_class_id, .class_id_count = 1,
+    };
+    struct suit_test_steps steps, expect;
+    suit_plan_handler_t handler = {
+        .arg = &steps, .id = &id,
+        .fetch = _suit_test_fetch_image,
+        .copy = _suit_test_copy_image,
+        .check_digest = _suit_test_check_digest,
+        .run = _suit_test_run_image,
+    };
+
+    /* replaying a plan does what interpreting its manifest does */
+    char * vectors[] = { SUIT_MANIFEST_3, SUIT_MANIFEST_4 };
+    for (int i = 0; i < ARRAY_SIZE(vectors); i++) {
+        size_t len_man = strlen(vectors[i]) / 2;
+        _xxd_r(vectors[i], test_comp_man);
+        zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+                "Failed to parse SUIT manifest.");
+        memset(&expect, 0, sizeof(expect));
+        handler.arg = &expect;
+        zassert_false(_suit_test_interpret(ctx, &handler),
+                "Failed to interpret SUIT manifest.");
+
+        size_t len_plan = sizeof(test_plan);
+        zassert_false(suit_plan_compile(ctx, test_plan_key, 
+                    sizeof(test_plan_key), test_plan, &len_plan),
+                "Failed to compile install plan.");
+        memset(test_comp_man, 0, len_man);
+        memset(&steps, 0, sizeof(steps));
+        handler.arg = &steps;
+        zassert_false(suit_plan_execute(test_plan, len_plan, 
+                    test_plan_key, sizeof(test_plan_key), &handler),
+                "Failed to execute install plan.");
+        zassert_false(memcmp(&steps, &expect, sizeof(steps)),
+                "Install plan differs from manifest.");
+        zassert_true(expect.fetch && expect.copy && expect.run,
+                "Manifest has no install steps.");
+
+        /* a plan from another device class fails */
+        id.class_ids = test_vendor_id;
+        zassert_true(suit_plan_execute(test_plan, len_plan, 
+                    test_plan_key, sizeof(test_plan_key), &handler),
+                "Executed a plan for another class.");
+        id.class_ids = test_class_id;
+
+        /* so does a plan tagged with another key */
+        zassert_true(suit_plan_execute(test_plan, len_plan, 
+                    test_plan_key + 1, sizeof(test_plan_key) - 1, &handler),
+                "Executed a plan tagged with another key.");
+
+        /* a damaged plan performs no steps */
+        memset(&steps, 0, sizeof(steps));
+        test_plan[SUIT_PLAN_HDR_SIZE + 10] = 0xff;
+        zassert_true(suit_plan_execute(test_plan, len_plan, 
+                    test_plan_key, sizeof(test_plan_key), &handler),
+                "Executed a damaged install plan.");
+        zassert_true(steps.fetch + steps.copy + steps.run == 0,
+                "Damaged install plan performed steps.");
+        zassert_true(suit_plan_execute(test_plan, len_plan - 1, 
+                    test_plan_key, sizeof(test_plan_key), &handler),
+                "Executed a truncated install plan.");
+    }
+
+    /* interpreting each time against compiling once and replaying */
+    size_t len_man = _suit_test_comp_manifest(SUIT_MAX_COMPONENTS,
+            suit_test_comp_repeat, test_comp_man, sizeof(test_comp_man));
+    size_t len_plan = sizeof(test_plan);
+    zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+            "Failed to parse SUIT manifest.");
+    zassert_false(suit_plan_compile(ctx, test_plan_key, 
+            sizeof(test_plan_key), test_plan, &len_plan),
+            "Failed to compile install plan.");
+
+    uint32_t start = suit_bench_now();
+    for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++) {
+        zassert_false(suit_parse_init(ctx, test_comp_man, len_man),
+                "Failed to parse SUIT manifest.");
+        zassert_false(_suit_test_interpret(ctx, &handler),
+                "Failed to interpret SUIT manifest.");
+    }
+    uint32_t interpret = suit_bench_now() - start;
+    start = suit_bench_now();
+    for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++)
+        zassert_false(suit_plan_execute(test_plan, len_plan, 
+                    test_plan_key, sizeof(test_plan_key), &handler),
+                "Failed to execute install plan.");
+    uint32_t replay = suit_bench_now() - start;
+    printk("plan %3u components interpret %6u bytes %10u " SUIT_BENCH_UNIT "\n",
+            SUIT_MAX_COMPONENTS, len_man, interpret / SUIT_TEST_BENCH_ROUNDS);
+    printk("plan %3u components replay    %6u bytes %10u " SUIT_BENCH_UNIT "\n",
+            SUIT_MAX_COMPONENTS, len_plan, replay / SUIT_TEST_BENCH_ROUNDS);
+}
+
+/* the order in which a plan asked for its steps, as (step, index) */
+struct suit_test_order {
+    uint8_t log[16];
+    size_t n;
+};
+
+void _suit_test_order_add(struct suit_test_order * o, uint8_t step, 
+        size_t idx)
+{
+    if (o->n + 2 <= sizeof(o->log)) {
+        o->log[o->n++] = step; o->log[o->n++] = idx;
+    }
+}
+
+int _suit_test_order_fetch(void * arg, size_t idx,
+        const uint8_t * uri, size_t len_uri,
+        size_t size, suit_archive_alg_t archive_alg)
+{
+    _suit_test_order_add(arg, suit_step_fetch, idx);
+    return 0;
+}
+
+int _suit_test_order_copy(void * arg, size_t idx, size_t source,
+        size_t size)
+{
+    _suit_test_order_add(arg, suit_step_copy, idx);
+    return 0;
+}
+
+int _suit_test_order_run(void * arg, size_t idx)
+{
+    _suit_test_order_add(arg, suit_step_run, idx);
+    return 0;
+}
+
+/* steps follow the SUIT phases across components, not one by one */
+void test_suit_plan_order(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_COPY);
+    suit_context_t * ctx = &test_comp_ctx;
+    uint8_t seq[96], man[256];
+    nanocbor_encoder_t nc;
+
+    /* component 0 is copied from and run after component 1 */
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 12);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, 0);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_param_source_comp);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_param_image_size);
+    nanocbor_fmt_uint(&nc, test_size);
+    nanocbor_fmt_uint(&nc, suit_dir_copy);
+    nanocbor_fmt_null(&nc);
+    nanocbor_fmt_uint(&nc, suit_dir_run);
+    nanocbor_fmt_null(&nc);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 3);
+    nanocbor_fmt_uint(&nc, suit_param_class_id);
+    nanocbor_put_bstr(&nc, test_class_id, sizeof(test_class_id));
+    nanocbor_fmt_uint(&nc, suit_param_uri);
+    nanocbor_put_tstr(&nc, "http://example.com/file.bin");
+    nanocbor_fmt_uint(&nc, suit_param_image_size);
+    nanocbor_fmt_uint(&nc, test_size);
+    nanocbor_fmt_uint(&nc, suit_dir_fetch);
+    nanocbor_fmt_null(&nc);
+    size_t len_man = _suit_test_comp_wrap(2, seq, 
+            nanocbor_encoded_len(&nc), man, sizeof(man));
+    zassert_false(suit_parse_init(ctx, man, len_man),
+            "Failed to parse SUIT manifest.");
+
+    size_t len_plan = sizeof(test_plan);
+    zassert_false(suit_plan_compile(ctx, test_plan_key, 
+            sizeof(test_plan_key), test_plan, &len_plan),
+            "Failed to compile install plan.");
+
+    suit_identity_t id = {
+        .class_ids = test_class_id, .class_id_count = 1,
+    };
+    struct suit_test_order order = { 0 };
+    suit_plan_handler_t handler = {
+        .arg = &order, .id = &id,
+        .fetch = _suit_test_order_fetch,
+        .copy = _suit_test_order_copy,
+        .run = _suit_test_order_run,
+    };
+    zassert_false(suit_plan_execute(test_plan, len_plan, 
+                test_plan_key, sizeof(test_plan_key), &handler),
+            "Failed to execute install plan.");
+    uint8_t expect[] = { 
+        suit_step_fetch, 1, suit_step_copy, 0, suit_step_run, 0,
+    };
+    zassert_true(order.n == sizeof(expect) 
+            && !memcmp(order.log, expect, sizeof(expect)),
+            "Steps out of order.");
+
+    /* a failing identity check on component 1 stops component 0 too */
+    memset(&order, 0, sizeof(order));
+    id.class_ids = test_vendor_id;
+    zassert_true(suit_plan_execute(test_plan, len_plan, 
+                test_plan_key, sizeof(test_plan_key), &handler),
+            "Executed a plan for another class.");
+    zassert_true(order.n == 0, 
+            "Performed steps before every identity was checked.");
+}
+
+void test_suit_integrated_payload(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_ES256);
+    suit_context_t * ctx = &test_comp_ctx;
+    uint8_t payload[200], digest[32];
+    for (size_t i = 0; i < sizeof(payload); i++)
+        payload[i] = i * 7;
+    mbedtls_sha256_ret(payload, sizeof(payload), digest, 0);
+
+    /* the component names an integrated payload as its URI */
+    const char * key = "#image";
+    uint8_t seq[96], man[128];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 4);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, 0);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 3);
+    nanocbor_fmt_uint(&nc, suit_param_uri);
+    nanocbor_put_tstr(&nc, key);
+    nanocbor_fmt_uint(&nc, suit_param_image_digest);
+    nanocbor_fmt_array(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+    nanocbor_put_bstr(&nc, digest, sizeof(digest));
+    nanocbor_fmt_uint(&nc, suit_param_image_size);
+    nanocbor_fmt_uint(&nc, sizeof(payload));
+    size_t len_man = _suit_test_comp_wrap(1, seq, 
+            nanocbor_encoded_len(&nc), man, sizeof(man));
+
+    /* sign it, then add the payload to the envelope */
+    uint8_t env[512];
+    size_t len_env = sizeof(env);
+    zassert_false(suit_manifest_wrap(pem_prv, man, len_man, env, &len_env),
+            "Failed to write manifest envelope.");
+    size_t len_signed = len_env;
+    zassert_true(env[0] == 0xa2, "Unexpected envelope.");
+    env[0] = 0xa3;
+    nanocbor_encoder_init(&nc, env + len_env, sizeof(env) - len_env);
+    nanocbor_put_tstr(&nc, key);
+    nanocbor_put_bstr(&nc, payload, sizeof(payload));
+    len_env += nanocbor_encoded_len(&nc);
+
+    const uint8_t * man_out; size_t len_man_out;
+    zassert_false(suit_manifest_unwrap(pem_pub, env, len_env,
+                &man_out, &len_man_out),
+            "Failed to authenticate envelope contents.");
+    zassert_false(suit_parse_init(ctx, man_out, len_man_out),
+            "Failed to parse SUIT manifest.");
+    zassert_false(suit_resolve_payloads(ctx, env, len_env),
+            "Failed to resolve integrated payload.");
+
+    /* the payload is a view into the envelope */
+    const uint8_t * pld; size_t len_pld;
+    zassert_true(suit_has_payload(ctx, 0), "Missing integrated payload.");
+    suit_get_payload(ctx, 0, &pld, &len_pld);
+    zassert_true(len_pld == sizeof(payload) && pld > env 
+            && pld + len_pld == env + len_env,
+            "Integrated payload is not a view into the envelope.");
+    zassert_false(memcmp(pld, payload, len_pld),
+            "Integrated payload differs.");
+
+    /* a modified payload does not match the digest */
+    env[len_env - 1] ^= 1;
+    zassert_true(suit_resolve_payloads(ctx, env, len_env),
+            "Accepted a modified integrated payload.");
+    zassert_false(suit_has_payload(ctx, 0), 
+            "Kept a modified integrated payload.");
+    env[len_env - 1] ^= 1;
+
+    /* and a payload missing from the envelope is an error */
+    env[0] = 0xa2;
+    zassert_true(suit_resolve_payloads(ctx, env, len_signed),
+            "Accepted a missing integrated payload.");
+}
+
+/*
+ * Stand-ins for the servers of an image: a peer cache, a CDN, a slow
+ * mirror and a mirror that is down. Each range costs a fixed delay.
+ */
+struct suit_test_server {
+    const char * uri;
+    uint32_t usec;  /* per range */
+    bool down;
+};
+
+static const struct suit_test_server test_servers[] = {
+    { "coap://peer/fw", 20, false },
+    { "https://cdn/fw", 80, false },
+    { "https://mirror/fw", 320, false },
+    { "https://down/fw", 0, true },
+};
+
+struct suit_test_origin {
+    const uint8_t * image;
+    bool corrupt;   /* the peer serves a modified image */
+};
+
+int _suit_test_get_range(void * arg, const uint8_t * uri, size_t len_uri,
+        size_t offset, uint8_t * buf, size_t len)
+{
+    struct suit_test_origin * origin = arg;
+    for (size_t i = 0; i < ARRAY_SIZE(test_servers); i++) {
+        const struct suit_test_server * srv = &test_servers[i];
+        if (len_uri != strlen(srv->uri) || memcmp(uri, srv->uri, len_uri))
+            continue;
+        if (srv->down) return 1;
+        k_busy_wait(srv->usec);
+        memcpy(buf, origin->image + offset, len);
+        if (origin->corrupt && i == 0) buf[0] ^= 1;
+        return 0;
+    }
+    return 1;
+}
+
+/* 
+ * A try-each directive naming the peer first and the CDN second, and
+ * block digests if root is not NULL.
+ */
+size_t _suit_test_fetch_manifest(const uint8_t * digest, size_t size,
+        const uint8_t * root, size_t block_size,
+        uint8_t * man, size_t size_man)
+{
+    uint8_t alts[2][32], seq[192];
+    size_t len_alts[2];
+    nanocbor_encoder_t nc;
+    for (size_t i = 0; i < 2; i++) {
+        nanocbor_encoder_init(&nc, alts[i], sizeof(alts[i]));
+        nanocbor_fmt_array(&nc, 2);
+        nanocbor_fmt_uint(&nc, suit_dir_set_params);
+        nanocbor_fmt_map(&nc, 1);
+        nanocbor_fmt_uint(&nc, suit_param_uri);
+        nanocbor_put_tstr(&nc, test_servers[i].uri);
+        len_alts[i] = nanocbor_encoded_len(&nc);
+    }
+
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 6);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, 0);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, root ? 3 : 2);
+    nanocbor_fmt_uint(&nc, suit_param_image_digest);
+    nanocbor_fmt_array(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+    nanocbor_put_bstr(&nc, digest, 32);
+    nanocbor_fmt_uint(&nc, suit_param_image_size);
+    nanocbor_fmt_uint(&nc, size);
+    if (root) {
+        nanocbor_fmt_uint(&nc, suit_param_block_digest);
+        nanocbor_fmt_array(&nc, 3);
+        nanocbor_fmt_uint(&nc, block_size);
+        nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+        nanocbor_put_bstr(&nc, root, SUIT_MERKLE_HASH_SIZE);
+    }
+    nanocbor_fmt_uint(&nc, suit_dir_try_each);
+    nanocbor_fmt_array(&nc, 2);
+    for (size_t i = 0; i < 2; i++)
+        nanocbor_put_bstr(&nc, alts[i], len_alts[i]);
+    return _suit_test_comp_wrap(1, seq, nanocbor_encoded_len(&nc),
+            man, size_man);
+}
+
+static uint8_t test_fetch_image[16384];
+static uint8_t test_fetch_buf[sizeof(test_fetch_image)];
+static suit_fetcher_t test_fetcher;
+
+void test_suit_fetch_sources(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_TRY_EACH);
+    suit_context_t * ctx = &test_comp_ctx;
+    suit_fetcher_t * f = &test_fetcher;
+    uint8_t digest[32], man[256];
+    for (size_t i = 0; i < sizeof(test_fetch_image); i++)
+        test_fetch_image[i] = i * 13 + (i >> 8);
+    mbedtls_sha256_ret(test_fetch_image, sizeof(test_fetch_image), 
+            digest, 0);
+    size_t len_man = _suit_test_fetch_manifest(digest, 
+            sizeof(test_fetch_image), NULL, 0, man, sizeof(man));
+    zassert_false(suit_parse_init(ctx, man, len_man),
+            "Failed to parse SUIT manifest.");
+
+    /* the first alternative is taken, the second kept as a mirror */
+    const uint8_t * uri; size_t len_uri;
+    suit_get_uri(ctx, 0, &uri, &len_uri);
+    zassert_true(len_uri == strlen(test_servers[0].uri)
+            && !memcmp(uri, test_servers[0].uri, len_uri),
+            "Unexpected component URI.");
+    zassert_true(suit_get_uri_alt_count(ctx, 0) == 1,
+            "Unexpected number of alternative URIs.");
+    suit_get_uri_alt(ctx, 0, 0, &uri, &len_uri);
+    zassert_true(len_uri == strlen(test_servers[1].uri)
+            && !memcmp(uri, test_servers[1].uri, len_uri),
+            "Unexpected alternative URI.");
+
+    struct suit_test_origin origin = { .image = test_fetch_image };
+    suit_fetcher_init(f, _suit_test_get_range, &origin, 1024, 0);
+    zassert_false(suit_fetcher_add_component(f, ctx, 0),
+            "Failed to add component sources.");
+    for (size_t i = 2; i < ARRAY_SIZE(test_servers); i++)
+        zassert_false(suit_fetcher_add_source(f, 
+                    (const uint8_t *) test_servers[i].uri,
+                    strlen(test_servers[i].uri)),
+                "Failed to add mirror.");
+    zassert_true(f->source_count == ARRAY_SIZE(test_servers),
+            "Unexpected number of sources.");
+
+    zassert_false(suit_fetch_image(f, ctx, 0, 
+                test_fetch_buf, sizeof(test_fetch_buf)),
+            "Failed to fetch image.");
+    zassert_false(memcmp(test_fetch_buf, test_fetch_image, 
+                sizeof(test_fetch_image)),
+            "Fetched image differs.");
+
+    for (size_t i = 0; i < f->source_count; i++) {
+        suit_source_t * src = &f->sources[i];
+        printk("fetch %-18.*s %6u bytes %10u cycles/KiB %u failures\n",
+                src->len_uri, src->uri, src->bytes, 
+                src->bytes ? (uint32_t) (src->cycles * 1024 / src->bytes)
+                : 0, src->failures);
+    }
+    zassert_true(f->sources[3].bytes == 0 && f->sources[3].failures > 0,
+            "Fetched from a source that is down.");
+    zassert_true(f->sources[0].bytes > f->sources[2].bytes,
+            "Slow mirror served more than the peer.");
+
+    /* a source serving a modified image fails the digest check */
+    origin.corrupt = true;
+    zassert_true(suit_fetch_image(f, ctx, 0, 
+                test_fetch_buf, sizeof(test_fetch_buf)),
+            "Accepted a modified image.");
+    origin.corrupt = false;
+
+    /* as does an image that does not fit the buffer */
+    zassert_true(suit_fetch_image(f, ctx, 0, 
+                test_fetch_buf, sizeof(test_fetch_buf) - 1),
+            "Fetched an image into a short buffer.");
+
+    /* a source that failed during one image is tried for the next */
+    suit_fetcher_init(f, _suit_test_get_range, &origin, 1024, 0);
+    zassert_false(suit_fetcher_add_source(f, 
+                (const uint8_t *) test_servers[0].uri,
+                strlen(test_servers[0].uri)),
+            "Failed to add source.");
+    f->sources[0].failures = SUIT_FETCH_MAX_FAILURES;
+    zassert_false(suit_fetch_image(f, ctx, 0, 
+                test_fetch_buf, sizeof(test_fetch_buf)),
+            "Source skipped after failures during an earlier image.");
+}
+
+/*
+ * Installs test_fetch_image into the image-1 area in chunks, keeping
+ * the journal, and stops as if power was lost once stop bytes are 
+ * written. The flash simulator of native_posix keeps its contents in
+ * a host file.
+ */
+static uint8_t test_chunk[1000];
+
+int _suit_test_install(suit_journal_t * j, suit_context_t * ctx,
+        const uint8_t * manifest, size_t stop, size_t * resumed)
+{
+    const struct flash_area * img;
+    suit_progress_t progress;
+    if (flash_area_open(FLASH_AREA_ID(image_1), &img)) return 1;
+    if (suit_journal_begin(j, manifest, 0, &progress)) return 0;
+    *resumed = progress.offset;
+    if (progress.offset == 0 
+            && flash_area_erase(img, 0, sizeof(test_fetch_image)))
+        return 1;
+
+    while (progress.offset < sizeof(test_fetch_image)) {
+        if (progress.offset >= stop) return 2;
+        size_t len = MIN(sizeof(test_chunk), 
+                sizeof(test_fetch_image) - progress.offset);
+        memcpy(test_chunk, test_fetch_image + progress.offset, len);
+        if (flash_area_write(img, progress.offset, test_chunk, len))
+            return 1;
+        if (suit_journal_update(j, &progress, test_chunk, len)) return 1;
+    }
+    return suit_journal_finish(j, ctx, &progress);
+}
+
+void test_suit_journal_resume(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_TRY_EACH);
+    suit_context_t * ctx = &test_comp_ctx;
+    const struct flash_area * fa, * img;
+    suit_journal_t j;
+    uint8_t digest[32], manifest[32], man[256];
+    size_t resumed = 0;
+    for (size_t i = 0; i < sizeof(test_fetch_image); i++)
+        test_fetch_image[i] = i * 29 + (i >> 9);
+    mbedtls_sha256_ret(test_fetch_image, sizeof(test_fetch_image), 
+            digest, 0);
+    size_t len_man = _suit_test_fetch_manifest(digest, 
+            sizeof(test_fetch_image), NULL, 0, man, sizeof(man));
+    mbedtls_sha256_ret(man, len_man, manifest, 0);
+    zassert_false(suit_parse_init(ctx, man, len_man),
+            "Failed to parse SUIT manifest.");
+    zassert_false(flash_area_open(FLASH_AREA_ID(storage), &fa),
+            "Failed to open journal area.");
+    zassert_false(flash_area_erase(fa, 0, fa->fa_size),
+            "Failed to erase journal area.");
+
+    /* power is lost after 10000 bytes, while a record is written */
+    zassert_false(suit_journal_init(&j, fa, 4096),
+            "Failed to open journal.");
+    zassert_true(_suit_test_install(&j, ctx, manifest, 10000, 
+                &resumed) == 2, "Install was not interrupted.");
+    memset(test_chunk, 0, SUIT_JOURNAL_RECORD_SIZE / 2);
+    zassert_false(flash_area_write(fa, j.half * (fa->fa_size / 2) 
+                + j.slot * SUIT_JOURNAL_RECORD_SIZE, test_chunk, 
+                SUIT_JOURNAL_RECORD_SIZE / 2),
+            "Failed to tear journal record.");
+    memset(&j, 0xa5, sizeof(j));
+
+    /* the install resumes at the last checkpoint */
+    zassert_false(suit_journal_init(&j, fa, 4096),
+            "Failed to reopen journal.");
+    zassert_false(_suit_test_install(&j, ctx, manifest, SIZE_MAX, 
+                &resumed), "Failed to resume install.");
+    zassert_true(resumed == 8192, "Resumed at %u bytes.", resumed);
+    zassert_false(flash_area_open(FLASH_AREA_ID(image_1), &img),
+            "Failed to open image area.");
+    for (size_t off = 0; off < sizeof(test_fetch_image); 
+            off += sizeof(test_chunk)) {
+        size_t len = MIN(sizeof(test_chunk), 
+                sizeof(test_fetch_image) - off);
+        zassert_false(flash_area_read(img, off, test_chunk, len),
+                "Failed to read image.");
+        zassert_false(memcmp(test_chunk, test_fetch_image + off, len),
+                "Installed image differs.");
+    }
+    printk("journal resumed at %u of %u bytes\n", 
+            resumed, sizeof(test_fetch_image));
+
+    /* an installed component is not installed again */
+    suit_progress_t progress;
+    zassert_false(suit_journal_init(&j, fa, 4096),
+            "Failed to reopen journal.");
+    zassert_true(suit_journal_begin(&j, manifest, 0, &progress),
+            "Installed component not recorded.");
+    zassert_false(suit_journal_begin(&j, manifest, 1, &progress)
+            || progress.offset != 0, "Next component not started.");
+
+    /* progress of another manifest is not used */
+    manifest[0] ^= 1;
+    zassert_false(suit_journal_begin(&j, manifest, 0, &progress)
+            || progress.offset != 0, "Resumed another manifest.");
+    manifest[0] ^= 1;
+    zassert_false(suit_journal_reset(&j), "Failed to reset journal.");
+    zassert_false(suit_journal_begin(&j, manifest, 0, &progress)
+            || progress.offset != 0, "Reset journal resumed.");
+
+    /* 
+     * Checkpoints every 64 bytes fill both halves of the area several
+     * times over; an install interrupted late still resumes.
+     */
+    zassert_false(suit_journal_init(&j, fa, 64),
+            "Failed to open journal.");
+    zassert_true(_suit_test_install(&j, ctx, manifest, 12345, 
+                &resumed) == 2, "Install was not interrupted.");
+    zassert_false(suit_journal_init(&j, fa, 64),
+            "Failed to reopen journal.");
+    zassert_false(_suit_test_install(&j, ctx, manifest, SIZE_MAX, 
+                &resumed), "Failed to resume install.");
+    zassert_true(resumed == 12992, "Resumed at %u bytes.", resumed);
+}
+
+/*
+ * Flash costs of an nRF52840, used to estimate the time an install
+ * takes: erasing a 4 KiB page takes 85 ms, programming a word 41 us.
+ */
+#define SUIT_TEST_PAGE_SIZE 4096
+#define SUIT_TEST_ERASE_US 85000
+#define SUIT_TEST_WORD_US 41
+#define SUIT_TEST_IMAGE_PAGES 16
+
+static uint8_t test_page[SUIT_TEST_PAGE_SIZE];
+
+/* version 2 of the image differs in pages 3, 10 and 11 */
+uint8_t _suit_test_image_byte(size_t i, int version)
+{
+    uint8_t b = i * 31 + (i >> 10);
+    if (version == 2 && ((i >= 3 * SUIT_TEST_PAGE_SIZE + 100 
+                    && i < 3 * SUIT_TEST_PAGE_SIZE + 200)
+                || (i >= 11 * SUIT_TEST_PAGE_SIZE - 96 
+                    && i < 11 * SUIT_TEST_PAGE_SIZE + 10)))
+        b ^= 0x5a;
+    return b;
+}
+
+/* writes an image in chunks of uneven size, as a transport would */
+int _suit_test_write_image(suit_writer_t * w, int version)
+{
+    size_t size = SUIT_TEST_IMAGE_PAGES * SUIT_TEST_PAGE_SIZE;
+    for (size_t off = 0, k = 0; off < size; k++) {
+        size_t len = MIN(1 + (k * 577) % sizeof(test_chunk), size - off);
+        for (size_t i = 0; i < len; i++)
+            test_chunk[i] = _suit_test_image_byte(off + i, version);
+        if (suit_writer_write(w, test_chunk, len)) return 1;
+        off += len;
+    }
+    return suit_writer_flush(w);
+}
+
+void test_suit_flash_writer(void) {
+    const struct flash_area * img;
+    suit_writer_t w;
+    size_t size = SUIT_TEST_IMAGE_PAGES * SUIT_TEST_PAGE_SIZE;
+    zassert_false(flash_area_open(FLASH_AREA_ID(image_1), &img),
+            "Failed to open image area.");
+    zassert_false(flash_area_erase(img, 0, size),
+            "Failed to erase image area.");
+
+    /* 
+     * A blank area is written without erasing, an update erases the
+     * pages that change and a repeated install writes nothing.
+     */
+    static const struct {
+        int version;
+        size_t erased, skipped;
+    } runs[] = { { 1, 0, 0 }, { 2, 3, 13 }, { 2, 0, 16 } };
+    for (size_t r = 0; r < ARRAY_SIZE(runs); r++) {
+        zassert_false(suit_writer_init(&w, img, 0, 
+                    test_page, sizeof(test_page)),
+                "Failed to initialize writer.");
+        zassert_false(_suit_test_write_image(&w, runs[r].version),
+                "Failed to write image.");
+        suit_writer_stats_t * st = &w.stats;
+        zassert_true(st->bytes == size 
+                && st->pages == SUIT_TEST_IMAGE_PAGES
+                && st->pages_erased == runs[r].erased
+                && st->pages_skipped == runs[r].skipped,
+                "Unexpected writer stats.");
+        zassert_true(st->bytes_written == (SUIT_TEST_IMAGE_PAGES 
+                    - st->pages_skipped) * SUIT_TEST_PAGE_SIZE,
+                "Unexpected number of bytes written.");
+
+        for (size_t off = 0; off < size; off += sizeof(test_chunk)) {
+            size_t len = MIN(sizeof(test_chunk), size - off);
+            zassert_false(flash_area_read(img, off, test_chunk, len),
+                    "Failed to read image.");
+            for (size_t i = 0; i < len; i++)
+                zassert_true(test_chunk[i] == _suit_test_image_byte(off 
+                            + i, runs[r].version), "Image differs.");
+        }
+
+        /* 
+         * Writing each chunk as it arrives erases every page and 
+         * programs every byte.
+         */
+        uint32_t naive = SUIT_TEST_IMAGE_PAGES * SUIT_TEST_ERASE_US 
+            + size / 4 * SUIT_TEST_WORD_US;
+        uint32_t paged = st->pages_erased * SUIT_TEST_ERASE_US
+            + st->bytes_written / 4 * SUIT_TEST_WORD_US;
+        printk("writer v%d %2u pages %2u erased %2u skipped %6u bytes "
+                "%5u ms, %5u ms saved\n", runs[r].version, st->pages,
+                st->pages_erased, st->pages_skipped, st->bytes_written,
+                paged / 1000, (naive - paged) / 1000);
+    }
+
+    /* writing resumes in the middle of a page */
+    zassert_false(suit_writer_init(&w, img, 5000, 
+                test_page, sizeof(test_page)),
+            "Failed to initialize writer.");
+    zassert_true(w.fill == 5000 - SUIT_TEST_PAGE_SIZE 
+            && test_page[0] == _suit_test_image_byte(SUIT_TEST_PAGE_SIZE, 
+                2), "Page start not read back.");
+
+    /* and stops at the end of the area */
+    zassert_false(suit_writer_init(&w, img, img->fa_size - 10, 
+                test_page, sizeof(test_page)),
+            "Failed to initialize writer.");
+    zassert_true(suit_writer_write(&w, test_chunk, 11),
+            "Wrote past the end of the area.");
+}
+
+#define SUIT_TEST_BLOCK_SIZE 1024
+#define SUIT_TEST_BLOCKS (sizeof(test_fetch_image) / SUIT_TEST_BLOCK_SIZE)
+
+static uint8_t test_leaves[SUIT_TEST_BLOCKS * SUIT_MERKLE_HASH_SIZE];
+
+void test_suit_block_digests(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_TRY_EACH);
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_BLOCK_DIGEST);
+    suit_context_t * ctx = &test_comp_ctx;
+    suit_merkle_t m;
+    uint8_t digest[32], root[32], man[320];
+    ATOMIC_DEFINE(bad, SUIT_TEST_BLOCKS);
+
+    /* three leaves: the first two are joined, then the third */
+    uint8_t node[32], expect[32], one = 0x01;
+    mbedtls_sha256_context sha;
+    for (size_t i = 0; i < 3 * SUIT_MERKLE_HASH_SIZE; i++)
+        test_leaves[i] = i;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    mbedtls_sha256_update_ret(&sha, &one, 1);
+    mbedtls_sha256_update_ret(&sha, test_leaves, 64);
+    mbedtls_sha256_finish_ret(&sha, node);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    mbedtls_sha256_update_ret(&sha, &one, 1);
+    mbedtls_sha256_update_ret(&sha, node, 32);
+    mbedtls_sha256_update_ret(&sha, test_leaves + 64, 32);
+    mbedtls_sha256_finish_ret(&sha, expect);
+    zassert_false(suit_merkle_root(test_leaves, 3, root),
+            "Failed to compute Merkle root.");
+    zassert_false(memcmp(root, expect, sizeof(root)),
+            "Unexpected Merkle tree shape.");
+
+    /* leaves travel with the image, the root in the manifest */
+    for (size_t i = 0; i < sizeof(test_fetch_image); i++)
+        test_fetch_image[i] = i * 17 + (i >> 7);
+    for (size_t b = 0; b < SUIT_TEST_BLOCKS; b++)
+        suit_merkle_leaf(test_fetch_image + b * SUIT_TEST_BLOCK_SIZE,
+                SUIT_TEST_BLOCK_SIZE, 
+                test_leaves + b * SUIT_MERKLE_HASH_SIZE);
+    zassert_false(suit_merkle_root(test_leaves, SUIT_TEST_BLOCKS, root),
+            "Failed to compute Merkle root.");
+    mbedtls_sha256_ret(test_fetch_image, sizeof(test_fetch_image), 
+            digest, 0);
+    size_t len_man = _suit_test_fetch_manifest(digest, 
+            sizeof(test_fetch_image), root, SUIT_TEST_BLOCK_SIZE, 
+            man, sizeof(man));
+    zassert_false(suit_parse_init(ctx, man, len_man),
+            "Failed to parse SUIT manifest.");
+    zassert_true(suit_has_block_digest(ctx, 0), "Missing block digests.");
+
+    test_leaves[40] ^= 1;
+    zassert_true(suit_merkle_init(&m, ctx, 0, test_leaves, 
+                sizeof(test_leaves)), "Accepted modified leaves.");
+    test_leaves[40] ^= 1;
+    zassert_true(suit_merkle_init(&m, ctx, 0, test_leaves, 
+                sizeof(test_leaves) - SUIT_MERKLE_HASH_SIZE), 
+            "Accepted missing leaves.");
+    zassert_false(suit_merkle_init(&m, ctx, 0, test_leaves, 
+                sizeof(test_leaves)), "Failed to check leaves.");
+
+    /* throughput by number of threads, against one image digest */
+    uint32_t start = suit_bench_now();
+    for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++)
+        mbedtls_sha256_ret(test_fetch_image, sizeof(test_fetch_image), 
+                digest, 0);
+    printk("digest  image            %6u bytes %10u " SUIT_BENCH_UNIT "\n",
+            sizeof(test_fetch_image), 
+            (suit_bench_now() - start) / SUIT_TEST_BENCH_ROUNDS);
+    for (size_t t = 1; t <= CONFIG_ZOOT_WORKER_THREADS + 1; t++) {
+        start = suit_bench_now();
+        for (int j = 0; j < SUIT_TEST_BENCH_ROUNDS; j++)
+            zassert_false(suit_merkle_check_image(&m, test_fetch_image,
+                        t, bad), "Image does not match.");
+        printk("merkle  %u threads %2u blocks %6u bytes %10u " 
+                SUIT_BENCH_UNIT "\n",
+                t, m.block_count, m.size, 
+                (suit_bench_now() - start) / SUIT_TEST_BENCH_ROUNDS);
+    }
+
+    /* bad blocks are found wherever they are */
+    memcpy(test_fetch_buf, test_fetch_image, sizeof(test_fetch_image));
+    static const size_t corrupt[] = { 2, 7, SUIT_TEST_BLOCKS - 1 };
+    for (size_t i = 0; i < ARRAY_SIZE(corrupt); i++)
+        test_fetch_buf[corrupt[i] * SUIT_TEST_BLOCK_SIZE + 100] ^= 1;
+    zassert_true(suit_merkle_check_image(&m, test_fetch_buf, 0, bad)
+            == ARRAY_SIZE(corrupt), "Unexpected number of bad blocks.");
+    for (size_t i = 0; i < ARRAY_SIZE(corrupt); i++)
+        zassert_true(atomic_test_bit(bad, corrupt[i]), 
+                "Bad block not found.");
+
+    /* 
+     * A source serving bad blocks costs those blocks only, instead of
+     * the whole image once its digest fails.
+     */
+    suit_fetcher_t * f = &test_fetcher;
+    struct suit_test_origin origin = { 
+        .image = test_fetch_image, .corrupt = true };
+    suit_fetcher_init(f, _suit_test_get_range, &origin, 
+            SUIT_TEST_BLOCK_SIZE, 0);
+    f->merkle = &m;
+    zassert_false(suit_fetcher_add_component(f, ctx, 0),
+            "Failed to add component sources.");
+    memset(test_fetch_buf, 0, sizeof(test_fetch_buf));
+    zassert_false(suit_fetch_image(f, ctx, 0, 
+                test_fetch_buf, sizeof(test_fetch_buf)),
+            "Failed to fetch image.");
+    zassert_false(memcmp(test_fetch_buf, test_fetch_image, 
+                sizeof(test_fetch_image)), "Fetched image differs.");
+    /* 
+     * While its first range is being checked, the other source may 
+     * serve all the rest, so the bad one fails at least once and at 
+     * most once per thread beyond the limit.
+     */
+    zassert_true(f->sources[0].failures > 0 && f->sources[0].failures
+            < SUIT_FETCH_MAX_FAILURES + CONFIG_ZOOT_WORKER_THREADS + 1
+            && f->sources[0].bytes == 0, "Bad source not dropped.");
+    printk("merkle  refetched %6u bytes, %6u without block digests\n",
+            f->sources[0].failures * SUIT_TEST_BLOCK_SIZE, 
+            sizeof(test_fetch_image));
+}
+
+/*
+ * Simulated flash holding two slots and a spare sector, with the 
+ * flash costs above. Power is lost once budget operations are done.
+ */
+#define SUIT_TEST_SWAP_SECTORS 4
+#define SUIT_TEST_SLOT_SIZE (SUIT_TEST_SWAP_SECTORS * SUIT_TEST_PAGE_SIZE)
+
+struct suit_test_flash {
+    uint8_t slots[2][SUIT_TEST_SLOT_SIZE];
+    uint8_t spare[SUIT_TEST_PAGE_SIZE];
+    uint16_t erases[2 * SUIT_TEST_SWAP_SECTORS + 1];
+    uint32_t us;        /* estimated time */
+    size_t ops, budget; /* power is lost after budget operations */
+    bool saved;
+    suit_swap_status_t status;
+    uint8_t map[2];     /* slot holding each component */
+    uint32_t dma_start, dma_us;
+    int dma_err;
+    bool stuck;         /* writes leave a bit set to 0 */
+};
+
+static struct suit_test_flash test_flash;
+
+uint8_t * _suit_test_flash_at(struct suit_test_flash * fl, size_t idx,
+        size_t offset, size_t len)
+{
+    if (idx == SUIT_STORAGE_SPARE)
+        return offset + len <= sizeof(fl->spare) ? fl->spare + offset 
+            : NULL;
+    if (idx > 1 || offset + len > SUIT_TEST_SLOT_SIZE) return NULL;
+    return fl->slots[fl->map[idx]] + offset;
+}
+
+int _suit_test_flash_op(struct suit_test_flash * fl)
+{
+    if (fl->budget && fl->ops == fl->budget) return 1;
+    fl->ops++;
+    return 0;
+}
+
+int _suit_test_flash_read(void * arg, size_t idx, size_t offset,
+        uint8_t * buf, size_t len)
+{
+    uint8_t * p = _suit_test_flash_at(arg, idx, offset, len);
+    if (!p || _suit_test_flash_op(arg)) return 1;
+    memcpy(buf, p, len);
+    return 0;
+}
+
+int _suit_test_flash_write(void * arg, size_t idx, size_t offset,
+        const uint8_t * buf, size_t len)
+{
+    struct suit_test_flash * fl = arg;
+    uint8_t * p = _suit_test_flash_at(fl, idx, offset, len);
+    if (!p || _suit_test_flash_op(fl)) return 1;
+    for (size_t i = 0; i < len; i++) {
+        if ((p[i] & buf[i]) != buf[i]) return 1;
+        p[i] = buf[i];
+    }
+    if (fl->stuck) p[len - 1] &= ~1;
+    fl->us += (len + 3) / 4 * SUIT_TEST_WORD_US;
+    return 0;
+}
+
+int _suit_test_flash_erase(void * arg, size_t idx, size_t offset)
+{
+    struct suit_test_flash * fl = arg;
+    uint8_t * p = _suit_test_flash_at(fl, idx, offset, SUIT_TEST_PAGE_SIZE);
+    if (!p || offset % SUIT_TEST_PAGE_SIZE || _suit_test_flash_op(fl)) 
+        return 1;
+    memset(p, 0xff, SUIT_TEST_PAGE_SIZE);
+    fl->erases[idx == SUIT_STORAGE_SPARE ? 2 * SUIT_TEST_SWAP_SECTORS
+        : idx * SUIT_TEST_SWAP_SECTORS + offset / SUIT_TEST_PAGE_SIZE]++;
+    fl->us += SUIT_TEST_ERASE_US;
+    return 0;
+}
+
+int _suit_test_flash_save(void * arg, const suit_swap_status_t * status)
+{
+    struct suit_test_flash * fl = arg;
+    if (_suit_test_flash_op(fl)) return 1;
+    fl->saved = (status != NULL);
+    if (status) fl->status = *status;
+    return 0;
+}
+
+int _suit_test_flash_load(void * arg, suit_swap_status_t * status)
+{
+    struct suit_test_flash * fl = arg;
+    if (!fl->saved) return 1;
+    *status = fl->status;
+    return 0;
+}
+
+static const suit_storage_t test_storage = {
+    .arg = &test_flash,
+    .sector_size = SUIT_TEST_PAGE_SIZE,
+    .read = _suit_test_flash_read,
+    .write = _suit_test_flash_write,
+    .erase = _suit_test_flash_erase,
+    .save = _suit_test_flash_save,
+    .load = _suit_test_flash_load,
+};
+
+void _suit_test_flash_reset(struct suit_test_flash * fl)
+{
+    memset(fl, 0, sizeof(*fl));
+    for (size_t i = 0; i < SUIT_TEST_SLOT_SIZE; i++) {
+        fl->slots[0][i] = i * 7;
+        fl->slots[1][i] = i * 11 + 1;
+    }
+    memset(fl->spare, 0x3c, sizeof(fl->spare));
+    fl->map[1] = 1;
+}
+
+bool _suit_test_flash_is_swapped(struct suit_test_flash * fl)
+{
+    for (size_t i = 0; i < SUIT_TEST_SLOT_SIZE; i++)
+        if (fl->slots[0][i] != (uint8_t) (i * 11 + 1) 
+                || fl->slots[1][i] != (uint8_t) (i * 7))
+            return false;
+    return true;
+}
+
+int _suit_test_swap_image(void * arg, size_t idx, size_t source,
+        size_t size)
+{
+    return suit_swap(arg, idx, source, size);
+}
+
+void test_suit_swap(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_SWAP);
+    struct suit_test_flash * fl = &test_flash;
+
+    /* a swap directive turns the copy from the source into a swap */
+    suit_context_t * ctx = &test_comp_ctx;
+    uint8_t seq[32], man[256];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 6);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, 0);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_param_source_comp);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_param_image_size);
+    nanocbor_fmt_uint(&nc, SUIT_TEST_SLOT_SIZE);
+    nanocbor_fmt_uint(&nc, suit_dir_swap);
+    nanocbor_fmt_null(&nc);
+    size_t len_man = _suit_test_comp_wrap(2, seq, 
+            nanocbor_encoded_len(&nc), man, sizeof(man));
+    zassert_false(suit_parse_init(ctx, man, len_man),
+            "Failed to parse SUIT manifest.");
+    zassert_true(suit_must_swap(ctx, 0) && !suit_must_swap(ctx, 1),
+            "Swap directive not recorded.");
+
+    size_t len_plan = sizeof(test_plan);
+    suit_plan_handler_t handler = { 
+        .arg = (void *) &test_storage,
+        .swap = _suit_test_swap_image,
+    };
+    zassert_false(suit_plan_compile(ctx, test_plan_key, 
+            sizeof(test_plan_key), test_plan, &len_plan),
+            "Failed to compile install plan.");
+    _suit_test_flash_reset(fl);
+    zassert_false(suit_plan_execute(test_plan, len_plan, 
+            test_plan_key, sizeof(test_plan_key), &handler),
+            "Failed to swap images.");
+    zassert_true(_suit_test_flash_is_swapped(fl), "Images not swapped.");
+    zassert_false(fl->saved, "Swap status left behind.");
+
+    /* wear stays spread over the sectors */
+    size_t erases = 0, most = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(fl->erases); i++) {
+        erases += fl->erases[i];
+        most = MAX(most, fl->erases[i]);
+    }
+    zassert_true(erases == 3 * SUIT_TEST_SWAP_SECTORS && most <= 2
+            && fl->erases[2 * SUIT_TEST_SWAP_SECTORS] == 1,
+            "Unexpected sector wear.");
+    size_t ops = fl->ops;
+    printk("swap  %u sectors %2u erases, at most %u per sector, %5u ms\n",
+            SUIT_TEST_SWAP_SECTORS, erases, most, fl->us / 1000);
+    printk("swap  wear a");
+    for (size_t i = 0; i < ARRAY_SIZE(fl->erases); i++)
+        printk("%s%u", i == SUIT_TEST_SWAP_SECTORS ? " b " 
+                : i == 2 * SUIT_TEST_SWAP_SECTORS ? " spare " : " ",
+                fl->erases[i]);
+    printk(", with scratch %u erases, %u on scratch\n",
+            3 * SUIT_TEST_SWAP_SECTORS, SUIT_TEST_SWAP_SECTORS);
+
+    /* power is lost after every operation in turn, then swap resumes */
+    for (size_t cut = 1; cut < ops; cut++) {
+        _suit_test_flash_reset(fl);
+        fl->budget = cut;
+        zassert_true(suit_swap(&test_storage, 0, 1, SUIT_TEST_SLOT_SIZE),
+                "Swap not interrupted.");
+        fl->budget = 0;
+        zassert_false(suit_swap_resume(&test_storage),
+                "Failed to resume swap after %u operations.", cut);
+        zassert_true(_suit_test_flash_is_swapped(fl), 
+                "Images not swapped after %u operations.", cut);
+    }
+
+    /* an interrupted swap blocks others until it completes */
+    _suit_test_flash_reset(fl);
+    fl->budget = ops / 2;
+    zassert_true(suit_swap(&test_storage, 0, 1, SUIT_TEST_SLOT_SIZE),
+            "Swap not interrupted.");
+    fl->budget = 0;
+    zassert_true(suit_swap(&test_storage, 1, 0, SUIT_TEST_SLOT_SIZE),
+            "Started a swap over an interrupted one.");
+    zassert_false(suit_swap(&test_storage, 0, 1, SUIT_TEST_SLOT_SIZE),
+            "Failed to resume swap.");
+    zassert_true(_suit_test_flash_is_swapped(fl), "Images not swapped.");
+}
+
+/* 
+ * Copies from one slot to the other share a bus, whether the CPU or a
+ * DMA channel moves the data.
+ */
+#define SUIT_TEST_BUS_BYTES_PER_US 16
+
+int _suit_test_bus_write(void * arg, size_t idx, size_t offset,
+        const uint8_t * buf, size_t len)
+{
+    k_busy_wait(len / SUIT_TEST_BUS_BYTES_PER_US);
+    return _suit_test_flash_write(arg, idx, offset, buf, len);
+}
+
+int _suit_test_dma_transfer(void * arg, size_t dst, size_t dst_off,
+        size_t src, size_t src_off, size_t len)
+{
+    struct suit_test_flash * fl = arg;
+    uint8_t * p = _suit_test_flash_at(fl, src, src_off, len);
+    if (!p) return 1;
+    fl->dma_err = _suit_test_flash_write(fl, dst, dst_off, p, len);
+    fl->dma_start = k_cycle_get_32();
+    fl->dma_us = len / SUIT_TEST_BUS_BYTES_PER_US;
+    return 0;
+}
+
+int _suit_test_dma_wait(void * arg)
+{
+    struct suit_test_flash * fl = arg;
+    uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - fl->dma_start);
+    if (us < fl->dma_us) k_busy_wait(fl->dma_us - us);
+    return fl->dma_err;
+}
+
+int _suit_test_remap(void * arg, size_t dst, size_t src, size_t size)
+{
+    struct suit_test_flash * fl = arg;
+    if (dst > 1 || src > 1) return 1;
+    fl->map[dst] = fl->map[src];
+    return 0;
+}
+
+void test_suit_copy(void) {
+    struct suit_test_flash * fl = &test_flash;
+    uint8_t expect[SUIT_COPY_DIGEST_SIZE], hash[SUIT_COPY_DIGEST_SIZE];
+    _suit_test_flash_reset(fl);
+    mbedtls_sha256_ret(fl->slots[0], SUIT_TEST_SLOT_SIZE, expect, 0);
+
+    suit_storage_t cpu = test_storage, dma = test_storage;
+    cpu.write = _suit_test_bus_write;
+    dma.transfer = _suit_test_dma_transfer;
+    dma.wait = _suit_test_dma_wait;
+    dma.chunk_size = 2 * SUIT_TEST_PAGE_SIZE;
+    suit_storage_t remap = dma;
+    remap.remap = _suit_test_remap;
+    zassert_true(suit_copy(&cpu, 0, 0, SUIT_TEST_SLOT_SIZE, hash),
+            "Copied a component onto itself.");
+
+    struct {
+        const char * name;
+        const suit_storage_t * st;
+        bool overlap;
+    } modes[] = {
+        { "cpu",        &cpu,   true },
+        { "dma",        &dma,   false },
+        { "dma hashed", &dma,   true },
+        { "remap",      &remap, true },
+    };
+
+    for (size_t m = 0; m < ARRAY_SIZE(modes); m++) {
+        uint32_t best = UINT32_MAX;
+        for (size_t r = 0; r < SUIT_TEST_BENCH_ROUNDS; r++) {
+            _suit_test_flash_reset(fl);
+            memset(hash, 0, sizeof(hash));
+            uint32_t start = suit_bench_now();
+            int err = suit_copy(modes[m].st, 1, 0, SUIT_TEST_SLOT_SIZE,
+                    modes[m].overlap ? hash : NULL);
+            if (!modes[m].overlap) {
+                /* hash the copy afterwards, as check_digest would */
+                mbedtls_sha256_ret(_suit_test_flash_at(fl, 1, 0, 
+                            SUIT_TEST_SLOT_SIZE), 
+                        SUIT_TEST_SLOT_SIZE, hash, 0);
+            }
+            best = MIN(best, suit_bench_now() - start);
+            zassert_false(err, "Failed to copy image (%s).", modes[m].name);
+        }
+        zassert_false(memcmp(hash, expect, sizeof(hash)), 
+                "Wrong hash of image (%s).", modes[m].name);
+        zassert_false(memcmp(_suit_test_flash_at(fl, 1, 0, 
+                        SUIT_TEST_SLOT_SIZE), fl->slots[0], 
+                    SUIT_TEST_SLOT_SIZE),
+                "Image not copied (%s).", modes[m].name);
+        printk("copy  %-10s %6u bytes %10u " SUIT_BENCH_UNIT "/KiB\n", 
+                modes[m].name,
+                SUIT_TEST_SLOT_SIZE, best / (SUIT_TEST_SLOT_SIZE / 1024));
+    }
+
+    /* the hash is of what was written, not of what was read */
+    for (size_t m = 0; m < 2; m++) {
+        _suit_test_flash_reset(fl);
+        fl->stuck = true;
+        zassert_false(suit_copy(m ? &dma : &cpu, 1, 0, 
+                    SUIT_TEST_SLOT_SIZE, hash), "Failed to copy image.");
+        zassert_true(memcmp(hash, expect, sizeof(hash)), 
+                "Hash missed a bad write (%s).", modes[m].name);
+    }
+}
+
+/*
+ * Builds a manifest the way a generator would, with the sequence 
+ * number and size encoded as 32-bit integers, and records where its 
+ * variable fields are.
+ */
+size_t _suit_test_template_manifest(uint32_t seq_num, uint32_t size,
+        const uint8_t * digest, const char * uri, 
+        uint8_t * man, size_t size_man, suit_template_field_t * fields)
+{
+    uint8_t seq[128], com[16];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, 6);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, 0);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, 3);
+    nanocbor_fmt_uint(&nc, suit_param_image_digest);
+    nanocbor_fmt_array(&nc, 2);
+    nanocbor_fmt_uint(&nc, suit_digest_alg_sha256);
+    nanocbor_put_bstr(&nc, digest, 32);
+    size_t off_digest = nanocbor_encoded_len(&nc) - 32;
+    nanocbor_fmt_uint(&nc, suit_param_image_size);
+    size_t off_size = nanocbor_encoded_len(&nc);
+    nanocbor_fmt_uint(&nc, size);
+    size_t len_size = nanocbor_encoded_len(&nc) - off_size;
+    nanocbor_fmt_uint(&nc, suit_param_uri);
+    nanocbor_put_tstr(&nc, uri);
+    size_t off_uri = nanocbor_encoded_len(&nc) - strlen(uri);
+    nanocbor_fmt_uint(&nc, suit_dir_fetch);
+    nanocbor_fmt_null(&nc);
+    size_t len_seq = nanocbor_encoded_len(&nc);
+
+    uint8_t id = 0, comps[8];
+    nanocbor_encoder_init(&nc, comps, sizeof(comps));
+    nanocbor_fmt_array(&nc, 1);
+    nanocbor_fmt_array(&nc, 1);
+    nanocbor_put_bstr(&nc, &id, 1);
+    size_t len_comps = nanocbor_encoded_len(&nc);
+    nanocbor_encoder_init(&nc, com, sizeof(com));
+    nanocbor_fmt_map(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_common_comps);
+    nanocbor_put_bstr(&nc, comps, len_comps);
+    size_t len_com = nanocbor_encoded_len(&nc);
+
+    nanocbor_encoder_init(&nc, man, size_man);
+    nanocbor_fmt_map(&nc, 4);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_version);
+    nanocbor_fmt_uint(&nc, 1);
+    nanocbor_fmt_uint(&nc, suit_header_manifest_seq_num);
+    size_t off_seq_num = nanocbor_encoded_len(&nc);
+    nanocbor_fmt_uint(&nc, seq_num);
+    size_t len_seq_num = nanocbor_encoded_len(&nc) - off_seq_num;
+    nanocbor_fmt_uint(&nc, suit_header_common);
+    nanocbor_put_bstr(&nc, com, len_com);
+    nanocbor_fmt_uint(&nc, suit_header_install);
+    nanocbor_put_bstr(&nc, seq, len_seq);
+    size_t len_man = nanocbor_encoded_len(&nc);
+    size_t base = len_man - len_seq;
+
+    suit_template_field_t f[] = {
+        { suit_field_seq_num, 0, off_seq_num, len_seq_num },
+        { suit_field_bytes, 0, base + off_digest, 32 },
+        { suit_field_size, 0, base + off_size, len_size },
+        { suit_field_bytes, 0, base + off_uri, strlen(uri) },
+    };
+    if (fields) memcpy(fields, f, sizeof(f));
+    return len_man;
+}
+
+static suit_template_t test_template;
+static suit_context_t test_template_ctx;
+
+void test_suit_template(void) {
+    suit_context_t * ctx = &test_comp_ctx, * fast = &test_template_ctx;
+    suit_template_field_t fields[4];
+    uint8_t digest[32], skel[192], man[192];
+    memset(digest, 0xa5, sizeof(digest));
+    size_t len_skel = _suit_test_template_manifest(0x10000000, 0x10000,
+            digest, "coap://fw.example/app-0000.bin", 
+            skel, sizeof(skel), fields);
+    zassert_false(suit_template_init(&test_template, skel, len_skel, 
+                fields, ARRAY_SIZE(fields)),
+            "Failed to make template.");
+
+    /* only strings the parser keeps may vary */
+    suit_template_field_t bad = { suit_field_bytes, 0, 
+        fields[1].offset - 1, 33 };
+    zassert_true(suit_template_init(&test_template, skel, len_skel, 
+                &bad, 1),
+            "Accepted a field that is not a string.");
+
+    /* and integers only where the parser read them */
+    suit_template_field_t swapped[] = { fields[2], fields[0] };
+    swapped[0].field = suit_field_seq_num;
+    swapped[1].field = suit_field_size;
+    zassert_true(suit_template_init(&test_template, skel, len_skel, 
+                &swapped[0], 1),
+            "Accepted a sequence number that is not one.");
+    zassert_true(suit_template_init(&test_template, skel, len_skel, 
+                &swapped[1], 1),
+            "Accepted an image size that is not one.");
+    zassert_false(suit_template_init(&test_template, skel, len_skel, 
+                fields, ARRAY_SIZE(fields)),
+            "Failed to make template.");
+
+    /* the last two change the length of a field and fall back */
+    struct {
+        uint32_t seq_num, size;
+        const char * uri;
+    } vectors[] = {
+        { 0x10000001, 0x12345, "coap://fw.example/app-0001.bin" },
+        { 0x7fffffff, 0xfffff, "coap://fw.example/app-9999.bin" },
+        { 0x10000002, 0x12345, "coap://fw.example/app-0001.bin.1" },
+        { 2,          0x12345, "coap://fw.example/app-0001.bin" },
+    };
+
+    for (size_t v = 0; v < ARRAY_SIZE(vectors); v++) {
+        digest[0] = v;
+        size_t len_man = _suit_test_template_manifest(vectors[v].seq_num,
+                vectors[v].size, digest, vectors[v].uri, 
+                man, sizeof(man), NULL);
+        /* both parsers agree, whether the template matches or not */
+        zassert_false(suit_parse_init(ctx, man, len_man),
+                "Failed to parse SUIT manifest.");
+        zassert_false(suit_parse_template(fast, &test_template, 1,
+                    man, len_man),
+                "Failed to parse SUIT manifest through template.");
+        const uint8_t * uri; size_t len_uri;
+        suit_get_uri(fast, 0, &uri, &len_uri);
+        zassert_true(suit_get_sequence_number(fast) == vectors[v].seq_num
+                && suit_get_component_count(fast) == 1
+                && suit_get_size(fast, 0) == vectors[v].size
+                && suit_digest_is_match(fast, 0, digest, sizeof(digest))
+                && len_uri == strlen(vectors[v].uri)
+                && !memcmp(uri, vectors[v].uri, len_uri),
+                "Wrong context from template.");
+        zassert_false(memcmp(&ctx->params[ctx->components[0].params],
+                    &fast->params[fast->components[0].params],
+                    sizeof(suit_params_t)),
+                "Template and parser disagree.");
+
+        uint32_t generic = UINT32_MAX, templated = UINT32_MAX;
+        for (size_t r = 0; r < SUIT_TEST_BENCH_ROUNDS; r++) {
+            uint32_t start = suit_bench_now();
+            suit_parse_init(ctx, man, len_man);
+            generic = MIN(generic, suit_bench_now() - start);
+            start = suit_bench_now();
+            suit_parse_template(fast, &test_template, 1, man, len_man);
+            templated = MIN(templated, suit_bench_now() - start);
+        }
+        printk("template %-8s %6u bytes generic %10u " SUIT_BENCH_UNIT " "
+                "template %10u " SUIT_BENCH_UNIT "\n", 
+                v < 2 ? "match" : "fallback",
+                len_man, generic, templated);
+    }
+}
+
+void test_suit_build(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_COPY);
+    suit_context_t * ctx = &test_comp_ctx;
+    uint8_t digest[32], device_id[16], man[256], ref[256];
+    memset(digest, 0x5a, sizeof(digest));
+    memset(device_id, 0, sizeof(device_id));
+
+    /* fetch into external storage, copy into internal flash and run */
+    suit_build_comp_t comps[2] = {
+        {
+            .id = (const uint8_t *) "ext", .len_id = 3,
+            .uri = "coap://fw.example/app.bin",
+        },
+        {
+            .id = (const uint8_t *) "int", .len_id = 3,
+            .vendor_id = test_vendor_id, 
+            .len_vendor_id = sizeof(test_vendor_id),
+            .digest_alg = suit_digest_alg_sha256,
+            .digest = digest, .len_digest = sizeof(digest),
+            .size = 34768,
+            .device_id = device_id, .len_device_id = sizeof(device_id),
+            .copy = true, .source = 0,
+            .run = true,
+        },
+    };
+    suit_build_t b = { 
+        .sequence_number = 1, 
+        .component_count = ARRAY_SIZE(comps), 
+        .components = comps,
+    };
+
+    suit_template_field_t fields[SUIT_TEMPLATE_MAX_FIELDS];
+    size_t field_count = ARRAY_SIZE(fields), len_man = sizeof(man);
+    zassert_false(suit_build_manifest(&b, man, &len_man, 
+                fields, &field_count),
+            "Failed to build manifest.");
+    zassert_true(field_count == 5, "Unexpected number of fields.");
+    zassert_false(suit_parse_init(ctx, man, len_man),
+            "Failed to parse built manifest.");
+    const uint8_t * uri; size_t len_uri;
+    suit_get_uri(ctx, 0, &uri, &len_uri);
+    zassert_true(suit_get_sequence_number(ctx) == 1
+            && suit_get_component_count(ctx) == 2
+            && len_uri == strlen(comps[0].uri) 
+            && !memcmp(uri, comps[0].uri, len_uri)
+            && suit_get_source_component(ctx, 1) == &ctx->components[0]
+            && suit_vendor_id_is_match(ctx, 1, test_vendor_id, 
+                sizeof(test_vendor_id))
+            && suit_digest_is_match(ctx, 1, digest, sizeof(digest))
+            && suit_get_size(ctx, 1) == 34768
+            && suit_must_run(ctx, 1) && !suit_must_run(ctx, 0),
+            "Built manifest parsed wrong.");
+
+    /* the same manifest, one for each device, patched in place */
+    uint32_t patch = UINT32_MAX, build = UINT32_MAX;
+    for (size_t dev = 0; dev < SUIT_TEST_BENCH_ROUNDS; dev++) {
+        comps[1].size = 34768 + dev;
+        b.sequence_number = 100 + dev;
+        digest[0] = device_id[15] = dev;
+
+        uint32_t start = suit_bench_now();
+        int err = suit_patch_uint(man, len_man, &fields[0], 
+                b.sequence_number)
+            || suit_patch_bytes(man, len_man, &fields[1], digest, 
+                    sizeof(digest))
+            || suit_patch_uint(man, len_man, &fields[2], comps[1].size)
+            || suit_patch_bytes(man, len_man, &fields[3], device_id, 
+                    sizeof(device_id));
+        patch = MIN(patch, suit_bench_now() - start);
+        zassert_false(err, "Failed to patch manifest.");
+
+        size_t len_ref = sizeof(ref);
+        start = suit_bench_now();
+        err = suit_build_manifest(&b, ref, &len_ref, NULL, NULL);
+        build = MIN(build, suit_bench_now() - start);
+        zassert_false(err, "Failed to build manifest.");
+        zassert_true(len_ref == len_man && !memcmp(ref, man, len_man),
+                "Patched manifest differs from built one.");
+        zassert_false(suit_parse_init(ctx, man, len_man),
+                "Failed to parse patched manifest.");
+        zassert_true(suit_get_sequence_number(ctx) == 100 + dev
+                && suit_get_size(ctx, 1) == 34768 + dev
+                && suit_device_id_is_match(ctx, 1, device_id, 
+                    sizeof(device_id)),
+                "Patched manifest parsed wrong.");
+    }
+    printk("build %6u bytes %10u " SUIT_BENCH_UNIT ", "
+            "patched %10u " SUIT_BENCH_UNIT "\n", 
+            len_man, build, patch);
+
+    /* the fields make a template */
+    zassert_false(suit_template_init(&test_template, man, len_man, 
+                fields, field_count),
+            "Failed to make template of built manifest.");
+
+    /* fields are not patched with something else */
+    zassert_true(suit_patch_uint(man, len_man, &fields[1], 1),
+            "Patched a digest with an integer.");
+    zassert_true(suit_patch_bytes(man, len_man, &fields[4], 
+                (const uint8_t *) "coap://x", 8),
+            "Patched a URI with one of another length.");
+
+    /* no room */
+    len_man = 64;
+    zassert_true(suit_build_manifest(&b, man, &len_man, NULL, NULL),
+            "Built manifest without room.");
+}
+
+#define SUIT_TEST_BUNDLE_COUNT 64
+#define SUIT_TEST_ENV_SIZE 256
+
+static uint8_t test_envs[SUIT_TEST_BUNDLE_COUNT][SUIT_TEST_ENV_SIZE];
+static uint32_t test_bundle[SUIT_TEST_BUNDLE_COUNT 
+    * (sizeof(suit_bundle_entry_t) + SUIT_TEST_ENV_SIZE) / 4 + 4];
+static suit_bundle_entry_t test_bundle_meta[SUIT_TEST_BUNDLE_COUNT];
+
+void test_suit_bundle(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_HMAC);
+    suit_key_t key;
+    zassert_false(suit_key_init_hmac(
+                &key, test_hmac_secret, sizeof(test_hmac_secret)),
+                "Failed to set HMAC key.");
+
+    /* one manifest per device, each in its own envelope */
+    uint8_t digest[32], man[256];
+    memset(digest, 0x5a, sizeof(digest));
+    suit_build_comp_t comp = {
+        .id = (const uint8_t *) "app", .len_id = 3,
+        .vendor_id = test_vendor_id, 
+        .len_vendor_id = sizeof(test_vendor_id),
+        .digest_alg = suit_digest_alg_sha256,
+        .digest = digest, .len_digest = sizeof(digest),
+        .size = 34768,
+        .uri = "coap://fw.example/app.bin",
+        .run = true,
+    };
+    suit_build_t b = { .component_count = 1, .components = &comp };
+    suit_template_field_t fields[SUIT_TEMPLATE_MAX_FIELDS];
+    size_t field_count = ARRAY_SIZE(fields), len_man = sizeof(man);
+    zassert_false(suit_build_manifest(&b, man, &len_man, 
+                fields, &field_count),
+            "Failed to build manifest.");
+
+    const uint8_t * envs[SUIT_TEST_BUNDLE_COUNT];
+    size_t len_envs[SUIT_TEST_BUNDLE_COUNT];
+    for (size_t i = 0; i < SUIT_TEST_BUNDLE_COUNT; i++) {
+        suit_bundle_entry_t * meta = &test_bundle_meta[i];
+        memset(meta, 0, sizeof(*meta));
+        memcpy(meta->vendor_id, test_vendor_id, sizeof(meta->vendor_id));
+        meta->class_id[0] = i % 4;
+        meta->sequence_number = 1000 + i;
+        suit_patch_uint(man, len_man, &fields[0], meta->sequence_number);
+        len_envs[i] = SUIT_TEST_ENV_SIZE;
+        zassert_false(suit_manifest_wrap_key(&key, man, len_man, 
+                    test_envs[i], &len_envs[i]),
+                "Failed to write envelope.");
+        envs[i] = test_envs[i];
+    }
+
+    size_t len = sizeof(test_bundle);
+    zassert_false(suit_bundle_write((uint8_t *) test_bundle, &len,
+                test_bundle_meta, envs, len_envs, SUIT_TEST_BUNDLE_COUNT),
+            "Failed to write bundle.");
+    suit_bundle_t bundle;
+    zassert_false(suit_bundle_open(&bundle, (uint8_t *) test_bundle, len),
+            "Failed to open bundle.");
+    zassert_true(bundle.count == SUIT_TEST_BUNDLE_COUNT,
+            "Unexpected number of envelopes.");
+
+    /* envelopes are read where they lie */
+    for (size_t i = 0; i < SUIT_TEST_BUNDLE_COUNT; i++) {
+        const suit_bundle_entry_t * e;
+        const uint8_t * env; size_t len_env;
+        zassert_false(suit_bundle_get(&bundle, i, &e, &env, &len_env),
+                "Failed to get envelope.");
+        zassert_true(env > (uint8_t *) test_bundle 
+                && env + len_env <= (uint8_t *) test_bundle + len
+                && len_env == len_envs[i] 
+                && !memcmp(env, envs[i], len_env)
+                && e->sequence_number == 1000 + i
+                && e->class_id[0] == i % 4,
+                "Wrong envelope in bundle.");
+    }
+    zassert_true(suit_bundle_open(&bundle, (uint8_t *) test_bundle, 
+                len - 1),
+            "Opened a truncated bundle.");
+    zassert_false(suit_bundle_open(&bundle, (uint8_t *) test_bundle, len),
+            "Failed to open bundle.");
+
+    /* a header whose length leaves no room for the index it counts */
+    suit_bundle_header_t * h = (suit_bundle_header_t *) test_bundle;
+    uint32_t len_bundle = h->len;
+    h->len = sizeof(*h) - 1;
+    zassert_true(suit_bundle_open(&bundle, (uint8_t *) test_bundle, len),
+            "Opened a bundle shorter than its header.");
+    h->len = sizeof(*h) + sizeof(suit_bundle_entry_t);
+    zassert_true(suit_bundle_open(&bundle, (uint8_t *) test_bundle, len),
+            "Opened a bundle shorter than its index.");
+    h->len = len_bundle;
+    zassert_false(suit_bundle_open(&bundle, (uint8_t *) test_bundle, len),
+            "Failed to open bundle.");
+
+    /* loading each envelope into a buffer first, as from a file */
+    uint8_t buf[SUIT_TEST_ENV_SIZE];
+    const uint8_t * man_out; size_t len_man_out;
+    uint32_t start = suit_bench_now();
+    for (size_t i = 0; i < SUIT_TEST_BUNDLE_COUNT; i++) {
+        memcpy(buf, envs[i], len_envs[i]);
+        zassert_false(suit_manifest_unwrap_key(&key, buf, len_envs[i],
+                    &man_out, &len_man_out),
+                "Failed to authenticate envelope.");
+    }
+    uint32_t files = suit_bench_now() - start;
+    start = suit_bench_now();
+    for (size_t i = 0; i < SUIT_TEST_BUNDLE_COUNT; i++) {
+        const uint8_t * env; size_t len_env;
+        suit_bundle_get(&bundle, i, NULL, &env, &len_env);
+        zassert_false(suit_manifest_unwrap_key(&key, env, len_env,
+                    &man_out, &len_man_out),
+                "Failed to authenticate envelope.");
+    }
+    uint32_t mapped = suit_bench_now() - start;
+
+    ATOMIC_DEFINE(bad, SUIT_TEST_BUNDLE_COUNT);
+    start = suit_bench_now();
+    zassert_false(suit_bundle_verify(&bundle, &key, 1, 1, bad),
+            "Failed to verify bundle.");
+    uint32_t verify = suit_bench_now() - start;
+    start = suit_bench_now();
+    zassert_false(suit_bundle_verify(&bundle, &key, 1, 0, bad),
+            "Failed to verify bundle.");
+    uint32_t verify_all = suit_bench_now() - start;
+    printk("bundle %2u envelopes from buffers %10u " SUIT_BENCH_UNIT ", "
+            "in place %10u " SUIT_BENCH_UNIT "\n", 
+            SUIT_TEST_BUNDLE_COUNT, files, mapped);
+    printk("bundle %2u envelopes verified %10u " SUIT_BENCH_UNIT ", "
+            "%u workers %10u " SUIT_BENCH_UNIT "\n", 
+            SUIT_TEST_BUNDLE_COUNT, verify,
+            CONFIG_ZOOT_WORKER_THREADS, verify_all);
+
+    /* a changed envelope, a wrong sequence number and an unknown key */
+    suit_bundle_entry_t * entries = (suit_bundle_entry_t *) 
+        ((uint8_t *) test_bundle + sizeof(suit_bundle_header_t));
+    ((uint8_t *) test_bundle)[entries[5].offset + entries[5].len - 1] ^= 1;
+    entries[7].sequence_number++;
+    entries[9].key_id = 1;
+    zassert_true(suit_bundle_verify(&bundle, &key, 1, 0, bad) == 3
+            && atomic_test_bit(bad, 5) && atomic_test_bit(bad, 7)
+            && atomic_test_bit(bad, 9) && !atomic_test_bit(bad, 6),
+            "Failed to find bad envelopes.");
+}
+
+#define SUIT_TEST_CORPUS_ROUNDS 20
+#define SUIT_TEST_CORPUS_MAN_SIZE 16384
+#define SUIT_TEST_CORPUS_ENV_SIZE 24576
+
+static uint8_t test_corpus_man[SUIT_TEST_CORPUS_MAN_SIZE];
+static uint8_t test_corpus_env[SUIT_TEST_CORPUS_ENV_SIZE];
+static suit_context_t test_corpus_ctx;
+
+struct suit_test_corpus {
+    const struct suit_corpus_shape * shape;
+    suit_key_t * key;
+    size_t len_man, len_env;
+    int err;
+};
+
+void _suit_test_corpus_parse(void * arg)
+{
+    struct suit_test_corpus * run = arg;
+    run->err = suit_parse_init(&test_corpus_ctx, 
+            test_corpus_man, run->len_man);
+}
+
+/* the payload is attached to the envelope once it is signed */
+void _suit_test_corpus_wrap(void * arg)
+{
+    struct suit_test_corpus * run = arg;
+    run->len_env = sizeof(test_corpus_env);
+    run->err = suit_manifest_wrap_key(run->key, test_corpus_man, 
+            run->len_man, test_corpus_env, &run->len_env);
+    if (run->err) return;
+    run->len_env = suit_corpus_add_payload(run->shape, test_corpus_env,
+            run->len_env, sizeof(test_corpus_env));
+    run->err = run->len_env == 0;
+}
+
+void _suit_test_corpus_unwrap(void * arg)
+{
+    struct suit_test_corpus * run = arg;
+    const uint8_t * man; size_t len_man;
+    run->err = suit_manifest_unwrap_key(run->key, test_corpus_env, 
+            run->len_env, &man, &len_man);
+}
+
+/* prints min, median, 90th percentile and max of a number of runs */
+void _suit_test_corpus_time(const char * name, suit_bench_fn_t fn,
+        struct suit_test_corpus * run)
+{
+    uint32_t samples[SUIT_TEST_CORPUS_ROUNDS];
+    suit_arena_reset_high_water();
+    size_t stack = suit_bench_stack(fn, run);
+    size_t arena = suit_arena_high_water();
+    zassert_false(run->err, "Failed to %s corpus manifest.", name);
+    for (size_t r = 0; r < SUIT_TEST_CORPUS_ROUNDS; r++) {
+        uint32_t start = suit_bench_now();
+        fn(run);
+        uint32_t cycles = suit_bench_now() - start;
+        size_t i = r;
+        for (; i > 0 && samples[i - 1] > cycles; i--)
+            samples[i] = samples[i - 1];
+        samples[i] = cycles;
+    }
+    printk("    %-6s %9u %9u %9u %9u " SUIT_BENCH_UNIT 
+            " %5u stack %5u arena\n", name,
+            samples[0], samples[SUIT_TEST_CORPUS_ROUNDS / 2],
+            samples[SUIT_TEST_CORPUS_ROUNDS * 9 / 10],
+            samples[SUIT_TEST_CORPUS_ROUNDS - 1], stack, arena);
+}
+
+void _suit_test_corpus_run(suit_key_t * key, const char * name,
+        size_t value, const struct suit_corpus_shape * shape)
+{
+    struct suit_test_corpus run = { shape, key, 0, 0, 0 };
+    run.len_man = suit_corpus_manifest(shape, 
+            test_corpus_man, sizeof(test_corpus_man));
+    if (run.len_man) _suit_test_corpus_parse(&run);
+    if (run.len_man == 0 || run.err) {
+        printk("corpus %-10s %5u does not fit this configuration\n", 
+                name, value);
+        return;
+    }
+    _suit_test_corpus_wrap(&run);
+    printk("corpus %-10s %5u manifest %6u bytes envelope %6u bytes\n",
+            name, value, run.len_man, run.len_env);
+    printk("    %-6s %9s %9s %9s %9s\n", "", "min", "median", "p90", "max");
+    _suit_test_corpus_time("parse", _suit_test_corpus_parse, &run);
+    _suit_test_corpus_time("wrap", _suit_test_corpus_wrap, &run);
+    _suit_test_corpus_time("unwrap", _suit_test_corpus_unwrap, &run);
+}
+
+/*
+ * Scales one dimension of the synthetic corpus at a time and prints,
+ * per shape, manifest and envelope sizes, cycle percentiles of parse,
+ * wrap and unwrap, and the stack and arena of each.
+ */
+void test_suit_corpus(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_TRY_EACH);
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_HMAC);
+    suit_key_t key;
+    zassert_false(suit_key_init_hmac(
+                &key, test_hmac_secret, sizeof(test_hmac_secret)),
+                "Failed to set HMAC key.");
+
+    /* the generated manifests parse to what they describe */
+    const struct suit_corpus_shape base = { 1, 0, 0, 0, 0 };
+    struct suit_corpus_shape shape = base;
+    shape.components = MIN(2, SUIT_MAX_COMPONENTS);
+    shape.depth = 1;
+    shape.commands = 4;
+    shape.text = 64;
+    size_t len_man = suit_corpus_manifest(&shape, 
+            test_corpus_man, sizeof(test_corpus_man));
+    zassert_true(len_man > 0, "Failed to write corpus manifest.");
+    zassert_false(suit_parse_init(&test_corpus_ctx, 
+                test_corpus_man, len_man),
+            "Failed to parse corpus manifest.");
+    zassert_true(test_corpus_ctx.component_count == shape.components,
+            "Unexpected number of components.");
+    for (size_t i = 0; i < shape.components; i++)
+        zassert_true(suit_get_size(&test_corpus_ctx, i) == 1024 + i
+                && suit_get_uri_alt_count(&test_corpus_ctx, i) == 1,
+                "Unexpected component parameters.");
+    zassert_true(suit_corpus_manifest(&shape, test_corpus_man, 
+                len_man - 1) == 0,
+            "Wrote a manifest that does not fit.");
+
+    /* then one dimension at a time is scaled from the smallest shape */
+    printk("corpus context %u bytes\n", sizeof(suit_context_t));
+    for (size_t n = 1; n <= SUIT_MAX_COMPONENTS; n *= 2) {
+        shape = base;
+        shape.components = n;
+        _suit_test_corpus_run(&key, "components", n, &shape);
+    }
+    for (size_t n = 0; n <= SUIT_MAX_NESTING; n++) {
+        shape = base;
+        shape.depth = n;
+        _suit_test_corpus_run(&key, "depth", n, &shape);
+    }
+    static const size_t commands[] = { 0, 8, 32, 128 };
+    for (size_t i = 0; i < ARRAY_SIZE(commands); i++) {
+        shape = base;
+        shape.commands = commands[i];
+        _suit_test_corpus_run(&key, "commands", commands[i], &shape);
+    }
+    static const size_t text[] = { 0, 256, 1024, 4096 };
+    for (size_t i = 0; i < ARRAY_SIZE(text); i++) {
+        shape = base;
+        shape.text = text[i];
+        _suit_test_corpus_run(&key, "text", text[i], &shape);
+    }
+    static const size_t payload[] = { 0, 1024, 4096, 16384 };
+    for (size_t i = 0; i < ARRAY_SIZE(payload); i++) {
+        shape = base;
+        shape.payload = payload[i];
+        _suit_test_corpus_run(&key, "payload", payload[i], &shape);
+    }
+
+    suit_key_free(&key);
+}
+
+/*
+ * A simulated device: busy during the day, on mains power at night,
+ * with a battery that is charged three hours into the simulation.
+ */
+struct suit_test_device {
+    uint32_t now, start;
+    int32_t power;
+    uint32_t battery;
+    bool busy;
+};
+
+uint32_t _suit_test_now(void * arg)
+{
+    return ((struct suit_test_device *) arg)->now;
+}
+
+int32_t _suit_test_level(void * arg, suit_wait_t event)
+{
+    struct suit_test_device * dev = arg;
+    return event == suit_wait_power ? dev->power : 0;
+}
+
+uint32_t _suit_test_battery(void * arg)
+{
+    return ((struct suit_test_device *) arg)->battery;
+}
+
+bool _suit_test_idle(void * arg)
+{
+    return !((struct suit_test_device *) arg)->busy;
+}
+
+void _suit_test_device_tick(struct suit_test_device * dev, uint32_t now)
+{
+    uint32_t hour = now % SUIT_SCHED_DAY / 3600;
+    dev->now = now;
+    dev->busy = hour >= 8 && hour < 20;
+    dev->power = hour >= 22 || hour < 6;
+    dev->battery = now >= dev->start + 3 * 3600 ? 80 : 20;
+}
+
+/* a manifest with one component and the given scheduling parameters */
+size_t _suit_test_sched_manifest(int32_t priority, uint32_t min_battery,
+        const uint8_t * wait, size_t len_wait, 
+        uint8_t * man, size_t size_man)
+{
+    uint8_t seq[64];
+    nanocbor_encoder_t nc;
+    nanocbor_encoder_init(&nc, seq, sizeof(seq));
+    nanocbor_fmt_array(&nc, wait ? 6 : 4);
+    nanocbor_fmt_uint(&nc, suit_dir_set_comp_idx);
+    nanocbor_fmt_uint(&nc, 0);
+    nanocbor_fmt_uint(&nc, suit_dir_set_params);
+    nanocbor_fmt_map(&nc, wait ? 3 : 2);
+    nanocbor_fmt_uint(&nc, suit_param_update_priority);
+    nanocbor_fmt_int(&nc, priority);
+    nanocbor_fmt_uint(&nc, suit_param_min_battery);
+    nanocbor_fmt_uint(&nc, min_battery);
+    if (wait) {
+        nanocbor_fmt_uint(&nc, suit_param_wait_info);
+        nanocbor_put_bstr(&nc, wait, len_wait);
+        nanocbor_fmt_uint(&nc, suit_dir_wait);
+        nanocbor_fmt_uint(&nc, 0); /* report policy */
+    }
+    return _suit_test_comp_wrap(1, seq, nanocbor_encoded_len(&nc), 
+            man, size_man);
+}
+
+struct suit_test_sched_job {
+    const char * name;
+    int32_t priority; uint32_t min_battery;
+    const uint8_t * wait; size_t len_wait;
+    uint32_t expected;      /* hours after the start */
+    uint32_t started;
+    size_t order;
+};
+
+#define SUIT_TEST_SCHED_JOBS 5
+
+static uint8_t test_sched_man[SUIT_TEST_SCHED_JOBS][128];
+static suit_context_t test_sched_ctx[SUIT_TEST_SCHED_JOBS];
+
+void test_suit_schedule(void) {
+    SUIT_TEST_REQUIRES(CONFIG_ZOOT_SCHEDULING);
+    /* Monday 2020-06-01 09:00 UTC */
+    struct suit_test_device dev = { .start = 1590969600 + 9 * 3600 };
+    const suit_sched_env_t env = {
+        .arg = &dev,
+        .now = _suit_test_now,
+        .level = _suit_test_level,
+        .battery = _suit_test_battery,
+        .idle = _suit_test_idle,
+        .window = 3600,
+    };
+    suit_scheduler_t s;
+    suit_sched_init(&s, &env);
+    _suit_test_device_tick(&dev, dev.start);
+
+    /* {power: 1}, {time of day: 02:00}, and unknown to the device */
+    static const uint8_t mains[] = { 0xa1, 0x02, 0x01 };
+    static const uint8_t night[] = { 0xa1, 0x06, 0x19, 0x1c, 0x20 };
+    static const uint8_t other[] = { 0xa1, 0x04, 0x82, 0x41, 0x01, 0x80 };
+    static const uint8_t unknown[] = { 0xa1, 0x18, 0x63, 0x00 };
+    struct suit_test_sched_job jobs[SUIT_TEST_SCHED_JOBS] = {
+        { "critical", -1, 0, NULL, 0, 0 },
+        { "night", 0, 0, night, sizeof(night), 17 },
+        { "mains", 0, 0, mains, sizeof(mains), 13 },
+        { "battery", 5, 30, NULL, 0, 11 },
+        { "normal", 0, 0, NULL, 0, 11 },
+    };
+    for (size_t i = 0; i < SUIT_TEST_SCHED_JOBS; i++) {
+        size_t len_man = _suit_test_sched_manifest(jobs[i].priority,
+                jobs[i].min_battery, jobs[i].wait, jobs[i].len_wait,
+                test_sched_man[i], sizeof(test_sched_man[i]));
+        zassert_false(suit_parse_init(&test_sched_ctx[i], 
+                    test_sched_man[i], len_man),
+                "Failed to parse SUIT manifest.");
+        zassert_true(suit_get_priority(&test_sched_ctx[i], 0) 
+                    == jobs[i].priority
+                && suit_get_min_battery(&test_sched_ctx[i], 0) 
+                    == jobs[i].min_battery
+                && suit_must_wait(&test_sched_ctx[i], 0) == !!jobs[i].wait,
+                "Failed to parse scheduling parameters.");
+    }
+
+    /* events the device cannot evaluate are refused */
+    size_t len_man = _suit_test_sched_manifest(0, 0, other, sizeof(other),
+            test_sched_man[0], sizeof(test_sched_man[0]));
+    zassert_false(suit_parse_init(&test_sched_ctx[0], 
+                test_sched_man[0], len_man),
+            "Failed to parse SUIT manifest.");
+    zassert_true(suit_sched_add(&s, &test_sched_ctx[0], NULL),
+            "Accepted a wait for another device.");
+    len_man = _suit_test_sched_manifest(0, 0, unknown, sizeof(unknown),
+            test_sched_man[0], sizeof(test_sched_man[0]));
+    zassert_false(suit_parse_init(&test_sched_ctx[0], 
+                test_sched_man[0], len_man),
+            "Failed to parse SUIT manifest.");
+    zassert_true(suit_sched_add(&s, &test_sched_ctx[0], NULL),
+            "Accepted an unknown wait event.");
+    zassert_true(s.count == 0, "Queued a refused manifest.");
+
+    /* a critical update starts at once, even on a busy device */
+    len_man = _suit_test_sched_manifest(jobs[0].priority, 0, NULL, 0,
+            test_sched_man[0], sizeof(test_sched_man[0]));
+    suit_parse_init(&test_sched_ctx[0], test_sched_man[0], len_man);
+    suit_context_t * ctx; void * arg;
+    for (size_t i = 0; i < SUIT_TEST_SCHED_JOBS; i++) {
+        zassert_false(suit_sched_add(&s, &test_sched_ctx[i], &jobs[i]),
+                "Failed to queue manifest.");
+        if (i == 0) {
+            zassert_false(suit_sched_next(&s, &ctx, &arg) 
+                    || arg != &jobs[0],
+                    "Failed to start a critical update.");
+            jobs[0].started = dev.now;
+        }
+    }
+    zassert_true(suit_sched_next(&s, &ctx, &arg),
+            "Started an update on a busy device.");
+
+    /* the others in their windows, most urgent first */
+    size_t order = 1;
+    for (uint32_t now = dev.start; now < dev.start + 2 * SUIT_SCHED_DAY;
+            now += 600) {
+        _suit_test_device_tick(&dev, now);
+        while (!suit_sched_next(&s, &ctx, &arg)) {
+            struct suit_test_sched_job * job = arg;
+            job->started = now;
+            job->order = order++;
+        }
+    }
+    zassert_true(s.count == 0, "Updates left waiting.");
+    for (size_t i = 0; i < SUIT_TEST_SCHED_JOBS; i++) {
+        uint32_t hours = (jobs[i].started - dev.start) / 3600;
+        printk("schedule %-8s priority %2d started after %2u hours\n",
+                jobs[i].name, jobs[i].priority, hours);
+        zassert_true(hours == jobs[i].expected, 
+                "Update %s started at the wrong time.", jobs[i].name);
+    }
+    zassert_true(jobs[4].order < jobs[3].order,
+            "Started a less urgent update first.");
+}
+
+#define SUIT_TEST_INDEX_COUNT 10000
+#define SUIT_TEST_INDEX_CLASSES 256
+#define SUIT_TEST_INDEX_SCAN 64
+#define SUIT_TEST_INDEX_STACK_SIZE 4096
+
+static suit_index_record_t test_index_records[SUIT_TEST_INDEX_COUNT];
+static atomic_t test_index_slots[2 * SUIT_TEST_INDEX_CLASSES];
+static uint8_t test_index_scan[SUIT_TEST_INDEX_SCAN][256];
+static size_t test_index_len_scan[SUIT_TEST_INDEX_SCAN];
+static suit_context_t test_index_ctx;
+
+K_THREAD_STACK_DEFINE(test_index_stack, SUIT_TEST_INDEX_STACK_SIZE);
+struct k_thread test_index_thread;
+
+/* the class of the i-th manifest: the test class, numbered */
+void _suit_test_index_class(size_t i, uint8_t * class_id)
+{
+    memcpy(class_id, test_class_id, SUIT_UUID_LEN);
+    class_id[0] = i % SUIT_TEST_INDEX_CLASSES;
+}
+
+/* sequence numbers arrive out of order, each once */
+size_t _suit_test_index_seq_num(size_t i)
+{
+    return (i * 7919) % SUIT_TEST_INDEX_COUNT + 1;
+}
+
+size_t _suit_test_index_manifest(size_t i, uint8_t * man, size_t size_man)
+{
+    uint8_t class_id[SUIT_UUID_LEN], digest[32];
+    _suit_test_index_class(i, class_id);
+    memset(digest, i, sizeof(digest));
+    suit_build_comp_t comp = {
+        .id = (const uint8_t *) "app", .len_id = 3,
+        .vendor_id = test_vendor_id, 
+        .len_vendor_id = sizeof(test_vendor_id),
+        .class_id = class_id, .len_class_id = sizeof(class_id),
+        .digest_alg = suit_digest_alg_sha256,
+        .digest = digest, .len_digest = sizeof(digest),
+        .size = 34768,
+        .uri = "coap://fw.example/app.bin",
+    };
+    suit_build_t b = { 
+        .sequence_number = _suit_test_index_seq_num(i),
+        .component_count = 1, .components = &comp,
+    };
+    size_t len_man = size_man;
+    return suit_build_manifest(&b, man, &len_man, NULL, NULL) ? 0 : len_man;
+}
+
+struct suit_test_index_reader {
+    const suit_index_t * ix;
+    atomic_t stop;
+    size_t lookups, errors;
+};
+
+/* the latest manifest of a class only ever moves forward */
+void _suit_test_index_read(void * arg, void * unused1, void * unused2)
+{
+    struct suit_test_index_reader * r = arg;
+    size_t last[SUIT_TEST_INDEX_CLASSES] = { 0 };
+    uint8_t class_id[SUIT_UUID_LEN];
+    while (!atomic_get(&r->stop)) {
+        for (size_t c = 0; c < SUIT_TEST_INDEX_CLASSES; c++) {
+            _suit_test_index_class(c, class_id);
+            const suit_index_record_t * rec = 
+                suit_index_latest(r->ix, test_vendor_id, class_id);
+            r->lookups++;
+            if (rec == NULL) continue;
+            const suit_index_record_t * older = 
+                suit_index_older(r->ix, rec);
+            if (memcmp(rec->class_id, class_id, SUIT_UUID_LEN)
+                    || rec->sequence_number < last[c]
+                    || (older && older->sequence_number 
+                        >= rec->sequence_number))
+                r->errors++;
+            last[c] = rec->sequence_number;
+        }
+        k_yield();
+    }
+}
+
+/* lookups in 10,000 indexed manifests against matching each one */
+void test_suit_index(void) {
+    suit_index_t ix;
+    zassert_true(suit_index_init(&ix, test_index_slots, 
+                ARRAY_SIZE(test_index_slots) - 1, test_index_records,
+                ARRAY_SIZE(test_index_records)),
+            "Accepted a slot count that is not a power of two.");
+    zassert_false(suit_index_init(&ix, test_index_slots, 
+                ARRAY_SIZE(test_index_slots), test_index_records,
+                ARRAY_SIZE(test_index_records)),
+            "Failed to initialize index.");
+
+    /* a reader runs while all manifests are added */
+    struct suit_test_index_reader reader = { .ix = &ix };
+    atomic_set(&reader.stop, 0);
+    k_thread_create(&test_index_thread, test_index_stack,
+            K_THREAD_STACK_SIZEOF(test_index_stack),
+            _suit_test_index_read, &reader, NULL, NULL,
+            k_thread_priority_get(k_current_get()), 0, K_NO_WAIT);
+
+    uint8_t man[256];
+    uint32_t parse = 0, add = 0;
+    for (size_t i = 0; i < SUIT_TEST_INDEX_COUNT; i++) {
+        size_t len_man = _suit_test_index_manifest(i, man, sizeof(man));
+        uint32_t start = suit_bench_now();
+        zassert_false(suit_parse_init(&test_index_ctx, man, len_man),
+                "Failed to parse SUIT manifest.");
+        uint32_t mid = suit_bench_now();
+        zassert_false(suit_index_add(&ix, &test_index_ctx, 
+                    &test_index_records[i]),
+                "Failed to add manifest.");
+        add += suit_bench_now() - mid;
+        parse += mid - start;
+        if (i % 64 == 63) k_yield();
+    }
+    atomic_set(&reader.stop, 1);
+    k_thread_join(&test_index_thread, K_FOREVER);
+    zassert_true(reader.lookups > 0 && reader.errors == 0,
+            "Reader saw an inconsistent index.");
+
+    /* a sequence number is indexed once */
+    zassert_true(suit_index_add(&ix, &test_index_ctx, NULL),
+            "Added a manifest twice.");
+
+    /* every class has all its manifests, latest first */
+    uint8_t class_id[SUIT_UUID_LEN];
+    for (size_t c = 0; c < SUIT_TEST_INDEX_CLASSES; c++) {
+        size_t latest = 0, count = 0;
+        for (size_t i = c; i < SUIT_TEST_INDEX_COUNT; 
+                i += SUIT_TEST_INDEX_CLASSES)
+            latest = MAX(latest, _suit_test_index_seq_num(i));
+        _suit_test_index_class(c, class_id);
+        const suit_index_record_t * rec = 
+            suit_index_latest(&ix, test_vendor_id, class_id);
+        zassert_true(rec && rec->sequence_number == latest,
+                "Failed to find the latest manifest.");
+        for (; rec; rec = suit_index_older(&ix, rec)) count++;
+        zassert_true(count == (SUIT_TEST_INDEX_COUNT - c 
+                    + SUIT_TEST_INDEX_CLASSES - 1) / SUIT_TEST_INDEX_CLASSES,
+                "Lost a manifest.");
+    }
+    class_id[0] = SUIT_TEST_INDEX_CLASSES - 1;
+    class_id[1] ^= 1;
+    zassert_true(suit_index_latest(&ix, test_vendor_id, class_id) == NULL,
+            "Found a manifest for an unknown class.");
+
+    /* check-ins through the index */
+    uint32_t start = suit_bench_now();
+    for (size_t i = 0; i < SUIT_TEST_INDEX_COUNT; i++) {
+        _suit_test_index_class(i * 31, class_id);
+        suit_index_latest(&ix, test_vendor_id, class_id);
+    }
+    uint32_t lookup = suit_bench_now() - start;
+
+    /* and by parsing and matching candidates, on a sample */
+    for (size_t i = 0; i < SUIT_TEST_INDEX_SCAN; i++)
+        test_index_len_scan[i] = _suit_test_index_manifest(i,
+                test_index_scan[i], sizeof(test_index_scan[i]));
+    _suit_test_index_class(SUIT_TEST_INDEX_SCAN - 1, class_id);
+    start = suit_bench_now();
+    size_t found = 0;
+    for (size_t i = 0; i < SUIT_TEST_INDEX_SCAN; i++) {
+        suit_parse_init(&test_index_ctx, test_index_scan[i], 
+                test_index_len_scan[i]);
+        found += suit_vendor_id_is_match(&test_index_ctx, 0, 
+                    test_vendor_id, sizeof(test_vendor_id))
+            && suit_class_id_is_match(&test_index_ctx, 0, 
+                    class_id, sizeof(class_id));
+    }
+    uint32_t scan = suit_bench_now() - start;
+    zassert_true(found == 1, "Failed to match candidates.");
+
+    printk("index %u manifests, %u classes: parse %u add %u " 
+            SUIT_BENCH_UNIT " each\n",
+            SUIT_TEST_INDEX_COUNT, SUIT_TEST_INDEX_CLASSES,
+            parse / SUIT_TEST_INDEX_COUNT, add / SUIT_TEST_INDEX_COUNT);
+    printk("index lookup %8u " SUIT_BENCH_UNIT ", "
+            "scan of %u manifests %10u " SUIT_BENCH_UNIT "\n",
+            lookup / SUIT_TEST_INDEX_COUNT, SUIT_TEST_INDEX_COUNT,
+            scan / SUIT_TEST_INDEX_SCAN * SUIT_TEST_INDEX_COUNT);
+    printk("index %u lookups by a concurrent reader\n", reader.lookups);
+}
+
+#define SUIT_TEST_BUDGET_ENV_SIZE 1024
+
+static uint8_t test_budget_man[sizeof(SUIT_MANIFEST_6) / 2];
+static uint8_t test_budget_boot[sizeof(SUIT_MANIFEST_0) / 2];
+static uint8_t test_budget_env[SUIT_TEST_BUDGET_ENV_SIZE];
+
+struct suit_test_budget {
+    suit_key_t * key;   /* NULL for PEM keys */
+    size_t len_env;
+    suit_context_t ctx;
+    int err;
+};
+
+void _suit_test_budget_parse(void * arg)
+{
+    struct suit_test_budget * run = arg;
+    run->err = suit_parse_init(&run->ctx, 
+            test_budget_man, sizeof(test_budget_man));
+}
+
+/* the boot example parses in every configuration */
+void _suit_test_budget_parse_boot(void * arg)
+{
+    struct suit_test_budget * run = arg;
+    run->err = suit_parse_init(&run->ctx, 
+            test_budget_boot, sizeof(test_budget_boot));
+}
+
+void _suit_test_budget_wrap(void * arg)
+{
+    struct suit_test_budget * run = arg;
+    run->len_env = sizeof(test_budget_env);
+    run->err = run->key 
+        ? suit_manifest_wrap_key(run->key, test_budget_man, 
+                sizeof(test_budget_man), test_budget_env, &run->len_env)
+        : suit_manifest_wrap(pem_prv, test_budget_man, 
+                sizeof(test_budget_man), test_budget_env, &run->len_env);
+}
+
+void _suit_test_budget_unwrap(void * arg)
+{
+    struct suit_test_budget * run = arg;
+    const uint8_t * man; size_t len_man;
+    run->err = run->key 
+        ? suit_manifest_unwrap_key(run->key, 
+                test_budget_env, run->len_env, &man, &len_man)
+        : suit_manifest_unwrap(pem_pub, 
+                test_budget_env, run->len_env, &man, &len_man);
+}
+
+/* 
+ * Measures the median cycles and the stack of an operation and checks
+ * them against the baseline, counting the operations that had none.
+ */
+void _suit_test_budget_check(const char * name, suit_bench_fn_t fn,
+        struct suit_test_budget * run, size_t * missing)
+{
+    size_t stack = suit_bench_stack(fn, run);
+    zassert_false(run->err, "Failed to %s.", name);
+    uint32_t samples[SUIT_TEST_BENCH_ROUNDS];
+    for (size_t r = 0; r < SUIT_TEST_BENCH_ROUNDS; r++) {
+        uint32_t start = k_cycle_get_32();
+        fn(run);
+        uint32_t cycles = k_cycle_get_32() - start;
+        size_t i = r;
+        for (; i > 0 && samples[i - 1] > cycles; i--)
+            samples[i] = samples[i - 1];
+        samples[i] = cycles;
+    }
+    uint32_t cycles = samples[SUIT_TEST_BENCH_ROUNDS / 2];
+
+    const struct suit_budget * b = suit_budget_find(name);
+    if (b == NULL) {
+        printk("    { \"%s\", \"%s\", %u, %u },\n", 
+                CONFIG_BOARD, name, cycles, stack);
+        (*missing)++;
+        return;
+    }
+    printk("budget %-12s %10u / %10u cycles %6u / %6u bytes of stack\n",
+            name, cycles, b->cycles, stack, b->stack);
+    zassert_true(suit_budget_is_met(b, cycles, stack),
+            "%s is over budget.", name);
+}
+
+void test_suit_budget(void) {
+    /* the gate itself */
+    const struct suit_budget gate = { "board", "op", 1000, 1000 };
+    const struct suit_budget free = { "board", "op", 0, 0 };
+    zassert_true(suit_budget_is_met(&gate, 1250, 1100)
+            && !suit_budget_is_met(&gate, 1251, 1000)
+            && !suit_budget_is_met(&gate, 1000, 1101)
+            && suit_budget_is_met(&free, UINT32_MAX, SIZE_MAX / 200),
+            "Budgets are checked wrongly.");
+
+    _xxd_r(SUIT_MANIFEST_6, test_budget_man);
+    _xxd_r(SUIT_MANIFEST_0, test_budget_boot);
+
+    /* 
+     * Unwrapping uses the envelope just wrapped. Algorithms compiled
+     * out are not measured, so that pruned configurations can be 
+     * compared (see scripts/size_report.py).
+     */
+    static struct suit_test_budget es256;
+    es256.key = NULL;
+    size_t missing = 0;
+    _suit_test_budget_check("parse boot", 
+            _suit_test_budget_parse_boot, &es256, &missing);
+#ifdef CONFIG_ZOOT_TRY_EACH
+    _suit_test_budget_check("parse", 
+            _suit_test_budget_parse, &es256, &missing);
+#endif
+#ifdef CONFIG_ZOOT_ES256
+    _suit_test_budget_check("wrap es256", 
+            _suit_test_budget_wrap, &es256, &missing);
+    _suit_test_budget_check("unwrap es256", 
+            _suit_test_budget_unwrap, &es256, &missing);
+#endif
+#ifdef CONFIG_ZOOT_HMAC
+    suit_key_t hmac;
+    zassert_false(suit_key_init_hmac(
+                &hmac, test_hmac_secret, sizeof(test_hmac_secret)),
+                "Failed to set HMAC key.");
+    static struct suit_test_budget mac;
+    mac.key = &hmac;
+    _suit_test_budget_check("wrap hmac", 
+            _suit_test_budget_wrap, &mac, &missing);
+    _suit_test_budget_check("unwrap hmac", 
+            _suit_test_budget_unwrap, &mac, &missing);
+    suit_key_free(&hmac);
+#endif
+
+    zassert_true(missing == 0, "No baseline for %u operations on %s: "
+            "record the entries printed above in budget.c.", 
+            missing, CONFIG_BOARD);
 }